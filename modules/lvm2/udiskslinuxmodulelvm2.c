@@ -296,6 +296,8 @@ lvm_update_vgs (GObject      *source_obj,
   /* only free the containers, the contents were passed further */
   g_free (vgs);
   g_free (pvs);
+
+  udisks_daemon_notify_objects_changed (daemon);
 }
 
 static void
@@ -698,6 +698,10 @@ update_vg (GObject      *source_obj,
   lv_list_free (lvs);
 
   g_dbus_interface_skeleton_flush (G_DBUS_INTERFACE_SKELETON (object->iface_volume_group));
+
+  /* logical volumes and their block devices may have changed */
+  udisks_daemon_notify_objects_changed (daemon);
+
   g_object_unref (object);
 }
 
@@ -1,6 +1,7 @@
 import udiskstestcase
 import dbus
 import os
+import six
 from distutils.spawn import find_executable
 
 class UdisksBaseTest(udiskstestcase.UdisksTestCase):
@@ -208,6 +209,14 @@ class UdisksBaseTest(udiskstestcase.UdisksTestCase):
         for path in block_paths:
             self.assertIn(path, dbus_blocks)
 
+        # the inline variant should return the same devices with their Block properties
+        dbus_props = manager.GetBlockDevicesWithProperties(self.no_options)
+        self.assertEqual(len(block_paths), len(dbus_props))
+        for path in block_paths:
+            self.assertIn(path, dbus_props)
+            self.assertEqual(dbus_props[path]['Device'],
+                             objects[path][self.iface_prefix + '.Block']['Device'])
+
     def _wipe(self, device, retry=True):
         ret, out = self.run_command('wipefs -a %s' % device)
         if ret != 0:
@@ -224,6 +233,15 @@ class UdisksBaseTest(udiskstestcase.UdisksTestCase):
         devices = manager.ResolveDevice(spec, self.no_options)
         self.assertEqual(len(devices), 0)
 
+        # partition UUIDs and labels are looked up too
+        spec = dbus.Dictionary({'partuuid': 'i-dont-exist'}, signature='sv')
+        devices = manager.ResolveDevice(spec, self.no_options)
+        self.assertEqual(len(devices), 0)
+
+        spec = dbus.Dictionary({'partlabel': 'i-dont-exist'}, signature='sv')
+        devices = manager.ResolveDevice(spec, self.no_options)
+        self.assertEqual(len(devices), 0)
+
         # get our first virtual disk by path
         spec = dbus.Dictionary({'path': self.vdevs[0]}, signature='sv')
         devices = manager.ResolveDevice(spec, self.no_options)
@@ -301,6 +319,90 @@ class UdisksBaseTest(udiskstestcase.UdisksTestCase):
         self.assertEqual(len(devices), 1)
         self.assertIn(object_path, devices)
 
+    def test_65_resolve_partition(self):
+        manager = self.get_interface(self.manager_obj, '.Manager')
+        disk = self.get_object('/block_devices/' + os.path.basename(self.vdevs[0]))
+
+        # create a GPT partition with a name on the first virtual disk
+        disk.Format('gpt', self.no_options, dbus_interface=self.iface_prefix + '.Block')
+        self.addCleanup(disk.Format, 'empty', self.no_options, dbus_interface=self.iface_prefix + '.Block')
+
+        part_name = 'udisks_test'
+        path = disk.CreatePartition(dbus.UInt64(1024**2), dbus.UInt64(100 * 1024**2), '', part_name,
+                                    self.no_options, dbus_interface=self.iface_prefix + '.PartitionTable')
+        self.udev_settle()
+        part = self.bus.get_object(self.iface_prefix, path)
+        dbus_name = self.get_property(part, '.Partition', 'Name')
+        dbus_name.assertEqual(part_name)
+        part_uuid = self.get_property_raw(part, '.Partition', 'UUID')
+        self.assertNotEqual(part_uuid, '')
+
+        # resolve it by partition UUID and label
+        for key, value in (('partuuid', part_uuid), ('partlabel', part_name)):
+            spec = dbus.Dictionary({key: value}, signature='sv')
+            devices = manager.ResolveDevice(spec, self.no_options)
+            self.assertEqual(len(devices), 1)
+            self.assertIn(path, devices)
+
+        # all keys have to match
+        spec = dbus.Dictionary({'path': '/dev/' + os.path.basename(path), 'partuuid': part_uuid}, signature='sv')
+        devices = manager.ResolveDevice(spec, self.no_options)
+        self.assertEqual(len(devices), 1)
+        self.assertIn(path, devices)
+
+        spec = dbus.Dictionary({'path': self.vdevs[0], 'partuuid': part_uuid}, signature='sv')
+        devices = manager.ResolveDevice(spec, self.no_options)
+        self.assertEqual(len(devices), 0)
+
+        # the partition's Block properties are returned inline
+        dbus_props = manager.GetBlockDevicesWithProperties(self.no_options)
+        self.assertIn(path, dbus_props)
+        for prop in ('Device', 'Size', 'ReadOnly', 'Drive'):
+            self.assertEqual(dbus_props[path][prop], self.get_property_raw(part, '.Block', prop))
+
+    def test_70_get_objects(self):
+        manager = self.get_interface(self.manager_obj, '.Manager')
+        udisks = self.get_object('')
+        objects = udisks.GetManagedObjects(dbus_interface='org.freedesktop.DBus.ObjectManager')
+
+        # objects may come and go between the two calls (e.g. on uevents), so
+        # only the test devices and the manager are compared
+        stable_paths = ['%s/block_devices/%s' % (self.path_prefix, os.path.basename(d)) for d in self.vdevs]
+        stable_paths.append('%s/Manager' % self.path_prefix)
+
+        # without a filter all objects are returned
+        dbus_objects = manager.GetObjects(self.no_options, self.no_options)
+        for path in stable_paths:
+            self.assertIn(path, dbus_objects)
+            self.assertEqual(set(objects[path].keys()), set(dbus_objects[path].keys()))
+
+        # only block devices with only the Block interface, short and full names are equivalent
+        for iface in ('Block', self.iface_prefix + '.Block'):
+            filt = dbus.Dictionary({'interfaces': dbus.Array([iface], signature='s')}, signature='sv')
+            dbus_objects = manager.GetObjects(filt, self.no_options)
+            self.assertNotIn('%s/Manager' % self.path_prefix, dbus_objects)
+            for path in stable_paths[:-1]:
+                self.assertIn(path, dbus_objects)
+            for path in dbus_objects:
+                self.assertEqual(list(dbus_objects[path].keys()), [self.iface_prefix + '.Block'])
+
+        # match on a property and select a single property
+        device = dbus.ByteArray(self.vdevs[0].encode() + b'\0')
+        filt = dbus.Dictionary({'match': dbus.Dictionary({'Block.Device': device}, signature='sv'),
+                                'properties': dbus.Array(['Block.Size'], signature='s')}, signature='sv')
+        dbus_objects = manager.GetObjects(filt, self.no_options)
+        object_path = '%s/block_devices/%s' % (self.path_prefix, os.path.basename(self.vdevs[0]))
+        self.assertEqual(list(dbus_objects.keys()), [object_path])
+        block = dbus_objects[object_path][self.iface_prefix + '.Block']
+        self.assertEqual(list(block.keys()), ['Size'])
+        self.assertEqual(block['Size'], objects[object_path][self.iface_prefix + '.Block']['Size'])
+
+        # invalid property specification
+        filt = dbus.Dictionary({'properties': dbus.Array(['Size'], signature='s')}, signature='sv')
+        msg = 'Invalid property specification'
+        with six.assertRaisesRegex(self, dbus.exceptions.DBusException, msg):
+            manager.GetObjects(filt, self.no_options)
+
     def test_80_device_presence(self):
         '''Test the debug devices are present on the bus'''
         for d in self.vdevs:
@@ -2,6 +2,8 @@ import os
 import time
 import threading
 
+import dbus
+
 import gi
 gi.require_version('GLib', '2.0')
 from gi.repository import GLib
@@ -35,6 +37,32 @@ class UdisksJobTest(udiskstestcase.UdisksTestCase):
         except Exception as e:
             self.exception = e
 
+    def _erase_partition(self, part_path):
+        try:
+            safe_dbus.call_sync(self.iface_prefix,
+                                part_path,
+                                self.iface_prefix + '.Block',
+                                'Format',
+                                GLib.Variant('(sa{sv})', ('empty', {'erase': GLib.Variant("s", 'zero')})))
+        except Exception as e:
+            self.exception = e
+
+    def _wait_for_queued_job_thread(self, operation):
+        t = threading.currentThread()
+
+        while getattr(t, "run", True):
+            objects = self._get_objects()
+
+            jobs = {k: v for (k, v) in objects[0].items() if '/jobs/' in k}
+
+            for job_path, properties in jobs.items():
+                if properties[self.iface_prefix + '.Job']['Operation'] == operation and \
+                   properties[self.iface_prefix + '.Job']['State'] == 'queued':
+                    self.job = (job_path, properties)
+                    return
+
+            time.sleep(0.1)
+
     def _wait_for_job_thread(self, operation, device_path):
         t = threading.currentThread()
 
@@ -145,3 +173,51 @@ class UdisksJobTest(udiskstestcase.UdisksTestCase):
         self.assertIsNotNone(self.exception)
         self.assertTrue(isinstance(self.exception, safe_dbus.DBusCallError))
         self.assertIn('Error erasing device: Job was canceled', str(self.exception))
+
+    def test_queued(self):
+        '''Test that a second bulk job on the same drive is queued'''
+
+        disk = self.get_object('/block_devices/' + os.path.basename(self.vdevs[0]))
+        disk.Format('gpt', self.no_options, dbus_interface=self.iface_prefix + '.Block')
+        self.addCleanup(disk.Format, 'empty', self.no_options, dbus_interface=self.iface_prefix + '.Block')
+
+        # two partitions covering the whole disk -- erasing them takes a while
+        _ret, disk_size = self.run_command('lsblk -d -b -no SIZE %s' % self.vdevs[0])
+        part_size = (int(disk_size) - 2 * 1024**2) // 2 // 1024**2 * 1024**2
+        part_paths = []
+        for i in range(2):
+            path = disk.CreatePartition(dbus.UInt64(1024**2 + i * part_size), dbus.UInt64(part_size), '', '',
+                                        self.no_options, dbus_interface=self.iface_prefix + '.PartitionTable')
+            part_paths.append(path)
+        self.udev_settle()
+
+        watch_thread = threading.Thread(target=self._wait_for_queued_job_thread, args=('format-erase',))
+        watch_thread.start()
+
+        erase_threads = [threading.Thread(target=self._erase_partition, args=(path,)) for path in part_paths]
+        for erase_thread in erase_threads:
+            erase_thread.start()
+
+        watch_thread.join(timeout=10)
+        watch_thread.run = False
+
+        # cancel all the erase jobs, the queued one included
+        objects = self._get_objects()
+        for job_path, properties in objects[0].items():
+            if '/jobs/' in job_path and properties[self.iface_prefix + '.Job']['Operation'] == 'format-erase':
+                try:
+                    safe_dbus.call_sync(self.iface_prefix,
+                                        job_path,
+                                        self.iface_prefix + '.Job',
+                                        'Cancel',
+                                        GLib.Variant('(a{sv})', ({},)))
+                except safe_dbus.DBusCallError:
+                    pass
+
+        for erase_thread in erase_threads:
+            erase_thread.join()
+        watch_thread.join()
+
+        # the partitions share a drive, only one bulk job may run on it at a time
+        self.assertIsNotNone(self.job)
+        self.assertIn(self.job[1][self.iface_prefix + '.Job']['Objects'][0], part_paths)
@@ -0,0 +1,576 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2026 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include "config.h"
+#include <glib/gi18n-lib.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "udisksauthorizationcache.h"
+#include "udisksdaemon.h"
+#include "udisksconfigmanager.h"
+#include "udiskslogging.h"
+
+/**
+ * SECTION:udisksauthorizationcache
+ * @title: UDisksAuthorizationCache
+ * @short_description: Cache of positive authorization decisions
+ *
+ * This type is used by udisks_daemon_util_check_authorization_sync()
+ * to avoid asking polkit again about a caller that was recently
+ * authorized to perform the same action on the same device. Decisions
+ * are keyed by the unique bus name of the caller, the action id and all
+ * polkit details of the check, so any change to the device (e.g. its
+ * label) results in a new check.
+ *
+ * Only positive decisions made without user interaction are cached and
+ * only for the number of seconds set with the
+ * <option>authorization_cache_ttl</option> option in
+ * <filename>udisks2.conf</filename>, which defaults to 0 and disables
+ * the cache. The cache is flushed when polkit reports that its
+ * configuration changed and the decisions about a caller are dropped
+ * once it disconnects from the bus.
+ */
+
+/* make sure a flood of callers doesn't make the cache grow without bound */
+#define MAX_ENTRIES 4096
+
+/**
+ * UDisksAuthorizationCache:
+ *
+ * The #UDisksAuthorizationCache structure contains only private data and
+ * should only be accessed using the provided API.
+ */
+struct _UDisksAuthorizationCache
+{
+  GObject parent_instance;
+
+  UDisksDaemon *daemon;
+  guint ttl;                        /* in seconds, 0 if disabled */
+
+  GMutex lock;
+  GHashTable *entries;              /* key -> expiration time (gint64 *, monotonic) */
+  GHashTable *senders;              /* set of senders with entries */
+  guint64 hits;
+  guint64 misses;
+  guint64 generation;               /* bumped whenever decisions are dropped */
+
+  gulong authority_changed_id;
+  guint name_owner_changed_id;
+};
+
+typedef struct _UDisksAuthorizationCacheClass UDisksAuthorizationCacheClass;
+
+struct _UDisksAuthorizationCacheClass
+{
+  GObjectClass parent_class;
+};
+
+enum
+{
+  PROP_0,
+  PROP_DAEMON
+};
+
+G_DEFINE_TYPE (UDisksAuthorizationCache, udisks_authorization_cache, G_TYPE_OBJECT);
+
+static void
+udisks_authorization_cache_finalize (GObject *object)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (object);
+  PolkitAuthority *authority;
+
+  if (cache->name_owner_changed_id != 0)
+    g_dbus_connection_signal_unsubscribe (udisks_daemon_get_connection (cache->daemon),
+                                          cache->name_owner_changed_id);
+  authority = udisks_daemon_get_authority (cache->daemon);
+  if (cache->authority_changed_id != 0 && authority != NULL)
+    g_signal_handler_disconnect (authority, cache->authority_changed_id);
+
+  g_hash_table_unref (cache->senders);
+  g_hash_table_unref (cache->entries);
+  g_mutex_clear (&cache->lock);
+
+  if (G_OBJECT_CLASS (udisks_authorization_cache_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (udisks_authorization_cache_parent_class)->finalize (object);
+}
+
+static void
+udisks_authorization_cache_get_property (GObject    *object,
+                                         guint       prop_id,
+                                         GValue     *value,
+                                         GParamSpec *pspec)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_value_set_object (value, cache->daemon);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_authorization_cache_set_property (GObject      *object,
+                                         guint         prop_id,
+                                         const GValue *value,
+                                         GParamSpec   *pspec)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_assert (cache->daemon == NULL);
+      /* we don't take a reference to the daemon */
+      cache->daemon = g_value_get_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+on_authority_changed (PolkitAuthority *authority,
+                      gpointer         user_data)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (user_data);
+
+  udisks_debug ("polkit configuration changed, flushing the authorization cache");
+  udisks_authorization_cache_clear (cache);
+}
+
+/* called with lock held */
+static void
+remove_sender_entries (UDisksAuthorizationCache *cache,
+                       const gchar              *sender)
+{
+  GHashTableIter iter;
+  const gchar *key;
+  gsize sender_len;
+
+  sender_len = strlen (sender);
+  g_hash_table_iter_init (&iter, cache->entries);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, NULL))
+    {
+      if (strncmp (key, sender, sender_len) == 0 && key[sender_len] == '\n')
+        g_hash_table_iter_remove (&iter);
+    }
+  g_hash_table_remove (cache->senders, sender);
+}
+
+static void
+on_name_owner_changed (GDBusConnection *connection,
+                       const gchar     *sender_name,
+                       const gchar     *object_path,
+                       const gchar     *interface_name,
+                       const gchar     *signal_name,
+                       GVariant        *parameters,
+                       gpointer         user_data)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (user_data);
+  const gchar *name;
+  const gchar *old_owner;
+  const gchar *new_owner;
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sss)")))
+    return;
+  g_variant_get (parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+
+  /* unique names are never reused, we only care about them going away */
+  if (name[0] != ':' || new_owner[0] != '\0')
+    return;
+
+  g_mutex_lock (&cache->lock);
+  /* a check for @name may still be in flight, see udisks_authorization_cache_add() */
+  cache->generation++;
+  if (g_hash_table_contains (cache->senders, name))
+    {
+      udisks_debug ("Dropping cached authorizations of %s", name);
+      remove_sender_entries (cache, name);
+    }
+  g_mutex_unlock (&cache->lock);
+}
+
+static void
+udisks_authorization_cache_constructed (GObject *object)
+{
+  UDisksAuthorizationCache *cache = UDISKS_AUTHORIZATION_CACHE (object);
+  PolkitAuthority *authority;
+  GDBusConnection *connection;
+
+  cache->ttl = udisks_config_manager_get_authorization_cache_ttl (udisks_daemon_get_config_manager (cache->daemon));
+
+  authority = udisks_daemon_get_authority (cache->daemon);
+  connection = udisks_daemon_get_connection (cache->daemon);
+  if (cache->ttl > 0 && (authority == NULL || connection == NULL))
+    {
+      /* nothing to cache without polkit, and no way to tell when callers go away without the bus */
+      cache->ttl = 0;
+    }
+
+  if (cache->ttl > 0)
+    {
+      cache->authority_changed_id = g_signal_connect (authority,
+                                                      "changed",
+                                                      G_CALLBACK (on_authority_changed),
+                                                      cache);
+      cache->name_owner_changed_id = g_dbus_connection_signal_subscribe (connection,
+                                                                         "org.freedesktop.DBus",
+                                                                         "org.freedesktop.DBus",
+                                                                         "NameOwnerChanged",
+                                                                         "/org/freedesktop/DBus",
+                                                                         NULL, /* arg0 */
+                                                                         G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                         on_name_owner_changed,
+                                                                         cache,
+                                                                         NULL); /* user_data_free_func */
+      udisks_notice ("Caching authorization decisions for %u seconds", cache->ttl);
+    }
+
+  if (G_OBJECT_CLASS (udisks_authorization_cache_parent_class)->constructed != NULL)
+    G_OBJECT_CLASS (udisks_authorization_cache_parent_class)->constructed (object);
+}
+
+static void
+udisks_authorization_cache_init (UDisksAuthorizationCache *cache)
+{
+  g_mutex_init (&cache->lock);
+  cache->entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  cache->senders = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static void
+udisks_authorization_cache_class_init (UDisksAuthorizationCacheClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize     = udisks_authorization_cache_finalize;
+  gobject_class->constructed  = udisks_authorization_cache_constructed;
+  gobject_class->set_property = udisks_authorization_cache_set_property;
+  gobject_class->get_property = udisks_authorization_cache_get_property;
+
+  /**
+   * UDisksAuthorizationCache:daemon:
+   *
+   * The #UDisksDaemon the cache is for.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_DAEMON,
+                                   g_param_spec_object ("daemon",
+                                                        "Daemon",
+                                                        "The daemon the cache is for",
+                                                        UDISKS_TYPE_DAEMON,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * udisks_authorization_cache_new:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Creates a new #UDisksAuthorizationCache object. The daemon must
+ * already have its polkit authority and configuration set up.
+ *
+ * Returns: A #UDisksAuthorizationCache that should be freed with g_object_unref().
+ */
+UDisksAuthorizationCache *
+udisks_authorization_cache_new (UDisksDaemon *daemon)
+{
+  return UDISKS_AUTHORIZATION_CACHE (g_object_new (UDISKS_TYPE_AUTHORIZATION_CACHE,
+                                                   "daemon", daemon,
+                                                   NULL));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gint
+compare_keys (gconstpointer a,
+              gconstpointer b)
+{
+  return g_strcmp0 (*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+static gchar *
+build_key (const gchar   *sender,
+           const gchar   *action_id,
+           PolkitDetails *details)
+{
+  GString *key;
+  gchar **keys;
+  guint n;
+
+  key = g_string_new (sender);
+  g_string_append_c (key, '\n');
+  g_string_append (key, action_id);
+  g_string_append_c (key, '\n');
+
+  keys = polkit_details_get_keys (details);
+  if (keys != NULL)
+    {
+      qsort (keys, g_strv_length (keys), sizeof (gchar *), compare_keys);
+      for (n = 0; keys[n] != NULL; n++)
+        {
+          gchar *escaped_key;
+          gchar *escaped_value;
+
+          /* escaping makes sure the separators can't appear in keys or values */
+          escaped_key = g_strescape (keys[n], NULL);
+          escaped_value = g_strescape (polkit_details_lookup (details, keys[n]), NULL);
+          g_string_append_printf (key, "%s=%s\n", escaped_key, escaped_value);
+          g_free (escaped_value);
+          g_free (escaped_key);
+        }
+      g_strfreev (keys);
+    }
+
+  return g_string_free (key, FALSE);
+}
+
+/* called with lock held */
+static void
+remove_expired_entries (UDisksAuthorizationCache *cache,
+                        gint64                    now)
+{
+  GHashTableIter iter;
+  const gchar *key;
+  gint64 *expires;
+
+  g_hash_table_iter_init (&iter, cache->entries);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &expires))
+    {
+      if (*expires <= now)
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+/**
+ * udisks_authorization_cache_get_enabled:
+ * @cache: A #UDisksAuthorizationCache.
+ *
+ * Checks whether @cache is in use.
+ *
+ * Returns: %TRUE if decisions are cached, %FALSE otherwise.
+ */
+gboolean
+udisks_authorization_cache_get_enabled (UDisksAuthorizationCache *cache)
+{
+  g_return_val_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache), FALSE);
+  return cache->ttl > 0;
+}
+
+/**
+ * udisks_authorization_cache_lookup:
+ * @cache: A #UDisksAuthorizationCache.
+ * @sender: The unique bus name of the caller.
+ * @action_id: The polkit action to check.
+ * @details: The details passed to polkit for the check.
+ *
+ * Looks up a positive decision for @sender and @action_id that hasn't
+ * expired yet. This can be called from any thread.
+ *
+ * Returns: %TRUE if @sender is authorized, %FALSE if polkit has to be asked.
+ */
+gboolean
+udisks_authorization_cache_lookup (UDisksAuthorizationCache *cache,
+                                   const gchar              *sender,
+                                   const gchar              *action_id,
+                                   PolkitDetails            *details)
+{
+  gboolean ret = FALSE;
+  gchar *key;
+  gint64 *expires;
+
+  g_return_val_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache), FALSE);
+
+  if (cache->ttl == 0 || sender == NULL)
+    return FALSE;
+
+  key = build_key (sender, action_id, details);
+
+  g_mutex_lock (&cache->lock);
+  expires = g_hash_table_lookup (cache->entries, key);
+  if (expires != NULL && *expires > g_get_monotonic_time ())
+    {
+      cache->hits++;
+      ret = TRUE;
+    }
+  else
+    {
+      cache->misses++;
+    }
+  g_mutex_unlock (&cache->lock);
+
+  g_free (key);
+  return ret;
+}
+
+/**
+ * udisks_authorization_cache_get_generation:
+ * @cache: A #UDisksAuthorizationCache.
+ *
+ * Gets a number that changes whenever cached decisions are dropped,
+ * either because polkit changed or because a caller went away. Pass it
+ * to udisks_authorization_cache_add() once polkit decided. This can be
+ * called from any thread.
+ *
+ * Returns: The current generation of @cache.
+ */
+guint64
+udisks_authorization_cache_get_generation (UDisksAuthorizationCache *cache)
+{
+  guint64 ret;
+
+  g_return_val_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache), 0);
+
+  g_mutex_lock (&cache->lock);
+  ret = cache->generation;
+  g_mutex_unlock (&cache->lock);
+  return ret;
+}
+
+/**
+ * udisks_authorization_cache_add:
+ * @cache: A #UDisksAuthorizationCache.
+ * @sender: The unique bus name of the caller.
+ * @action_id: The polkit action that was checked.
+ * @details: The details passed to polkit for the check.
+ * @generation: The value udisks_authorization_cache_get_generation() returned before polkit was asked.
+ *
+ * Remembers that polkit authorized @sender for @action_id without
+ * interacting with the user. Does nothing if @cache is not enabled or
+ * if decisions were dropped since @generation was obtained, as the
+ * decision may be stale already. This can be called from any thread.
+ */
+void
+udisks_authorization_cache_add (UDisksAuthorizationCache *cache,
+                                const gchar              *sender,
+                                const gchar              *action_id,
+                                PolkitDetails            *details,
+                                guint64                   generation)
+{
+  gint64 now;
+  gint64 *expires;
+  gchar *key;
+
+  g_return_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache));
+
+  /* only unique names can be dropped once the caller goes away */
+  if (cache->ttl == 0 || sender == NULL || sender[0] != ':')
+    return;
+
+  key = build_key (sender, action_id, details);
+  now = g_get_monotonic_time ();
+  expires = g_new (gint64, 1);
+  *expires = now + (gint64) cache->ttl * G_USEC_PER_SEC;
+
+  g_mutex_lock (&cache->lock);
+  if (generation != cache->generation)
+    {
+      g_mutex_unlock (&cache->lock);
+      g_free (expires);
+      g_free (key);
+      return;
+    }
+  if (g_hash_table_size (cache->entries) >= MAX_ENTRIES)
+    {
+      remove_expired_entries (cache, now);
+      if (g_hash_table_size (cache->entries) >= MAX_ENTRIES)
+        g_hash_table_remove_all (cache->entries);
+    }
+  g_hash_table_insert (cache->entries, key, expires);
+  g_hash_table_add (cache->senders, g_strdup (sender));
+  g_mutex_unlock (&cache->lock);
+}
+
+/**
+ * udisks_authorization_cache_clear:
+ * @cache: A #UDisksAuthorizationCache.
+ *
+ * Forgets all cached decisions. This can be called from any thread.
+ */
+void
+udisks_authorization_cache_clear (UDisksAuthorizationCache *cache)
+{
+  g_return_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache));
+
+  g_mutex_lock (&cache->lock);
+  udisks_debug ("Clearing %u cached authorizations (%" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses so far)",
+                g_hash_table_size (cache->entries), cache->hits, cache->misses);
+  g_hash_table_remove_all (cache->entries);
+  g_hash_table_remove_all (cache->senders);
+  cache->generation++;
+  g_mutex_unlock (&cache->lock);
+}
+
+/**
+ * udisks_authorization_cache_get_hits:
+ * @cache: A #UDisksAuthorizationCache.
+ *
+ * Gets the number of checks answered from @cache.
+ *
+ * Returns: The number of cache hits.
+ */
+guint64
+udisks_authorization_cache_get_hits (UDisksAuthorizationCache *cache)
+{
+  guint64 ret;
+
+  g_return_val_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache), 0);
+
+  g_mutex_lock (&cache->lock);
+  ret = cache->hits;
+  g_mutex_unlock (&cache->lock);
+  return ret;
+}
+
+/**
+ * udisks_authorization_cache_get_misses:
+ * @cache: A #UDisksAuthorizationCache.
+ *
+ * Gets the number of checks that had to be passed on to polkit while
+ * @cache was enabled.
+ *
+ * Returns: The number of cache misses.
+ */
+guint64
+udisks_authorization_cache_get_misses (UDisksAuthorizationCache *cache)
+{
+  guint64 ret;
+
+  g_return_val_if_fail (UDISKS_IS_AUTHORIZATION_CACHE (cache), 0);
+
+  g_mutex_lock (&cache->lock);
+  ret = cache->misses;
+  g_mutex_unlock (&cache->lock);
+  return ret;
+}
@@ -173,6 +173,8 @@ udisks_base_job_init (UDisksBaseJob *job)
 
   now_usec = g_get_real_time ();
   udisks_job_set_start_time (UDISKS_JOB (job), now_usec);
+  /* updated by the #UDisksJobScheduler when the job is queued */
+  udisks_job_set_state (UDISKS_JOB (job), "running");
 }
 
 static void
@@ -36,6 +36,14 @@ struct _UDisksConfigManager {
 
   const gchar *encryption;
   gchar *config_dir;
+
+  guint probe_workers;
+  gboolean state_journal;
+  guint jobs_per_drive;
+  guint erase_queue_depth;
+  guint authorization_cache_ttl;
+  guint method_workers;
+  guint method_queue_size;
 };
 
 struct _UDisksConfigManagerClass {
@@ -56,6 +64,13 @@ enum
 #define MODULES_GROUP_NAME  PACKAGE_NAME_UDISKS2
 #define MODULES_KEY "modules"
 #define MODULES_LOAD_PREFERENCE_KEY "modules_load_preference"
+#define PROBE_WORKERS_KEY "probe_workers"
+#define STATE_JOURNAL_KEY "state_journal"
+#define JOBS_PER_DRIVE_KEY "jobs_per_drive"
+#define ERASE_QUEUE_DEPTH_KEY "erase_queue_depth"
+#define AUTHORIZATION_CACHE_TTL_KEY "authorization_cache_ttl"
+#define METHOD_WORKERS_KEY "method_workers"
+#define METHOD_QUEUE_SIZE_KEY "method_queue_size"
 
 #define DEFAULTS_GROUP_NAME "defaults"
 #define DEFAULTS_ENCRYPTION_KEY "encryption"
@@ -135,10 +150,47 @@ udisks_config_manager_set_property (GObject      *object,
     }
 }
 
+/* Reads the unsigned integer @key of the [udisks2] group into @out_value if
+ * present. Invalid or out of range values are ignored with a warning and
+ * leave @out_value untouched, i.e. at @default_value.
+ */
+static void
+read_uint_key (GKeyFile    *config_file,
+               const gchar *key,
+               gint         min_value,
+               gint         max_value,
+               guint        default_value,
+               guint       *out_value)
+{
+  GError *error = NULL;
+  gint value;
+
+  if (!g_key_file_has_key (config_file, MODULES_GROUP_NAME, key, NULL))
+    return;
+
+  value = g_key_file_get_integer (config_file, MODULES_GROUP_NAME, key, &error);
+  if (error != NULL)
+    {
+      udisks_warning ("Invalid value used for '%s': %s; defaulting to %u",
+                      key, error->message, default_value);
+      g_clear_error (&error);
+    }
+  else if (value < min_value || value > max_value)
+    {
+      udisks_warning ("Value used for '%s' out of range: %d; defaulting to %u",
+                      key, value, default_value);
+    }
+  else
+    {
+      *out_value = (guint) value;
+    }
+}
+
 static void
 parse_config_file (UDisksConfigManager         *manager,
                    UDisksModuleLoadPreference  *out_load_preference,
                    const gchar                **out_encryption,
+                   gboolean                     read_settings,
                    GList                      **out_modules)
 {
   GKeyFile *config_file;
@@ -210,6 +262,47 @@ parse_config_file (UDisksConfigManager         *manager,
               g_free (encryption);
             }
         }
+
+      if (read_settings)
+        {
+          GError *error = NULL;
+          gboolean state_journal;
+
+          read_uint_key (config_file, PROBE_WORKERS_KEY,
+                         1, UDISKS_PROBE_WORKERS_MAX, UDISKS_PROBE_WORKERS_DEFAULT,
+                         &manager->probe_workers);
+          read_uint_key (config_file, JOBS_PER_DRIVE_KEY,
+                         1, UDISKS_JOBS_PER_DRIVE_MAX, UDISKS_JOBS_PER_DRIVE_DEFAULT,
+                         &manager->jobs_per_drive);
+          read_uint_key (config_file, ERASE_QUEUE_DEPTH_KEY,
+                         1, UDISKS_ERASE_QUEUE_DEPTH_MAX, UDISKS_ERASE_QUEUE_DEPTH_DEFAULT,
+                         &manager->erase_queue_depth);
+          read_uint_key (config_file, AUTHORIZATION_CACHE_TTL_KEY,
+                         0, UDISKS_AUTHORIZATION_CACHE_TTL_MAX, UDISKS_AUTHORIZATION_CACHE_TTL_DEFAULT,
+                         &manager->authorization_cache_ttl);
+          read_uint_key (config_file, METHOD_WORKERS_KEY,
+                         1, UDISKS_METHOD_WORKERS_MAX, UDISKS_METHOD_WORKERS_DEFAULT,
+                         &manager->method_workers);
+          read_uint_key (config_file, METHOD_QUEUE_SIZE_KEY,
+                         1, UDISKS_METHOD_QUEUE_SIZE_MAX, UDISKS_METHOD_QUEUE_SIZE_DEFAULT,
+                         &manager->method_queue_size);
+
+          /* Read whether state files are journaled. */
+          if (g_key_file_has_key (config_file, MODULES_GROUP_NAME, STATE_JOURNAL_KEY, NULL))
+            {
+              state_journal = g_key_file_get_boolean (config_file, MODULES_GROUP_NAME, STATE_JOURNAL_KEY, &error);
+              if (error != NULL)
+                {
+                  udisks_warning ("Invalid value used for '%s': %s; defaulting to %s",
+                                  STATE_JOURNAL_KEY, error->message, UDISKS_STATE_JOURNAL_DEFAULT ? "true" : "false");
+                  g_clear_error (&error);
+                }
+              else
+                {
+                  manager->state_journal = state_journal;
+                }
+            }
+        }
     }
   else
     {
@@ -238,7 +331,11 @@ udisks_config_manager_constructed (GObject *object)
       udisks_warning ("Error creating directory %s: %m", manager->config_dir);
     }
 
-  parse_config_file (manager, &manager->load_preference, &manager->encryption, NULL);
+  parse_config_file (manager,
+                     &manager->load_preference,
+                     &manager->encryption,
+                     TRUE, /* read_settings */
+                     NULL);
 
   if (G_OBJECT_CLASS (udisks_config_manager_parent_class))
     G_OBJECT_CLASS (udisks_config_manager_parent_class)->constructed (object);
@@ -330,6 +427,13 @@ udisks_config_manager_init (UDisksConfigManager *manager)
 {
   manager->load_preference = UDISKS_MODULE_LOAD_ONDEMAND;
   manager->encryption = UDISKS_ENCRYPTION_DEFAULT;
+  manager->probe_workers = UDISKS_PROBE_WORKERS_DEFAULT;
+  manager->state_journal = UDISKS_STATE_JOURNAL_DEFAULT;
+  manager->jobs_per_drive = UDISKS_JOBS_PER_DRIVE_DEFAULT;
+  manager->erase_queue_depth = UDISKS_ERASE_QUEUE_DEPTH_DEFAULT;
+  manager->authorization_cache_ttl = UDISKS_AUTHORIZATION_CACHE_TTL_DEFAULT;
+  manager->method_workers = UDISKS_METHOD_WORKERS_DEFAULT;
+  manager->method_queue_size = UDISKS_METHOD_QUEUE_SIZE_DEFAULT;
 }
 
 UDisksConfigManager *
@@ -374,7 +478,7 @@ udisks_config_manager_get_modules (UDisksConfigManager *manager)
 
   g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), NULL);
 
-  parse_config_file (manager, NULL, NULL, &modules);
+  parse_config_file (manager, NULL, NULL, FALSE, &modules);
   return modules;
 }
 
@@ -395,7 +499,7 @@ udisks_config_manager_get_modules_all (UDisksConfigManager *manager)
 
   g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager), FALSE);
 
-  parse_config_file (manager, NULL, NULL, &modules);
+  parse_config_file (manager, NULL, NULL, FALSE, &modules);
 
   ret = !modules || (g_strcmp0 (modules->data, "*") == 0 && g_list_length (modules) == 1);
 
@@ -420,6 +524,124 @@ udisks_config_manager_get_encryption (UDisksConfigManager *manager)
   return manager->encryption;
 }
 
+/**
+ * udisks_config_manager_get_probe_workers:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the maximum number of threads used for probing devices on uevents.
+ *
+ * Returns: The number of probing threads, at least 1.
+ */
+guint
+udisks_config_manager_get_probe_workers (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager),
+                        UDISKS_PROBE_WORKERS_DEFAULT);
+  return manager->probe_workers;
+}
+
+/**
+ * udisks_config_manager_get_state_journal:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets whether changes to the state files are appended to journals
+ * instead of rewriting the files, see #UDisksState.
+ *
+ * Returns: %TRUE if state journaling is enabled.
+ */
+gboolean
+udisks_config_manager_get_state_journal (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager),
+                        UDISKS_STATE_JOURNAL_DEFAULT);
+  return manager->state_journal;
+}
+
+/**
+ * udisks_config_manager_get_jobs_per_drive:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the maximum number of jobs running on a drive at a time, see
+ * #UDisksJobScheduler.
+ *
+ * Returns: The number of jobs, at least 1.
+ */
+guint
+udisks_config_manager_get_jobs_per_drive (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager),
+                        UDISKS_JOBS_PER_DRIVE_DEFAULT);
+  return manager->jobs_per_drive;
+}
+
+/**
+ * udisks_config_manager_get_erase_queue_depth:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the number of writes kept in flight when erasing a device that
+ * doesn't support zeroing it by itself.
+ *
+ * Returns: The queue depth, at least 1.
+ */
+guint
+udisks_config_manager_get_erase_queue_depth (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager),
+                        UDISKS_ERASE_QUEUE_DEPTH_DEFAULT);
+  return manager->erase_queue_depth;
+}
+
+/**
+ * udisks_config_manager_get_authorization_cache_ttl:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets for how long positive authorization decisions are cached, see
+ * #UDisksAuthorizationCache.
+ *
+ * Returns: The time in seconds or 0 if decisions are not cached.
+ */
+guint
+udisks_config_manager_get_authorization_cache_ttl (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager),
+                        UDISKS_AUTHORIZATION_CACHE_TTL_DEFAULT);
+  return manager->authorization_cache_ttl;
+}
+
+/**
+ * udisks_config_manager_get_method_workers:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the maximum number of threads handling D-Bus method calls, see
+ * #UDisksMethodExecutor.
+ *
+ * Returns: The number of threads, at least 1.
+ */
+guint
+udisks_config_manager_get_method_workers (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager),
+                        UDISKS_METHOD_WORKERS_DEFAULT);
+  return manager->method_workers;
+}
+
+/**
+ * udisks_config_manager_get_method_queue_size:
+ * @manager: A #UDisksConfigManager.
+ *
+ * Gets the maximum number of D-Bus method calls waiting to be handled,
+ * see #UDisksMethodExecutor.
+ *
+ * Returns: The number of calls, at least 1.
+ */
+guint
+udisks_config_manager_get_method_queue_size (UDisksConfigManager *manager)
+{
+  g_return_val_if_fail (UDISKS_IS_CONFIG_MANAGER (manager),
+                        UDISKS_METHOD_QUEUE_SIZE_DEFAULT);
+  return manager->method_queue_size;
+}
+
 /**
  * udisks_config_manager_get_config_dir:
  * @manager: A #UDisksConfigManager.
@@ -49,6 +49,26 @@ typedef enum
 #define UDISKS_ENCRYPTION_LUKS2 "luks2"
 #define UDISKS_ENCRYPTION_DEFAULT UDISKS_ENCRYPTION_LUKS1
 
+#define UDISKS_PROBE_WORKERS_DEFAULT 4
+#define UDISKS_PROBE_WORKERS_MAX 64
+
+#define UDISKS_STATE_JOURNAL_DEFAULT FALSE
+
+#define UDISKS_JOBS_PER_DRIVE_DEFAULT 2
+#define UDISKS_JOBS_PER_DRIVE_MAX 64
+
+#define UDISKS_ERASE_QUEUE_DEPTH_DEFAULT 4
+#define UDISKS_ERASE_QUEUE_DEPTH_MAX 64
+
+#define UDISKS_AUTHORIZATION_CACHE_TTL_DEFAULT 0
+#define UDISKS_AUTHORIZATION_CACHE_TTL_MAX 300
+
+#define UDISKS_METHOD_WORKERS_DEFAULT 16
+#define UDISKS_METHOD_WORKERS_MAX 256
+
+#define UDISKS_METHOD_QUEUE_SIZE_DEFAULT 256
+#define UDISKS_METHOD_QUEUE_SIZE_MAX 65536
+
 GType                 udisks_config_manager_get_type        (void) G_GNUC_CONST;
 UDisksConfigManager  *udisks_config_manager_new             (void);
 UDisksConfigManager  *udisks_config_manager_new_uninstalled (void);
@@ -60,6 +80,13 @@ gboolean              udisks_config_manager_get_modules_all (UDisksConfigManager
 UDisksModuleLoadPreference
                       udisks_config_manager_get_load_preference (UDisksConfigManager *manager);
 const gchar          *udisks_config_manager_get_encryption (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_probe_workers (UDisksConfigManager *manager);
+gboolean              udisks_config_manager_get_state_journal (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_jobs_per_drive (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_erase_queue_depth (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_authorization_cache_ttl (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_method_workers (UDisksConfigManager *manager);
+guint                 udisks_config_manager_get_method_queue_size (UDisksConfigManager *manager);
 
 const gchar          *udisks_config_manager_get_config_dir  (UDisksConfigManager *manager);
 
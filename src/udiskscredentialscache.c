@@ -0,0 +1,500 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2026 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include "config.h"
+#include <glib/gi18n-lib.h>
+
+#include "udiskscredentialscache.h"
+#include "udisksdaemon.h"
+#include "udisksdaemonutil.h"
+#include "udiskslogging.h"
+
+/**
+ * SECTION:udiskscredentialscache
+ * @title: UDisksCredentialsCache
+ * @short_description: Cache of the credentials of D-Bus callers
+ *
+ * This type is used for looking up the user and process id of the
+ * peer a method call comes from. The credentials are requested from
+ * the message bus with a single
+ * <literal>GetConnectionCredentials</literal> call the first time a
+ * connection calls a method and are kept, together with the group id
+ * and user name of the user, until the unique bus name of the
+ * connection goes away. Unique bus names are never reused so the
+ * cached credentials can't be picked up by another peer.
+ */
+
+/* make sure a flood of short-lived callers doesn't make the cache grow without bound */
+#define MAX_ENTRIES 4096
+
+/**
+ * UDisksCredentialsCache:
+ *
+ * The #UDisksCredentialsCache structure contains only private data and
+ * should only be accessed using the provided API.
+ */
+struct _UDisksCredentialsCache
+{
+  GObject parent_instance;
+
+  UDisksDaemon *daemon;
+
+  GMutex lock;
+  GHashTable *callers;     /* unique bus name -> CallerCredentials */
+
+  guint name_owner_changed_id;
+};
+
+typedef struct _UDisksCredentialsCacheClass UDisksCredentialsCacheClass;
+
+struct _UDisksCredentialsCacheClass
+{
+  GObjectClass parent_class;
+};
+
+typedef struct
+{
+  uid_t uid;
+  pid_t pid;
+  gboolean have_pid;
+  gboolean have_user_info;  /* whether @gid and @user_name are set */
+  gid_t gid;
+  gchar *user_name;
+} CallerCredentials;
+
+enum
+{
+  PROP_0,
+  PROP_DAEMON
+};
+
+G_DEFINE_TYPE (UDisksCredentialsCache, udisks_credentials_cache, G_TYPE_OBJECT);
+
+static void
+caller_credentials_free (CallerCredentials *credentials)
+{
+  g_free (credentials->user_name);
+  g_free (credentials);
+}
+
+static void
+udisks_credentials_cache_finalize (GObject *object)
+{
+  UDisksCredentialsCache *cache = UDISKS_CREDENTIALS_CACHE (object);
+
+  if (cache->name_owner_changed_id != 0)
+    g_dbus_connection_signal_unsubscribe (udisks_daemon_get_connection (cache->daemon),
+                                          cache->name_owner_changed_id);
+
+  g_hash_table_unref (cache->callers);
+  g_mutex_clear (&cache->lock);
+
+  if (G_OBJECT_CLASS (udisks_credentials_cache_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (udisks_credentials_cache_parent_class)->finalize (object);
+}
+
+static void
+udisks_credentials_cache_get_property (GObject    *object,
+                                       guint       prop_id,
+                                       GValue     *value,
+                                       GParamSpec *pspec)
+{
+  UDisksCredentialsCache *cache = UDISKS_CREDENTIALS_CACHE (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_value_set_object (value, cache->daemon);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_credentials_cache_set_property (GObject      *object,
+                                       guint         prop_id,
+                                       const GValue *value,
+                                       GParamSpec   *pspec)
+{
+  UDisksCredentialsCache *cache = UDISKS_CREDENTIALS_CACHE (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_assert (cache->daemon == NULL);
+      /* we don't take a reference to the daemon */
+      cache->daemon = g_value_get_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+on_name_owner_changed (GDBusConnection *connection,
+                       const gchar     *sender_name,
+                       const gchar     *object_path,
+                       const gchar     *interface_name,
+                       const gchar     *signal_name,
+                       GVariant        *parameters,
+                       gpointer         user_data)
+{
+  UDisksCredentialsCache *cache = UDISKS_CREDENTIALS_CACHE (user_data);
+  const gchar *name;
+  const gchar *old_owner;
+  const gchar *new_owner;
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sss)")))
+    return;
+  g_variant_get (parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+
+  /* unique names are never reused, we only care about them going away */
+  if (name[0] != ':' || new_owner[0] != '\0')
+    return;
+
+  g_mutex_lock (&cache->lock);
+  g_hash_table_remove (cache->callers, name);
+  g_mutex_unlock (&cache->lock);
+}
+
+static void
+udisks_credentials_cache_constructed (GObject *object)
+{
+  UDisksCredentialsCache *cache = UDISKS_CREDENTIALS_CACHE (object);
+  GDBusConnection *connection;
+
+  /* without the bus we can't tell when a caller goes away and don't cache anything */
+  connection = udisks_daemon_get_connection (cache->daemon);
+  if (connection != NULL)
+    cache->name_owner_changed_id = g_dbus_connection_signal_subscribe (connection,
+                                                                       "org.freedesktop.DBus",
+                                                                       "org.freedesktop.DBus",
+                                                                       "NameOwnerChanged",
+                                                                       "/org/freedesktop/DBus",
+                                                                       NULL, /* arg0 */
+                                                                       G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                       on_name_owner_changed,
+                                                                       cache,
+                                                                       NULL); /* user_data_free_func */
+
+  if (G_OBJECT_CLASS (udisks_credentials_cache_parent_class)->constructed != NULL)
+    G_OBJECT_CLASS (udisks_credentials_cache_parent_class)->constructed (object);
+}
+
+static void
+udisks_credentials_cache_init (UDisksCredentialsCache *cache)
+{
+  g_mutex_init (&cache->lock);
+  cache->callers = g_hash_table_new_full (g_str_hash,
+                                          g_str_equal,
+                                          g_free,
+                                          (GDestroyNotify) caller_credentials_free);
+}
+
+static void
+udisks_credentials_cache_class_init (UDisksCredentialsCacheClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize     = udisks_credentials_cache_finalize;
+  gobject_class->constructed  = udisks_credentials_cache_constructed;
+  gobject_class->set_property = udisks_credentials_cache_set_property;
+  gobject_class->get_property = udisks_credentials_cache_get_property;
+
+  /**
+   * UDisksCredentialsCache:daemon:
+   *
+   * The #UDisksDaemon the cache is for.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_DAEMON,
+                                   g_param_spec_object ("daemon",
+                                                        "Daemon",
+                                                        "The daemon the cache is for",
+                                                        UDISKS_TYPE_DAEMON,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * udisks_credentials_cache_new:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Creates a new #UDisksCredentialsCache object.
+ *
+ * Returns: A #UDisksCredentialsCache that should be freed with g_object_unref().
+ */
+UDisksCredentialsCache *
+udisks_credentials_cache_new (UDisksDaemon *daemon)
+{
+  return UDISKS_CREDENTIALS_CACHE (g_object_new (UDISKS_TYPE_CREDENTIALS_CACHE,
+                                                 "daemon", daemon,
+                                                 NULL));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static GVariant *
+call_bus_sync (GDBusConnection     *connection,
+               const gchar         *method,
+               const gchar         *caller,
+               const GVariantType  *reply_type,
+               GCancellable        *cancellable,
+               GError             **error)
+{
+  return g_dbus_connection_call_sync (connection,
+                                      "org.freedesktop.DBus",  /* bus name */
+                                      "/org/freedesktop/DBus", /* object path */
+                                      "org.freedesktop.DBus",  /* interface */
+                                      method,
+                                      g_variant_new ("(s)", caller),
+                                      reply_type,
+                                      G_DBUS_CALL_FLAGS_NONE,
+                                      -1, /* timeout_msec */
+                                      cancellable,
+                                      error);
+}
+
+/* Gets the uid and, if available, the pid of @caller from the bus */
+static gboolean
+fetch_credentials (GDBusConnection    *connection,
+                   const gchar        *caller,
+                   GCancellable       *cancellable,
+                   CallerCredentials  *credentials,
+                   GError            **error)
+{
+  gboolean ret = FALSE;
+  GError *local_error = NULL;
+  GVariant *value;
+  GVariant *dict = NULL;
+  guint32 fetched;
+
+  G_STATIC_ASSERT (sizeof (uid_t) == sizeof (guint32));
+  G_STATIC_ASSERT (sizeof (pid_t) == sizeof (guint32));
+
+  value = call_bus_sync (connection, "GetConnectionCredentials", caller,
+                         G_VARIANT_TYPE ("(a{sv})"), cancellable, &local_error);
+  if (value != NULL)
+    {
+      dict = g_variant_get_child_value (value, 0);
+      g_variant_unref (value);
+      if (!g_variant_lookup (dict, "UnixUserID", "u", &fetched))
+        {
+          g_set_error (error,
+                       UDISKS_ERROR,
+                       UDISKS_ERROR_FAILED,
+                       "Error determining uid of caller %s: no UnixUserID in credentials",
+                       caller);
+          goto out;
+        }
+      credentials->uid = fetched;
+      /* NOTE: pid_t is a signed 32 bit, but the bus returns an unsigned */
+      credentials->have_pid = g_variant_lookup (dict, "ProcessID", "u", &fetched);
+      if (credentials->have_pid)
+        credentials->pid = fetched;
+      ret = TRUE;
+      goto out;
+    }
+
+  /* message buses older than the D-Bus 0.97 specification only have the separate calls */
+  if (!g_error_matches (local_error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD))
+    goto error;
+  g_clear_error (&local_error);
+
+  value = call_bus_sync (connection, "GetConnectionUnixUser", caller,
+                         G_VARIANT_TYPE ("(u)"), cancellable, &local_error);
+  if (value == NULL)
+    goto error;
+  g_variant_get (value, "(u)", &fetched);
+  g_variant_unref (value);
+  credentials->uid = fetched;
+
+  value = call_bus_sync (connection, "GetConnectionUnixProcessID", caller,
+                         G_VARIANT_TYPE ("(u)"), cancellable, NULL);
+  if (value != NULL)
+    {
+      g_variant_get (value, "(u)", &fetched);
+      g_variant_unref (value);
+      credentials->pid = fetched;
+      credentials->have_pid = TRUE;
+    }
+
+  ret = TRUE;
+  goto out;
+
+ error:
+  g_set_error (error,
+               UDISKS_ERROR,
+               UDISKS_ERROR_FAILED,
+               "Error determining uid of caller %s: %s (%s, %d)",
+               caller,
+               local_error->message,
+               g_quark_to_string (local_error->domain),
+               local_error->code);
+  g_clear_error (&local_error);
+
+ out:
+  if (dict != NULL)
+    g_variant_unref (dict);
+  return ret;
+}
+
+/* called with lock held */
+static void
+insert_credentials (UDisksCredentialsCache  *cache,
+                    const gchar             *caller,
+                    const CallerCredentials *credentials)
+{
+  CallerCredentials *copy;
+
+  if (cache->name_owner_changed_id == 0 || g_hash_table_contains (cache->callers, caller))
+    return;
+
+  if (g_hash_table_size (cache->callers) >= MAX_ENTRIES)
+    {
+      udisks_debug ("Too many cached callers, dropping all of them");
+      g_hash_table_remove_all (cache->callers);
+    }
+
+  copy = g_new0 (CallerCredentials, 1);
+  *copy = *credentials;
+  copy->user_name = g_strdup (credentials->user_name);
+  g_hash_table_insert (cache->callers, g_strdup (caller), copy);
+}
+
+/**
+ * udisks_credentials_cache_lookup_sync:
+ * @cache: A #UDisksCredentialsCache.
+ * @invocation: A #GDBusMethodInvocation.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @out_uid: (out) (allow-none): Return location for the user id or %NULL.
+ * @out_pid: (out) (allow-none): Return location for the process id or %NULL.
+ * @out_gid: (out) (allow-none): Return location for the primary group id of the user or %NULL.
+ * @out_user_name: (out) (allow-none): Return location for the user name or %NULL.
+ * @error: Return location for error.
+ *
+ * Gets the credentials of the peer represented by @invocation, asking
+ * the message bus only if they haven't been cached yet. The group id
+ * and user name are only resolved if requested. This can be called from
+ * any thread.
+ *
+ * Returns: %TRUE if all the requested credentials were obtained, %FALSE otherwise.
+ */
+gboolean
+udisks_credentials_cache_lookup_sync (UDisksCredentialsCache  *cache,
+                                      GDBusMethodInvocation   *invocation,
+                                      GCancellable            *cancellable,
+                                      uid_t                   *out_uid,
+                                      pid_t                   *out_pid,
+                                      gid_t                   *out_gid,
+                                      gchar                  **out_user_name,
+                                      GError                 **error)
+{
+  gboolean ret = FALSE;
+  CallerCredentials credentials = { 0 };
+  CallerCredentials *cached;
+  const gchar *caller;
+  gboolean found = FALSE;
+
+  g_return_val_if_fail (UDISKS_IS_CREDENTIALS_CACHE (cache), FALSE);
+  g_return_val_if_fail (G_IS_DBUS_METHOD_INVOCATION (invocation), FALSE);
+
+  caller = g_dbus_method_invocation_get_sender (invocation);
+
+  g_mutex_lock (&cache->lock);
+  cached = g_hash_table_lookup (cache->callers, caller);
+  if (cached != NULL)
+    {
+      credentials = *cached;
+      credentials.user_name = g_strdup (cached->user_name);
+      found = TRUE;
+    }
+  g_mutex_unlock (&cache->lock);
+
+  if (!found)
+    {
+      if (!fetch_credentials (g_dbus_method_invocation_get_connection (invocation),
+                              caller, cancellable, &credentials, error))
+        goto out;
+    }
+
+  if ((out_gid != NULL || out_user_name != NULL) && !credentials.have_user_info)
+    {
+      if (!udisks_daemon_util_get_user_info (credentials.uid,
+                                             &credentials.gid,
+                                             &credentials.user_name,
+                                             error))
+        goto out;
+      credentials.have_user_info = TRUE;
+    }
+
+  g_mutex_lock (&cache->lock);
+  cached = g_hash_table_lookup (cache->callers, caller);
+  if (cached == NULL)
+    {
+      /* may be inserted after the caller went away, MAX_ENTRIES takes care of that */
+      if (!found)
+        insert_credentials (cache, caller, &credentials);
+    }
+  else if (!cached->have_user_info && credentials.have_user_info)
+    {
+      cached->gid = credentials.gid;
+      cached->user_name = g_strdup (credentials.user_name);
+      cached->have_user_info = TRUE;
+    }
+  g_mutex_unlock (&cache->lock);
+
+  if (out_pid != NULL && !credentials.have_pid)
+    {
+      g_set_error (error,
+                   UDISKS_ERROR,
+                   UDISKS_ERROR_FAILED,
+                   "Error determining pid of caller %s",
+                   caller);
+      goto out;
+    }
+
+  if (out_uid != NULL)
+    *out_uid = credentials.uid;
+  if (out_pid != NULL)
+    *out_pid = credentials.pid;
+  if (out_gid != NULL)
+    *out_gid = credentials.gid;
+  if (out_user_name != NULL)
+    {
+      *out_user_name = credentials.user_name;
+      credentials.user_name = NULL;
+    }
+
+  ret = TRUE;
+
+ out:
+  g_free (credentials.user_name);
+  return ret;
+}
@@ -0,0 +1,47 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2026 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef __UDISKS_CREDENTIALS_CACHE_H__
+#define __UDISKS_CREDENTIALS_CACHE_H__
+
+#include "udisksdaemontypes.h"
+#include <sys/types.h>
+
+G_BEGIN_DECLS
+
+#define UDISKS_TYPE_CREDENTIALS_CACHE  (udisks_credentials_cache_get_type ())
+#define UDISKS_CREDENTIALS_CACHE(o)    (G_TYPE_CHECK_INSTANCE_CAST ((o), UDISKS_TYPE_CREDENTIALS_CACHE, UDisksCredentialsCache))
+#define UDISKS_IS_CREDENTIALS_CACHE(o) (G_TYPE_CHECK_INSTANCE_TYPE ((o), UDISKS_TYPE_CREDENTIALS_CACHE))
+
+GType                   udisks_credentials_cache_get_type    (void) G_GNUC_CONST;
+UDisksCredentialsCache *udisks_credentials_cache_new         (UDisksDaemon            *daemon);
+gboolean                udisks_credentials_cache_lookup_sync (UDisksCredentialsCache  *cache,
+                                                              GDBusMethodInvocation   *invocation,
+                                                              GCancellable            *cancellable,
+                                                              uid_t                   *out_uid,
+                                                              pid_t                   *out_pid,
+                                                              gid_t                   *out_gid,
+                                                              gchar                  **out_user_name,
+                                                              GError                 **error);
+
+G_END_DECLS
+
+#endif /* __UDISKS_CREDENTIALS_CACHE_H__ */
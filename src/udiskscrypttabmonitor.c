@@ -60,6 +60,10 @@ struct _UDisksCrypttabMonitor
   GList *crypttab_entries;
   GMutex crypttab_entries_mutex;
 
+  /* indexes of crypttab_entries, rebuilt when entries are added or removed */
+  GHashTable *entries_by_device;     /* device -> GList of UDisksCrypttabEntry */
+  GHashTable *entries_by_parent;     /* x-parent UUID -> GList of UDisksCrypttabEntry */
+
   gchar *crypttab_checksum;
 
   GFileMonitor *file_monitor;
@@ -95,6 +99,18 @@ G_DEFINE_TYPE (UDisksCrypttabMonitor, udisks_crypttab_monitor, G_TYPE_OBJECT)
 static void udisks_crypttab_monitor_ensure (UDisksCrypttabMonitor *monitor);
 static void udisks_crypttab_monitor_constructed (GObject *object);
 
+static void
+free_index (GHashTable *index)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, index);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_list_free (value);
+  g_hash_table_destroy (index);
+}
+
 static void
 udisks_crypttab_monitor_finalize (GObject *object)
 {
@@ -103,6 +119,8 @@ udisks_crypttab_monitor_finalize (GObject *object)
   g_object_unref (monitor->file_monitor);
   g_free (monitor->crypttab_checksum);
 
+  free_index (monitor->entries_by_device);
+  free_index (monitor->entries_by_parent);
   g_list_free_full (monitor->crypttab_entries, g_object_unref);
 
   g_mutex_clear (&monitor->crypttab_entries_mutex);
@@ -116,6 +134,9 @@ udisks_crypttab_monitor_init (UDisksCrypttabMonitor *monitor)
 {
   monitor->crypttab_entries = NULL;
   g_mutex_init (&monitor->crypttab_entries_mutex);
+  /* the lists are freed by free_index() */
+  monitor->entries_by_device = g_hash_table_new (g_str_hash, g_str_equal);
+  monitor->entries_by_parent = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 }
 
 static void
@@ -308,6 +329,58 @@ free_crypttab_entry_changed_data (gpointer user_data)
   g_free (data);
 }
 
+/* prepends @entry to the list for @key in @index; if @index has a key
+ * destroy function, it takes ownership of @key */
+static void
+index_prepend (GHashTable          *index,
+               gchar               *key,
+               UDisksCrypttabEntry *entry)
+{
+  GList *list;
+
+  list = g_hash_table_lookup (index, key);
+  g_hash_table_insert (index, key, g_list_prepend (list, entry));
+}
+
+/* must be called with crypttab_entries_mutex held */
+static void
+rebuild_indexes (UDisksCrypttabMonitor *monitor)
+{
+  GList *l;
+
+  free_index (monitor->entries_by_device);
+  free_index (monitor->entries_by_parent);
+  monitor->entries_by_device = g_hash_table_new (g_str_hash, g_str_equal);
+  monitor->entries_by_parent = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* crypttab_entries is in reverse file order so prepending yields lists in file order */
+  for (l = monitor->crypttab_entries; l != NULL; l = l->next)
+    {
+      UDisksCrypttabEntry *entry = UDISKS_CRYPTTAB_ENTRY (l->data);
+      const gchar *device = udisks_crypttab_entry_get_device (entry);
+      const gchar *options = udisks_crypttab_entry_get_options (entry);
+
+      if (device != NULL && strlen (device) > 0)
+        index_prepend (monitor->entries_by_device, (gchar *) device, entry);
+
+      if (options != NULL && strstr (options, "x-parent=") != NULL)
+        {
+          gchar **tokens;
+          guint n;
+
+          tokens = g_strsplit (options, ",", -1);
+          for (n = 0; tokens[n] != NULL; n++)
+            {
+              if (g_str_has_prefix (tokens[n], "x-parent=") && strlen (tokens[n]) > strlen ("x-parent="))
+                index_prepend (monitor->entries_by_parent,
+                               g_strdup (tokens[n] + strlen ("x-parent=")),
+                               entry);
+            }
+          g_strfreev (tokens);
+        }
+    }
+}
+
 /**
  * split_crypttab_line:
  *
@@ -448,11 +521,14 @@ udisks_crypttab_monitor_ensure (UDisksCrypttabMonitor *monitor)
       g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, crypttab_entry_changed_cb, data, free_crypttab_entry_changed_data);
     }
 
-  g_list_free (removed);
-  g_list_free (added);
   g_list_free_full (monitor->crypttab_entries, g_object_unref);
-
   monitor->crypttab_entries = entries;
+
+  /* the indexes point into the entries, always rebuild them with the new list */
+  rebuild_indexes (monitor);
+
+  g_list_free (removed);
+  g_list_free (added);
   g_free (monitor->crypttab_checksum);
   monitor->crypttab_checksum = g_steal_pointer (&contents_checksum);
 
@@ -486,3 +562,83 @@ udisks_crypttab_monitor_get_entries (UDisksCrypttabMonitor  *monitor)
 
   return ret;
 }
+
+/**
+ * udisks_crypttab_monitor_get_entries_for_ids:
+ * @monitor: A #UDisksCrypttabMonitor.
+ * @ids: A %NULL-terminated array of block device identifiers.
+ *
+ * Gets all /etc/crypttab entries with a device matching one of @ids. Each
+ * identifier is either a device file (or a symlink to it) or a
+ * <literal>KEY=VALUE</literal> pair like <literal>UUID=...</literal>,
+ * <literal>LABEL=...</literal>, <literal>PARTUUID=...</literal> or
+ * <literal>PARTLABEL=...</literal>.
+ *
+ * Returns: (transfer full) (element-type UDisksCrypttabEntry): A list of #UDisksCrypttabEntry objects in file order that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_crypttab_monitor_get_entries_for_ids (UDisksCrypttabMonitor *monitor,
+                                             const gchar * const   *ids)
+{
+  GHashTable *matches;
+  GList *ret = NULL;
+  GList *l;
+  guint n;
+
+  g_return_val_if_fail (UDISKS_IS_CRYPTTAB_MONITOR (monitor), NULL);
+
+  if (ids == NULL)
+    return NULL;
+
+  udisks_crypttab_monitor_ensure (monitor);
+
+  g_mutex_lock (&monitor->crypttab_entries_mutex);
+  matches = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (n = 0; ids[n] != NULL; n++)
+    {
+      for (l = g_hash_table_lookup (monitor->entries_by_device, ids[n]); l != NULL; l = l->next)
+        g_hash_table_add (matches, l->data);
+    }
+  if (g_hash_table_size (matches) > 0)
+    {
+      /* crypttab_entries is in reverse file order */
+      for (l = monitor->crypttab_entries; l != NULL; l = l->next)
+        {
+          if (g_hash_table_contains (matches, l->data))
+            ret = g_list_prepend (ret, g_object_ref (l->data));
+        }
+    }
+  g_hash_table_destroy (matches);
+  g_mutex_unlock (&monitor->crypttab_entries_mutex);
+
+  return ret;
+}
+
+/**
+ * udisks_crypttab_monitor_get_entries_for_parent:
+ * @monitor: A #UDisksCrypttabMonitor.
+ * @parent_uuid: The UUID of a parent device.
+ *
+ * Gets all /etc/crypttab entries with a <literal>x-parent=@parent_uuid</literal>
+ * option.
+ *
+ * Returns: (transfer full) (element-type UDisksCrypttabEntry): A list of #UDisksCrypttabEntry objects in file order that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_crypttab_monitor_get_entries_for_parent (UDisksCrypttabMonitor *monitor,
+                                                const gchar           *parent_uuid)
+{
+  GList *ret;
+
+  g_return_val_if_fail (UDISKS_IS_CRYPTTAB_MONITOR (monitor), NULL);
+  g_return_val_if_fail (parent_uuid != NULL, NULL);
+
+  udisks_crypttab_monitor_ensure (monitor);
+
+  g_mutex_lock (&monitor->crypttab_entries_mutex);
+  ret = g_list_copy_deep (g_hash_table_lookup (monitor->entries_by_parent, parent_uuid),
+                          (GCopyFunc) udisks_g_object_ref_copy, NULL);
+  g_mutex_unlock (&monitor->crypttab_entries_mutex);
+
+  return ret;
+}
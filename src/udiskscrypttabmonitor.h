@@ -29,9 +29,13 @@ G_BEGIN_DECLS
 #define UDISKS_CRYPTTAB_MONITOR(o)    (G_TYPE_CHECK_INSTANCE_CAST ((o), UDISKS_TYPE_CRYPTTAB_MONITOR, UDisksCrypttabMonitor))
 #define UDISKS_IS_CRYPTTAB_MONITOR(o) (G_TYPE_CHECK_INSTANCE_TYPE ((o), UDISKS_TYPE_CRYPTTAB_MONITOR))
 
-GType                   udisks_crypttab_monitor_get_type    (void) G_GNUC_CONST;
-UDisksCrypttabMonitor  *udisks_crypttab_monitor_new         (void);
-GList                  *udisks_crypttab_monitor_get_entries (UDisksCrypttabMonitor  *monitor);
+GType                   udisks_crypttab_monitor_get_type               (void) G_GNUC_CONST;
+UDisksCrypttabMonitor  *udisks_crypttab_monitor_new                    (void);
+GList                  *udisks_crypttab_monitor_get_entries            (UDisksCrypttabMonitor  *monitor);
+GList                  *udisks_crypttab_monitor_get_entries_for_ids    (UDisksCrypttabMonitor  *monitor,
+                                                                        const gchar * const    *ids);
+GList                  *udisks_crypttab_monitor_get_entries_for_parent (UDisksCrypttabMonitor  *monitor,
+                                                                        const gchar            *parent_uuid);
 
 G_END_DECLS
 
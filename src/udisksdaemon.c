@@ -35,7 +35,12 @@
 #include "udisksspawnedjob.h"
 #include "udisksthreadedjob.h"
 #include "udiskssimplejob.h"
+#include "udisksjobscheduler.h"
+#include "udisksauthorizationcache.h"
+#include "udiskscredentialscache.h"
+#include "udisksmethodexecutor.h"
 #include "udisksstate.h"
+#include "udisksfstabmonitor.h"
 #include "udiskscrypttabmonitor.h"
 #include "udiskscrypttabentry.h"
 #include "udiskslinuxblockobject.h"
@@ -80,6 +85,12 @@ struct _UDisksDaemon
 
   UDisksState *state;
 
+  UDisksFstabMonitor *fstab_monitor;
+  UDisksJobScheduler *job_scheduler;
+  UDisksAuthorizationCache *authorization_cache;
+  UDisksCredentialsCache *credentials_cache;
+  UDisksMethodExecutor *method_executor;
+
   UDisksCrypttabMonitor *crypttab_monitor;
 
 #ifdef HAVE_LIBMOUNT_UTAB
@@ -95,6 +106,23 @@ struct _UDisksDaemon
   gboolean uninstalled;
   gboolean enable_tcrypt;
   gchar *uuid;
+
+  /* indexes of exported objects implementing the Block interface, see block_index_update() */
+  GMutex block_index_lock;
+  GHashTable *block_index_entries;   /* UDisksObject -> BlockIndexEntry */
+  GHashTable *block_by_dev;          /* dev_t -> GPtrArray of UDisksObject */
+  GHashTable *block_by_device_file;  /* device file -> GPtrArray of UDisksObject */
+  GHashTable *block_by_symlink;      /* device file symlink -> GPtrArray of UDisksObject */
+  GHashTable *block_by_sysfs_path;   /* sysfs path -> GPtrArray of UDisksObject */
+  GHashTable *blocks_by_id_uuid;     /* IdUUID -> GPtrArray of UDisksObject */
+  GHashTable *blocks_by_id_label;    /* IdLabel -> GPtrArray of UDisksObject */
+  GHashTable *blocks_by_part_uuid;   /* Partition:UUID -> GPtrArray of UDisksObject */
+  GHashTable *blocks_by_part_name;   /* Partition:Name -> GPtrArray of UDisksObject */
+
+  /* bumped on every udisks_daemon_notify_objects_changed(), see wait_for_objects() */
+  GMutex objects_changed_lock;
+  GCond objects_changed_cond;
+  guint64 objects_changed_seq;
 };
 
 struct _UDisksDaemonClass
@@ -120,6 +148,17 @@ enum
 
 G_DEFINE_TYPE (UDisksDaemon, udisks_daemon, G_TYPE_OBJECT);
 
+static void block_index_init (UDisksDaemon *daemon);
+static void block_index_clear (UDisksDaemon *daemon);
+static void on_objects_changed (gpointer user_data);
+static void on_object_added (GDBusObjectManager *manager,
+                             GDBusObject        *object,
+                             gpointer            user_data);
+static void on_interface_added (GDBusObjectManager *manager,
+                                GDBusObject        *object,
+                                GDBusInterface     *interface,
+                                gpointer            user_data);
+
 static void
 udisks_daemon_finalize (GObject *object)
 {
@@ -127,14 +166,21 @@ udisks_daemon_finalize (GObject *object)
 
   udisks_state_stop_cleanup (daemon->state);
 
+  block_index_clear (daemon);
+
   /* Modules use the monitors and try to reference them when cleaning up */
   udisks_module_manager_unload_modules (daemon->module_manager);
 
+  /* the caches disconnect from the authority and the connection */
+  g_clear_object (&daemon->authorization_cache);
+  g_clear_object (&daemon->credentials_cache);
+
   g_clear_object (&daemon->authority);
   g_object_unref (daemon->object_manager);
   g_object_unref (daemon->linux_provider);
   g_object_unref (daemon->connection);
   g_object_unref (daemon->mount_monitor);
+  g_object_unref (daemon->fstab_monitor);
   g_object_unref (daemon->crypttab_monitor);
 #ifdef HAVE_LIBMOUNT_UTAB
   g_object_unref (daemon->utab_monitor);
@@ -142,10 +188,15 @@ udisks_daemon_finalize (GObject *object)
   g_clear_object (&daemon->module_manager);
 
   g_object_unref (daemon->state);
+  g_clear_object (&daemon->job_scheduler);
+  g_clear_object (&daemon->method_executor);
   g_free (daemon->uuid);
 
   g_clear_object (&daemon->config_manager);
 
+  g_mutex_clear (&daemon->objects_changed_lock);
+  g_cond_clear (&daemon->objects_changed_cond);
+
   if (G_OBJECT_CLASS (udisks_daemon_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (udisks_daemon_parent_class)->finalize (object);
 }
@@ -263,6 +314,8 @@ udisks_daemon_set_property (GObject      *object,
 static void
 udisks_daemon_init (UDisksDaemon *daemon)
 {
+  g_mutex_init (&daemon->objects_changed_lock);
+  g_cond_init (&daemon->objects_changed_cond);
 }
 
 static void
@@ -274,6 +327,28 @@ mount_monitor_on_mount_removed (UDisksMountMonitor *monitor,
   udisks_state_check (daemon->state);
 }
 
+/* Updates the block object the mount refers to, if any. The lookup goes
+ * through the device number index so block objects unaffected by the mount
+ * change are not visited at all.
+ */
+static void
+mount_monitor_on_mount_changed (UDisksMountMonitor *monitor,
+                                UDisksMount        *mount,
+                                gpointer            user_data)
+{
+  UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
+  UDisksObject *object;
+
+  object = udisks_daemon_find_block (daemon, udisks_mount_get_dev (mount));
+  if (object == NULL)
+    return;
+
+  if (UDISKS_IS_LINUX_BLOCK_OBJECT (object))
+    udisks_linux_block_object_uevent (UDISKS_LINUX_BLOCK_OBJECT (object), NULL, NULL);
+
+  g_object_unref (object);
+}
+
 static gboolean
 load_modules_in_idle_cb (gpointer user_data)
 {
@@ -388,6 +463,13 @@ udisks_daemon_constructed (GObject *object)
     }
 
   daemon->object_manager = g_dbus_object_manager_server_new ("/org/freedesktop/UDisks2");
+  block_index_init (daemon);
+
+  /* wake up threads blocked in wait_for_objects() whenever the set of objects changes */
+  g_signal_connect_swapped_after (daemon->object_manager, "object-added", G_CALLBACK (on_objects_changed), daemon);
+  g_signal_connect_swapped_after (daemon->object_manager, "object-removed", G_CALLBACK (on_objects_changed), daemon);
+  g_signal_connect_swapped_after (daemon->object_manager, "interface-added", G_CALLBACK (on_objects_changed), daemon);
+  g_signal_connect_swapped_after (daemon->object_manager, "interface-removed", G_CALLBACK (on_objects_changed), daemon);
 
   if (!g_file_test ("/run/udisks2", G_FILE_TEST_IS_DIR))
     {
@@ -421,11 +503,41 @@ udisks_daemon_constructed (GObject *object)
 
   daemon->state = udisks_state_new (daemon);
 
+  daemon->job_scheduler = udisks_job_scheduler_new (daemon);
+
+  daemon->authorization_cache = udisks_authorization_cache_new (daemon);
+
+  daemon->credentials_cache = udisks_credentials_cache_new (daemon);
+
+  /* handle method calls on exported interfaces on a bounded set of threads */
+  daemon->method_executor = udisks_method_executor_new (daemon);
+  g_signal_connect (daemon->object_manager, "object-added", G_CALLBACK (on_object_added), daemon);
+  g_signal_connect (daemon->object_manager, "interface-added", G_CALLBACK (on_interface_added), daemon);
+
   g_signal_connect (daemon->mount_monitor,
                     "mount-removed",
                     G_CALLBACK (mount_monitor_on_mount_removed),
                     daemon);
+  g_signal_connect (daemon->mount_monitor,
+                    "mount-added",
+                    G_CALLBACK (mount_monitor_on_mount_changed),
+                    daemon);
+  g_signal_connect (daemon->mount_monitor,
+                    "mount-removed",
+                    G_CALLBACK (mount_monitor_on_mount_changed),
+                    daemon);
 
+  /* wake up waiters once the block objects have processed the mount change */
+  g_signal_connect_swapped_after (daemon->mount_monitor,
+                                  "mount-added",
+                                  G_CALLBACK (on_objects_changed),
+                                  daemon);
+  g_signal_connect_swapped_after (daemon->mount_monitor,
+                                  "mount-removed",
+                                  G_CALLBACK (on_objects_changed),
+                                  daemon);
+
+  daemon->fstab_monitor = udisks_fstab_monitor_new ();
   daemon->crypttab_monitor = udisks_crypttab_monitor_new ();
 #ifdef HAVE_LIBMOUNT_UTAB
   daemon->utab_monitor = udisks_utab_monitor_new ();
@@ -670,6 +782,36 @@ udisks_daemon_get_mount_monitor (UDisksDaemon *daemon)
   return daemon->mount_monitor;
 }
 
+/**
+ * udisks_daemon_get_job_scheduler:
+ * @daemon: A #UDisksDaemon
+ *
+ * Gets the job scheduler used by @daemon.
+ *
+ * Returns: A #UDisksJobScheduler. Do not free, the object is owned by @daemon.
+ */
+UDisksJobScheduler *
+udisks_daemon_get_job_scheduler (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->job_scheduler;
+}
+
+/**
+ * udisks_daemon_get_fstab_monitor:
+ * @daemon: A #UDisksDaemon
+ *
+ * Gets the fstab monitor used by @daemon.
+ *
+ * Returns: A #UDisksFstabMonitor. Do not free, the object is owned by @daemon.
+ */
+UDisksFstabMonitor *
+udisks_daemon_get_fstab_monitor (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->fstab_monitor;
+}
+
 /**
  * udisks_daemon_get_crypttab_monitor:
  * @daemon: A #UDisksDaemon
@@ -717,6 +859,51 @@ udisks_daemon_get_linux_provider (UDisksDaemon *daemon)
   return daemon->linux_provider;
 }
 
+/**
+ * udisks_daemon_get_authorization_cache:
+ * @daemon: A #UDisksDaemon
+ *
+ * Gets the cache of authorization decisions used by @daemon.
+ *
+ * Returns: A #UDisksAuthorizationCache. Do not free, the object is owned by @daemon.
+ */
+UDisksAuthorizationCache *
+udisks_daemon_get_authorization_cache (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->authorization_cache;
+}
+
+/**
+ * udisks_daemon_get_credentials_cache:
+ * @daemon: A #UDisksDaemon
+ *
+ * Gets the cache of caller credentials used by @daemon.
+ *
+ * Returns: A #UDisksCredentialsCache. Do not free, the object is owned by @daemon.
+ */
+UDisksCredentialsCache *
+udisks_daemon_get_credentials_cache (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->credentials_cache;
+}
+
+/**
+ * udisks_daemon_get_method_executor:
+ * @daemon: A #UDisksDaemon
+ *
+ * Gets the executor handling method calls for @daemon.
+ *
+ * Returns: A #UDisksMethodExecutor. Do not free, the object is owned by @daemon.
+ */
+UDisksMethodExecutor *
+udisks_daemon_get_method_executor (UDisksDaemon *daemon)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+  return daemon->method_executor;
+}
+
 /**
  * udisks_daemon_get_authority:
  * @daemon: A #UDisksDaemon.
@@ -849,7 +1036,8 @@ common_job (UDisksDaemon    *daemon,
  * @job_started_by_uid: The user who started the job.
  * @cancellable: A #GCancellable or %NULL.
  *
- * Launches a new simple job.
+ * Launches a new simple job. Blocks until the job has been admitted
+ * by the #UDisksJobScheduler for the drives of @object.
  *
  * The returned object will be exported on the bus until the
  * #UDisksJob::completed signal is emitted on the object. It is not
@@ -865,12 +1053,19 @@ udisks_daemon_launch_simple_job (UDisksDaemon    *daemon,
                                  uid_t            job_started_by_uid,
                                  GCancellable    *cancellable)
 {
-  UDisksSimpleJob *job;
+  UDisksBaseJob *job;
 
   g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
 
-  job = udisks_simple_job_new (daemon, cancellable);
-  return common_job (daemon, object, job_operation, job_started_by_uid, job);
+  job = common_job (daemon, object, job_operation, job_started_by_uid,
+                    udisks_simple_job_new (daemon, cancellable));
+
+  /* the work is done by the caller once we return, wait for a free slot on the drives */
+  udisks_method_executor_begin_blocking ();
+  udisks_job_scheduler_wait (daemon->job_scheduler, job);
+  udisks_method_executor_end_blocking ();
+
+  return job;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1239,7 +1434,9 @@ udisks_daemon_launch_spawned_job_gstring_sync (UDisksDaemon    *daemon,
                           &data);
 
   udisks_spawned_job_start (UDISKS_SPAWNED_JOB (job));
+  udisks_method_executor_begin_blocking ();
   g_main_loop_run (data.loop);
+  udisks_method_executor_end_blocking ();
 
   if (out_status != NULL)
     *out_status = data.status;
@@ -1350,27 +1547,88 @@ udisks_daemon_launch_threaded_job_sync (UDisksDaemon          *daemon,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-typedef struct {
-  GMainContext *context;
-  GMainLoop *loop;
-  gboolean timed_out;
-} WaitData;
+/**
+ * udisks_daemon_notify_objects_changed:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Notifies threads blocked in udisks_daemon_wait_for_object_sync() and
+ * friends that exported objects (or their properties) have changed and
+ * that their wait functions should be re-evaluated.
+ *
+ * Exporting and unexporting objects, adding or removing interfaces and
+ * changing properties of exported interfaces notifies waiters
+ * automatically. Providers and modules only need to call this function
+ * when changing state that wait functions look at but that is not
+ * exposed as a D-Bus property.
+ *
+ * This function is thread-safe.
+ */
+void
+udisks_daemon_notify_objects_changed (UDisksDaemon *daemon)
+{
+  g_return_if_fail (UDISKS_IS_DAEMON (daemon));
 
-static gboolean
-wait_on_timed_out (gpointer user_data)
+  g_mutex_lock (&daemon->objects_changed_lock);
+  daemon->objects_changed_seq++;
+  g_cond_broadcast (&daemon->objects_changed_cond);
+  g_mutex_unlock (&daemon->objects_changed_lock);
+}
+
+static void
+on_objects_changed (gpointer user_data)
 {
-  WaitData *data = user_data;
-  data->timed_out = TRUE;
-  g_main_loop_quit (data->loop);
-  return FALSE; /* remove the source */
+  udisks_daemon_notify_objects_changed (UDISKS_DAEMON (user_data));
 }
 
-static gboolean
-wait_on_recheck (gpointer user_data)
+static void
+on_interface_property_notify (GObject    *interface,
+                              GParamSpec *pspec,
+                              gpointer    user_data)
 {
-  WaitData *data = user_data;
-  g_main_loop_quit (data->loop);
-  return FALSE; /* remove the source */
+  udisks_daemon_notify_objects_changed (UDISKS_DAEMON (user_data));
+}
+
+static void
+attach_interface (UDisksDaemon           *daemon,
+                  GDBusInterfaceSkeleton *interface)
+{
+  udisks_method_executor_attach (daemon->method_executor, interface);
+
+  /* let threads blocked in wait_for_objects() re-check on property changes,
+   * the same skeleton may be added again after having been removed */
+  if (g_signal_handler_find (interface, G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA,
+                             0, 0, NULL, on_interface_property_notify, daemon) == 0)
+    g_signal_connect_object (interface, "notify", G_CALLBACK (on_interface_property_notify), daemon, 0);
+}
+
+static void
+on_object_added (GDBusObjectManager *manager,
+                 GDBusObject        *object,
+                 gpointer            user_data)
+{
+  UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
+  GList *interfaces;
+  GList *l;
+
+  interfaces = g_dbus_object_get_interfaces (object);
+  for (l = interfaces; l != NULL; l = l->next)
+    {
+      if (G_IS_DBUS_INTERFACE_SKELETON (l->data))
+        attach_interface (daemon, G_DBUS_INTERFACE_SKELETON (l->data));
+    }
+  g_list_free_full (interfaces, g_object_unref);
+}
+
+static void
+on_interface_added (GDBusObjectManager *manager,
+                    GDBusObject        *object,
+                    GDBusInterface     *interface,
+                    gpointer            user_data)
+{
+  UDisksDaemon *daemon = UDISKS_DAEMON (user_data);
+
+  if (G_IS_DBUS_INTERFACE_SKELETON (interface))
+    attach_interface (daemon, G_DBUS_INTERFACE_SKELETON (interface));
 }
 
 static gpointer wait_for_objects (UDisksDaemon                *daemon,
@@ -1382,56 +1640,51 @@ static gpointer wait_for_objects (UDisksDaemon                *daemon,
                                   GError                     **error)
 {
   gpointer ret;
-  WaitData data;
-
-  /* TODO: support GCancellable */
+  guint64 seq;
+  gint64 end_time;
+  gboolean timed_out = FALSE;
 
   g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
   g_return_val_if_fail (wait_func != NULL, NULL);
 
   ret = NULL;
 
-  memset (&data, '\0', sizeof (data));
-  data.context = NULL;
-  data.loop = NULL;
-
   g_object_ref (daemon);
 
+  end_time = g_get_monotonic_time () + (gint64) timeout_seconds * G_TIME_SPAN_SECOND;
+
+  /* Sample the sequence number before calling @wait_func so that changes
+   * happening while it runs are not missed.
+   *
+   * Note that this will block until the timeout if we are calling from the
+   * main thread since uevents are processed there.
+   */
+  g_mutex_lock (&daemon->objects_changed_lock);
+  seq = daemon->objects_changed_seq;
+  g_mutex_unlock (&daemon->objects_changed_lock);
+
  again:
   ret = wait_func (daemon, user_data);
 
   if ((!to_disappear && ret == NULL && timeout_seconds > 0) ||
       (to_disappear && ret != NULL && timeout_seconds > 0))
     {
-      GSource *source;
-
-      /* sit and wait for up to @timeout_seconds if the object isn't there already */
-      if (data.context == NULL)
+      /* sit and wait for up to @timeout_seconds for something to change */
+      udisks_method_executor_begin_blocking ();
+      g_mutex_lock (&daemon->objects_changed_lock);
+      while (seq == daemon->objects_changed_seq)
         {
-          /* TODO: this will deadlock if we are calling from the main thread... */
-          data.context = g_main_context_new ();
-          data.loop = g_main_loop_new (data.context, FALSE);
-
-          source = g_timeout_source_new_seconds (timeout_seconds);
-          g_source_set_priority (source, G_PRIORITY_DEFAULT);
-          g_source_set_callback (source, wait_on_timed_out, &data, NULL);
-          g_source_attach (source, data.context);
-          g_source_unref (source);
+          if (!g_cond_wait_until (&daemon->objects_changed_cond, &daemon->objects_changed_lock, end_time))
+            {
+              timed_out = TRUE;
+              break;
+            }
         }
+      seq = daemon->objects_changed_seq;
+      g_mutex_unlock (&daemon->objects_changed_lock);
+      udisks_method_executor_end_blocking ();
 
-      /* TODO: do something a bit more elegant than checking every 250ms ... it's
-       *       probably going to involve having each UDisksProvider emit a "changed"
-       *       signal when it's time to recheck... for now this works.
-       */
-      source = g_timeout_source_new (250);
-      g_source_set_priority (source, G_PRIORITY_DEFAULT);
-      g_source_set_callback (source, wait_on_recheck, &data, NULL);
-      g_source_attach (source, data.context);
-      g_source_unref (source);
-
-      g_main_loop_run (data.loop);
-
-      if (data.timed_out)
+      if (timed_out)
         {
           if (to_disappear)
             g_set_error (error,
@@ -1455,11 +1708,6 @@ static gpointer wait_for_objects (UDisksDaemon                *daemon,
 
   g_object_unref (daemon);
 
-  if (data.loop != NULL)
-    g_main_loop_unref (data.loop);
-  if (data.context != NULL)
-    g_main_context_unref (data.context);
-
   return ret;
 }
 
@@ -1477,8 +1725,9 @@ static gpointer wait_for_objects (UDisksDaemon                *daemon,
  * available or until @timeout_seconds has passed (in which case the
  * function fails with %UDISKS_ERROR_TIMED_OUT).
  *
- * Note that @wait_func will be called from time to time - for example
- * if there is a device event.
+ * Note that @wait_func will be called whenever exported objects change
+ * - for example if there is a device event, see
+ * udisks_daemon_notify_objects_changed().
  *
  * Returns: (transfer full): The object picked by @wait_func or %NULL if @error is set.
  */
@@ -1512,8 +1761,9 @@ udisks_daemon_wait_for_object_sync (UDisksDaemon               *daemon,
  * is/are available or until @timeout_seconds has passed (in which case the
  * function fails with %UDISKS_ERROR_TIMED_OUT).
  *
- * Note that @wait_func will be called from time to time - for example
- * if there is a device event.
+ * Note that @wait_func will be called whenever exported objects change
+ * - for example if there is a device event, see
+ * udisks_daemon_notify_objects_changed().
  *
  * Returns: (transfer full): The objects picked by @wait_func or %NULL if @error is set.
  */
@@ -1548,8 +1798,8 @@ udisks_daemon_wait_for_objects_sync (UDisksDaemon                 *daemon,
  * until @timeout_seconds has passed (in which case the function fails with
  * %UDISKS_ERROR_TIMED_OUT).
  *
- * Note that @wait_func will be called from time to time - for example
- * if there is a device event. For consistency @wait_func is supposed
+ * Note that @wait_func will be called whenever exported objects change
+ * - for example if there is a device event. For consistency @wait_func is supposed
  * to return full reference to an existing object; udisks_daemon_wait_for_object_to_disappear_sync()
  * will take care of dropping the reference after each iteration.
  *
@@ -1581,6 +1831,424 @@ udisks_daemon_wait_for_object_to_disappear_sync (UDisksDaemon               *dae
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* The block lookups below are served from hash indexes of all exported
+ * objects with the Block interface. The indexes are updated when objects
+ * are exported/unexported, when the Block or Partition interface is
+ * added/removed and when the relevant Block or Partition properties (or
+ * the #UDisksLinuxDevice of a #UDisksLinuxBlockObject) change. The indexed
+ * objects are not referenced, the object manager holds a reference for as
+ * long as they're exported. Every key maps to all objects carrying it, in
+ * the order they were indexed. Even keys that should be unique can be
+ * shared for a while (e.g. a device number reused before the old object
+ * is removed), lookups of those return the most recently indexed object.
+ */
+
+typedef struct
+{
+  UDisksDaemon *daemon;        /* not referenced */
+  UDisksObject *object;        /* not referenced */
+  UDisksBlock  *block;
+  UDisksPartition *partition;
+  gulong        block_notify_id;
+  gulong        partition_notify_id;
+  gulong        device_notify_id;
+
+  /* indexed keys */
+  gint64        dev;
+  gchar        *device_file;
+  gchar       **symlinks;
+  gchar        *sysfs_path;
+  gchar        *id_uuid;
+  gchar        *id_label;
+  gchar        *part_uuid;
+  gchar        *part_name;
+} BlockIndexEntry;
+
+static void block_index_update (UDisksDaemon *daemon,
+                                UDisksObject *object,
+                                gboolean      add);
+
+static gpointer
+block_index_dup_dev (gpointer key)
+{
+  gint64 *ret = g_new (gint64, 1);
+  *ret = *(const gint64 *) key;
+  return ret;
+}
+
+/* called with block_index_lock held */
+static void
+block_index_add_key (GHashTable     *index,
+                     gconstpointer   key,
+                     GBoxedCopyFunc  key_copy,
+                     UDisksObject   *object)
+{
+  GPtrArray *objects;
+
+  objects = g_hash_table_lookup (index, key);
+  if (objects == NULL)
+    {
+      objects = g_ptr_array_new ();
+      g_hash_table_insert (index, key_copy ((gpointer) key), objects);
+    }
+  g_ptr_array_add (objects, object);
+}
+
+/* called with block_index_lock held */
+static void
+block_index_remove_key (GHashTable    *index,
+                        gconstpointer  key,
+                        UDisksObject  *object)
+{
+  GPtrArray *objects;
+
+  /* other objects with the same key stay indexed */
+  objects = g_hash_table_lookup (index, key);
+  if (objects != NULL && g_ptr_array_remove (objects, object) && objects->len == 0)
+    g_hash_table_remove (index, key);
+}
+
+/* called with block_index_lock held */
+static void
+block_index_add_str_key (GHashTable   *index,
+                         const gchar  *key,
+                         UDisksObject *object)
+{
+  if (key != NULL && key[0] != '\0')
+    block_index_add_key (index, key, (GBoxedCopyFunc) g_strdup, object);
+}
+
+/* called with block_index_lock held */
+static void
+block_index_remove_str_key (GHashTable   *index,
+                            const gchar  *key,
+                            UDisksObject *object)
+{
+  if (key != NULL && key[0] != '\0')
+    block_index_remove_key (index, key, object);
+}
+
+/* called with block_index_lock held */
+static void
+block_index_entry_remove_keys (BlockIndexEntry *entry)
+{
+  UDisksDaemon *daemon = entry->daemon;
+  guint n;
+
+  block_index_remove_key (daemon->block_by_dev, &entry->dev, entry->object);
+  block_index_remove_str_key (daemon->block_by_device_file, entry->device_file, entry->object);
+  for (n = 0; entry->symlinks != NULL && entry->symlinks[n] != NULL; n++)
+    block_index_remove_str_key (daemon->block_by_symlink, entry->symlinks[n], entry->object);
+  block_index_remove_str_key (daemon->block_by_sysfs_path, entry->sysfs_path, entry->object);
+  block_index_remove_str_key (daemon->blocks_by_id_uuid, entry->id_uuid, entry->object);
+  block_index_remove_str_key (daemon->blocks_by_id_label, entry->id_label, entry->object);
+  block_index_remove_str_key (daemon->blocks_by_part_uuid, entry->part_uuid, entry->object);
+  block_index_remove_str_key (daemon->blocks_by_part_name, entry->part_name, entry->object);
+
+  g_clear_pointer (&entry->device_file, g_free);
+  g_clear_pointer (&entry->symlinks, g_strfreev);
+  g_clear_pointer (&entry->sysfs_path, g_free);
+  g_clear_pointer (&entry->id_uuid, g_free);
+  g_clear_pointer (&entry->id_label, g_free);
+  g_clear_pointer (&entry->part_uuid, g_free);
+  g_clear_pointer (&entry->part_name, g_free);
+}
+
+/* called with block_index_lock held */
+static void
+block_index_entry_add_keys (BlockIndexEntry *entry)
+{
+  UDisksDaemon *daemon = entry->daemon;
+  guint n;
+
+  entry->dev = udisks_block_get_device_number (entry->block);
+  entry->device_file = udisks_block_dup_device (entry->block);
+  entry->symlinks = udisks_block_dup_symlinks (entry->block);
+  entry->id_uuid = udisks_block_dup_id_uuid (entry->block);
+  entry->id_label = udisks_block_dup_id_label (entry->block);
+  if (entry->partition != NULL)
+    {
+      entry->part_uuid = udisks_partition_dup_uuid (entry->partition);
+      entry->part_name = udisks_partition_dup_name (entry->partition);
+    }
+  if (UDISKS_IS_LINUX_BLOCK_OBJECT (entry->object))
+    {
+      UDisksLinuxDevice *device;
+
+      device = udisks_linux_block_object_get_device (UDISKS_LINUX_BLOCK_OBJECT (entry->object));
+      if (device != NULL)
+        {
+          entry->sysfs_path = g_strdup (g_udev_device_get_sysfs_path (device->udev_device));
+          g_object_unref (device);
+        }
+    }
+
+  block_index_add_key (daemon->block_by_dev, &entry->dev, block_index_dup_dev, entry->object);
+  block_index_add_str_key (daemon->block_by_device_file, entry->device_file, entry->object);
+  for (n = 0; entry->symlinks != NULL && entry->symlinks[n] != NULL; n++)
+    block_index_add_str_key (daemon->block_by_symlink, entry->symlinks[n], entry->object);
+  block_index_add_str_key (daemon->block_by_sysfs_path, entry->sysfs_path, entry->object);
+  block_index_add_str_key (daemon->blocks_by_id_uuid, entry->id_uuid, entry->object);
+  block_index_add_str_key (daemon->blocks_by_id_label, entry->id_label, entry->object);
+  block_index_add_str_key (daemon->blocks_by_part_uuid, entry->part_uuid, entry->object);
+  block_index_add_str_key (daemon->blocks_by_part_name, entry->part_name, entry->object);
+}
+
+/* The notify handlers get the daemon rather than the BlockIndexEntry, the
+ * entry may be freed by another thread while they run. The entry of the
+ * object is looked up again under the lock by block_index_update().
+ */
+static void
+block_index_update_interface_object (UDisksDaemon   *daemon,
+                                     GDBusInterface *interface)
+{
+  GDBusObject *object;
+
+  object = g_dbus_interface_dup_object (interface);
+  if (object != NULL)
+    {
+      if (UDISKS_IS_OBJECT (object))
+        block_index_update (daemon, UDISKS_OBJECT (object), FALSE);
+      g_object_unref (object);
+    }
+}
+
+static void
+on_block_index_block_notify (GObject    *block,
+                             GParamSpec *pspec,
+                             gpointer    user_data)
+{
+  if (g_strcmp0 (pspec->name, "device-number") == 0 ||
+      g_strcmp0 (pspec->name, "device") == 0 ||
+      g_strcmp0 (pspec->name, "symlinks") == 0 ||
+      g_strcmp0 (pspec->name, "id-uuid") == 0 ||
+      g_strcmp0 (pspec->name, "id-label") == 0)
+    block_index_update_interface_object (UDISKS_DAEMON (user_data), G_DBUS_INTERFACE (block));
+}
+
+static void
+on_block_index_partition_notify (GObject    *partition,
+                                 GParamSpec *pspec,
+                                 gpointer    user_data)
+{
+  if (g_strcmp0 (pspec->name, "uuid") == 0 ||
+      g_strcmp0 (pspec->name, "name") == 0)
+    block_index_update_interface_object (UDISKS_DAEMON (user_data), G_DBUS_INTERFACE (partition));
+}
+
+/* called with block_index_lock held */
+static void
+block_index_entry_set_partition (BlockIndexEntry *entry,
+                                 UDisksPartition *partition)
+{
+  if (entry->partition == partition)
+    return;
+
+  if (entry->partition != NULL)
+    {
+      g_signal_handler_disconnect (entry->partition, entry->partition_notify_id);
+      entry->partition_notify_id = 0;
+      g_clear_object (&entry->partition);
+    }
+  if (partition != NULL)
+    {
+      entry->partition = g_object_ref (partition);
+      entry->partition_notify_id = g_signal_connect (partition,
+                                                     "notify",
+                                                     G_CALLBACK (on_block_index_partition_notify),
+                                                     entry->daemon);
+    }
+}
+
+static void
+on_block_index_device_notify (GObject    *object,
+                              GParamSpec *pspec,
+                              gpointer    user_data)
+{
+  block_index_update (UDISKS_DAEMON (user_data), UDISKS_OBJECT (object), FALSE);
+}
+
+/* called with block_index_lock held */
+static void
+block_index_entry_free (gpointer data)
+{
+  BlockIndexEntry *entry = data;
+
+  block_index_entry_remove_keys (entry);
+  block_index_entry_set_partition (entry, NULL);
+  g_signal_handler_disconnect (entry->block, entry->block_notify_id);
+  if (entry->device_notify_id != 0)
+    g_signal_handler_disconnect (entry->object, entry->device_notify_id);
+  g_object_unref (entry->block);
+  g_slice_free (BlockIndexEntry, entry);
+}
+
+/* (Re-)indexes @object, or drops it from the indexes if it doesn't have the
+ * Block interface anymore. Objects not yet in the indexes are only added if
+ * @add is %TRUE so that late notifications can't resurrect unexported objects.
+ */
+static void
+block_index_update (UDisksDaemon *daemon,
+                    UDisksObject *object,
+                    gboolean      add)
+{
+  BlockIndexEntry *entry;
+  UDisksBlock *block;
+  UDisksPartition *partition;
+
+  block = udisks_object_get_block (object);
+  partition = udisks_object_get_partition (object);
+
+  g_mutex_lock (&daemon->block_index_lock);
+  entry = g_hash_table_lookup (daemon->block_index_entries, object);
+  if (entry != NULL && entry->block != block)
+    {
+      /* the Block interface was removed or replaced */
+      g_hash_table_remove (daemon->block_index_entries, object);
+      entry = NULL;
+      add = add || block != NULL;
+    }
+
+  if (block == NULL)
+    goto out;
+
+  if (entry == NULL)
+    {
+      if (!add)
+        goto out;
+      entry = g_slice_new0 (BlockIndexEntry);
+      entry->daemon = daemon;
+      entry->object = object;
+      entry->block = g_object_ref (block);
+      entry->block_notify_id = g_signal_connect (block,
+                                                 "notify",
+                                                 G_CALLBACK (on_block_index_block_notify),
+                                                 daemon);
+      if (UDISKS_IS_LINUX_BLOCK_OBJECT (object))
+        entry->device_notify_id = g_signal_connect (object,
+                                                    "notify::device",
+                                                    G_CALLBACK (on_block_index_device_notify),
+                                                    daemon);
+      g_hash_table_insert (daemon->block_index_entries, object, entry);
+    }
+  else
+    {
+      block_index_entry_remove_keys (entry);
+    }
+  block_index_entry_set_partition (entry, partition);
+  block_index_entry_add_keys (entry);
+
+ out:
+  g_mutex_unlock (&daemon->block_index_lock);
+  g_clear_object (&partition);
+  g_clear_object (&block);
+}
+
+static void
+block_index_remove (UDisksDaemon *daemon,
+                    UDisksObject *object)
+{
+  g_mutex_lock (&daemon->block_index_lock);
+  g_hash_table_remove (daemon->block_index_entries, object);
+  g_mutex_unlock (&daemon->block_index_lock);
+}
+
+static void
+on_block_index_object_added (GDBusObjectManager *manager,
+                             GDBusObject        *object,
+                             gpointer            user_data)
+{
+  if (UDISKS_IS_OBJECT (object))
+    block_index_update (UDISKS_DAEMON (user_data), UDISKS_OBJECT (object), TRUE);
+}
+
+static void
+on_block_index_object_removed (GDBusObjectManager *manager,
+                               GDBusObject        *object,
+                               gpointer            user_data)
+{
+  if (UDISKS_IS_OBJECT (object))
+    block_index_remove (UDISKS_DAEMON (user_data), UDISKS_OBJECT (object));
+}
+
+static void
+on_block_index_interface_changed (GDBusObjectManager *manager,
+                                  GDBusObject        *object,
+                                  GDBusInterface     *interface,
+                                  gpointer            user_data)
+{
+  if (UDISKS_IS_OBJECT (object) && (UDISKS_IS_BLOCK (interface) || UDISKS_IS_PARTITION (interface)))
+    block_index_update (UDISKS_DAEMON (user_data), UDISKS_OBJECT (object), TRUE);
+}
+
+static void
+block_index_init (UDisksDaemon *daemon)
+{
+  g_mutex_init (&daemon->block_index_lock);
+  daemon->block_index_entries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, block_index_entry_free);
+  daemon->block_by_dev = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->block_by_device_file = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->block_by_symlink = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->block_by_sysfs_path = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->blocks_by_id_uuid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->blocks_by_id_label = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->blocks_by_part_uuid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  daemon->blocks_by_part_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+
+  g_signal_connect (daemon->object_manager,
+                    "object-added",
+                    G_CALLBACK (on_block_index_object_added),
+                    daemon);
+  g_signal_connect (daemon->object_manager,
+                    "object-removed",
+                    G_CALLBACK (on_block_index_object_removed),
+                    daemon);
+  g_signal_connect (daemon->object_manager,
+                    "interface-added",
+                    G_CALLBACK (on_block_index_interface_changed),
+                    daemon);
+  g_signal_connect (daemon->object_manager,
+                    "interface-removed",
+                    G_CALLBACK (on_block_index_interface_changed),
+                    daemon);
+}
+
+static void
+block_index_clear (UDisksDaemon *daemon)
+{
+  g_signal_handlers_disconnect_by_data (daemon->object_manager, daemon);
+
+  g_mutex_lock (&daemon->block_index_lock);
+  g_hash_table_destroy (daemon->block_index_entries);
+  g_hash_table_destroy (daemon->block_by_dev);
+  g_hash_table_destroy (daemon->block_by_device_file);
+  g_hash_table_destroy (daemon->block_by_symlink);
+  g_hash_table_destroy (daemon->block_by_sysfs_path);
+  g_hash_table_destroy (daemon->blocks_by_id_uuid);
+  g_hash_table_destroy (daemon->blocks_by_id_label);
+  g_hash_table_destroy (daemon->blocks_by_part_uuid);
+  g_hash_table_destroy (daemon->blocks_by_part_name);
+  g_mutex_unlock (&daemon->block_index_lock);
+  g_mutex_clear (&daemon->block_index_lock);
+}
+
+static UDisksObject *
+block_index_lookup (UDisksDaemon  *daemon,
+                    GHashTable    *index,
+                    gconstpointer  key)
+{
+  UDisksObject *ret = NULL;
+  GPtrArray *objects;
+
+  g_mutex_lock (&daemon->block_index_lock);
+  objects = g_hash_table_lookup (index, key);
+  if (objects != NULL)
+    ret = g_object_ref (objects->pdata[objects->len - 1]);
+  g_mutex_unlock (&daemon->block_index_lock);
+
+  return ret;
+}
+
 /**
  * udisks_daemon_find_block:
  * @daemon: A #UDisksDaemon.
@@ -1594,28 +2262,11 @@ UDisksObject *
 udisks_daemon_find_block (UDisksDaemon *daemon,
                           dev_t         block_device_number)
 {
-  UDisksObject *ret = NULL;
-  GList *objects, *l;
+  gint64 key = block_device_number;
 
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (daemon->object_manager));
-  for (l = objects; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      UDisksBlock *block;
-
-      block = udisks_object_peek_block (object);
-      if (block == NULL)
-        continue;
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
 
-      if (udisks_block_get_device_number (block) == block_device_number)
-        {
-          ret = g_object_ref (object);
-          goto out;
-        }
-    }
- out:
-  g_list_free_full (objects, g_object_unref);
-  return ret;
+  return block_index_lookup (daemon, daemon->block_by_dev, &key);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1633,28 +2284,35 @@ UDisksObject *
 udisks_daemon_find_block_by_device_file (UDisksDaemon *daemon,
                                          const gchar  *device_file)
 {
-  UDisksObject *ret = NULL;
-  GList *objects, *l;
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
 
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (daemon->object_manager));
-  for (l = objects; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      UDisksBlock *block;
+  if (device_file == NULL)
+    return NULL;
 
-      block = udisks_object_peek_block (object);
-      if (block == NULL)
-        continue;
+  return block_index_lookup (daemon, daemon->block_by_device_file, device_file);
+}
 
-      if (g_strcmp0 (udisks_block_get_device (block), device_file) == 0)
-        {
-          ret = g_object_ref (object);
-          goto out;
-        }
-    }
- out:
-  g_list_free_full (objects, g_object_unref);
-  return ret;
+/* ---------------------------------------------------------------------------------------------------- */
+
+/**
+ * udisks_daemon_find_block_by_symlink:
+ * @daemon: A #UDisksDaemon.
+ * @symlink: A symlink to a device file, e.g. <filename>/dev/disk/by-id/...</filename>.
+ *
+ * Finds a block device with @symlink in its #UDisksBlock:symlinks property.
+ *
+ * Returns: (transfer full): A #UDisksObject or %NULL if not found. Free with g_object_unref().
+ */
+UDisksObject *
+udisks_daemon_find_block_by_symlink (UDisksDaemon *daemon,
+                                     const gchar  *symlink)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+
+  if (symlink == NULL)
+    return NULL;
+
+  return block_index_lookup (daemon, daemon->block_by_symlink, symlink);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1672,33 +2330,111 @@ UDisksObject *
 udisks_daemon_find_block_by_sysfs_path (UDisksDaemon *daemon,
                                         const gchar  *sysfs_path)
 {
-  UDisksObject *ret = NULL;
-  GList *objects, *l;
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
 
-  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (daemon->object_manager));
-  for (l = objects; l != NULL; l = l->next)
-    {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      UDisksLinuxDevice *device;
+  if (sysfs_path == NULL)
+    return NULL;
+
+  return block_index_lookup (daemon, daemon->block_by_sysfs_path, sysfs_path);
+}
 
-      if (!UDISKS_IS_LINUX_BLOCK_OBJECT (object))
-        continue;
+/* ---------------------------------------------------------------------------------------------------- */
 
-      device = udisks_linux_block_object_get_device (UDISKS_LINUX_BLOCK_OBJECT (object));
-      if (device == NULL)
-        continue;
+static GList *
+block_index_lookup_all (UDisksDaemon *daemon,
+                        GHashTable   *index,
+                        const gchar  *key)
+{
+  GList *ret = NULL;
+  GPtrArray *objects;
+  guint n;
 
-      if (g_strcmp0 (g_udev_device_get_sysfs_path (device->udev_device), sysfs_path) == 0)
-        {
-          g_object_unref (device);
-          ret = g_object_ref (object);
-          goto out;
-        }
-      g_object_unref (device);
-    }
- out:
-  g_list_free_full (objects, g_object_unref);
-  return ret;
+  if (key == NULL || key[0] == '\0')
+    return NULL;
+
+  g_mutex_lock (&daemon->block_index_lock);
+  objects = g_hash_table_lookup (index, key);
+  for (n = 0; objects != NULL && n < objects->len; n++)
+    ret = g_list_prepend (ret, g_object_ref (objects->pdata[n]));
+  g_mutex_unlock (&daemon->block_index_lock);
+
+  return g_list_reverse (ret);
+}
+
+/**
+ * udisks_daemon_find_blocks_by_uuid:
+ * @daemon: A #UDisksDaemon.
+ * @uuid: A filesystem or other content UUID.
+ *
+ * Finds all block devices with @uuid as their #UDisksBlock:id-uuid property.
+ *
+ * Returns: (transfer full) (element-type UDisksObject): A list of
+ * #UDisksObject instances. Free with g_list_free_full() and g_object_unref().
+ */
+GList *
+udisks_daemon_find_blocks_by_uuid (UDisksDaemon *daemon,
+                                   const gchar  *uuid)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+
+  return block_index_lookup_all (daemon, daemon->blocks_by_id_uuid, uuid);
+}
+
+/**
+ * udisks_daemon_find_blocks_by_label:
+ * @daemon: A #UDisksDaemon.
+ * @label: A filesystem or other content label.
+ *
+ * Finds all block devices with @label as their #UDisksBlock:id-label property.
+ *
+ * Returns: (transfer full) (element-type UDisksObject): A list of
+ * #UDisksObject instances. Free with g_list_free_full() and g_object_unref().
+ */
+GList *
+udisks_daemon_find_blocks_by_label (UDisksDaemon *daemon,
+                                    const gchar  *label)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+
+  return block_index_lookup_all (daemon, daemon->blocks_by_id_label, label);
+}
+
+/**
+ * udisks_daemon_find_blocks_by_partuuid:
+ * @daemon: A #UDisksDaemon.
+ * @partuuid: A partition UUID.
+ *
+ * Finds all partitions with @partuuid as their #UDisksPartition:uuid property.
+ *
+ * Returns: (transfer full) (element-type UDisksObject): A list of
+ * #UDisksObject instances. Free with g_list_free_full() and g_object_unref().
+ */
+GList *
+udisks_daemon_find_blocks_by_partuuid (UDisksDaemon *daemon,
+                                       const gchar  *partuuid)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+
+  return block_index_lookup_all (daemon, daemon->blocks_by_part_uuid, partuuid);
+}
+
+/**
+ * udisks_daemon_find_blocks_by_partlabel:
+ * @daemon: A #UDisksDaemon.
+ * @partlabel: A partition label.
+ *
+ * Finds all partitions with @partlabel as their #UDisksPartition:name property.
+ *
+ * Returns: (transfer full) (element-type UDisksObject): A list of
+ * #UDisksObject instances. Free with g_list_free_full() and g_object_unref().
+ */
+GList *
+udisks_daemon_find_blocks_by_partlabel (UDisksDaemon *daemon,
+                                        const gchar  *partlabel)
+{
+  g_return_val_if_fail (UDISKS_IS_DAEMON (daemon), NULL);
+
+  return block_index_lookup_all (daemon, daemon->blocks_by_part_name, partlabel);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -39,12 +39,17 @@ UDisksDaemon             *udisks_daemon_new                  (GDBusConnection *c
 GDBusConnection          *udisks_daemon_get_connection        (UDisksDaemon    *daemon);
 GDBusObjectManagerServer *udisks_daemon_get_object_manager    (UDisksDaemon    *daemon);
 UDisksMountMonitor       *udisks_daemon_get_mount_monitor     (UDisksDaemon    *daemon);
+UDisksFstabMonitor       *udisks_daemon_get_fstab_monitor     (UDisksDaemon    *daemon);
+UDisksJobScheduler       *udisks_daemon_get_job_scheduler     (UDisksDaemon    *daemon);
 UDisksCrypttabMonitor    *udisks_daemon_get_crypttab_monitor  (UDisksDaemon    *daemon);
 #ifdef HAVE_LIBMOUNT_UTAB
 UDisksUtabMonitor        *udisks_daemon_get_utab_monitor      (UDisksDaemon    *daemon);
 #endif
 UDisksLinuxProvider      *udisks_daemon_get_linux_provider    (UDisksDaemon    *daemon);
 PolkitAuthority          *udisks_daemon_get_authority         (UDisksDaemon    *daemon);
+UDisksAuthorizationCache *udisks_daemon_get_authorization_cache (UDisksDaemon  *daemon);
+UDisksCredentialsCache   *udisks_daemon_get_credentials_cache (UDisksDaemon    *daemon);
+UDisksMethodExecutor     *udisks_daemon_get_method_executor   (UDisksDaemon    *daemon);
 UDisksState              *udisks_daemon_get_state             (UDisksDaemon    *daemon);
 UDisksModuleManager      *udisks_daemon_get_module_manager    (UDisksDaemon    *daemon);
 UDisksConfigManager      *udisks_daemon_get_config_manager    (UDisksDaemon    *daemon);
@@ -91,6 +96,8 @@ gboolean             udisks_daemon_wait_for_object_to_disappear_sync (UDisksDaem
                                                                       guint                       timeout_seconds,
                                                                       GError                      **error);
 
+void                      udisks_daemon_notify_objects_changed (UDisksDaemon        *daemon);
+
 GList                    *udisks_daemon_get_objects           (UDisksDaemon         *daemon);
 
 UDisksObject             *udisks_daemon_find_block            (UDisksDaemon         *daemon,
@@ -99,9 +106,24 @@ UDisksObject             *udisks_daemon_find_block            (UDisksDaemon
 UDisksObject             *udisks_daemon_find_block_by_device_file (UDisksDaemon *daemon,
                                                                    const gchar  *device_file);
 
+UDisksObject             *udisks_daemon_find_block_by_symlink (UDisksDaemon *daemon,
+                                                              const gchar  *symlink);
+
 UDisksObject             *udisks_daemon_find_block_by_sysfs_path (UDisksDaemon *daemon,
                                                                   const gchar  *sysfs_path);
 
+GList                    *udisks_daemon_find_blocks_by_uuid   (UDisksDaemon         *daemon,
+                                                               const gchar          *uuid);
+
+GList                    *udisks_daemon_find_blocks_by_label  (UDisksDaemon         *daemon,
+                                                               const gchar          *label);
+
+GList                    *udisks_daemon_find_blocks_by_partuuid (UDisksDaemon       *daemon,
+                                                                 const gchar        *partuuid);
+
+GList                    *udisks_daemon_find_blocks_by_partlabel (UDisksDaemon      *daemon,
+                                                                  const gchar       *partlabel);
+
 UDisksObject             *udisks_daemon_find_object           (UDisksDaemon         *daemon,
                                                                const gchar          *object_path);
 
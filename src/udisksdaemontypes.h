@@ -95,6 +95,21 @@ typedef struct _UDisksLinuxSwapspace UDisksLinuxSwapspace;
 struct _UDisksFstabEntry;
 typedef struct _UDisksFstabEntry UDisksFstabEntry;
 
+struct _UDisksFstabMonitor;
+typedef struct _UDisksFstabMonitor UDisksFstabMonitor;
+
+struct _UDisksJobScheduler;
+typedef struct _UDisksJobScheduler UDisksJobScheduler;
+
+struct _UDisksAuthorizationCache;
+typedef struct _UDisksAuthorizationCache UDisksAuthorizationCache;
+
+struct _UDisksCredentialsCache;
+typedef struct _UDisksCredentialsCache UDisksCredentialsCache;
+
+struct _UDisksMethodExecutor;
+typedef struct _UDisksMethodExecutor UDisksMethodExecutor;
+
 struct _UDisksCrypttabMonitor;
 typedef struct _UDisksCrypttabMonitor UDisksCrypttabMonitor;
 
@@ -37,6 +37,9 @@
 #include "udisksdaemon.h"
 #include "udisksdaemonutil.h"
 #include "udisksstate.h"
+#include "udisksauthorizationcache.h"
+#include "udiskscredentialscache.h"
+#include "udisksmethodexecutor.h"
 #include "udiskslogging.h"
 #include "udiskslinuxblockobject.h"
 #include "udiskslinuxdriveobject.h"
@@ -746,6 +749,34 @@ udisks_daemon_util_check_authorization_sync (UDisksDaemon          *daemon,
   return TRUE;
 }
 
+/* an interactive check waits for a human, don't let it hold a method executor thread */
+static PolkitAuthorizationResult *
+check_authorization_sync (PolkitAuthority               *authority,
+                          PolkitSubject                 *subject,
+                          const gchar                   *action_id,
+                          PolkitDetails                 *details,
+                          PolkitCheckAuthorizationFlags  flags,
+                          GError                       **error)
+{
+  PolkitAuthorizationResult *result;
+  gboolean interactive;
+
+  interactive = (flags & POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION) != 0;
+  if (interactive)
+    udisks_method_executor_begin_blocking ();
+  result = polkit_authority_check_authorization_sync (authority,
+                                                      subject,
+                                                      action_id,
+                                                      details,
+                                                      flags,
+                                                      NULL, /* GCancellable* */
+                                                      error);
+  if (interactive)
+    udisks_method_executor_end_blocking ();
+
+  return result;
+}
+
 gboolean
 udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *daemon,
                                                         UDisksObject           *object,
@@ -759,7 +790,11 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
   PolkitSubject *subject = NULL;
   PolkitDetails *details = NULL;
   PolkitCheckAuthorizationFlags flags = POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE;
+  PolkitCheckAuthorizationFlags check_flags;
   PolkitAuthorizationResult *result = NULL;
+  UDisksAuthorizationCache *cache;
+  guint64 cache_generation;
+  const gchar *sender;
   GError *sub_error = NULL;
   gboolean ret = FALSE;
   UDisksBlock *block = NULL;
@@ -778,7 +813,8 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
       goto out;
     }
 
-  subject = polkit_system_bus_name_new (g_dbus_method_invocation_get_sender (invocation));
+  sender = g_dbus_method_invocation_get_sender (invocation);
+  subject = polkit_system_bus_name_new (sender);
   if (options != NULL)
     {
       g_variant_lookup (options,
@@ -906,14 +942,33 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
   if (details_drive != NULL)
     polkit_details_insert (details, "drive", details_drive);
 
+  cache = udisks_daemon_get_authorization_cache (daemon);
+  if (udisks_authorization_cache_lookup (cache, sender, action_id, details))
+    {
+      ret = TRUE;
+      goto out;
+    }
+
+  /* Only decisions made without user interaction may be cached, so ask
+   * polkit without it first and only let it ask the user on a challenge.
+   */
+  check_flags = flags;
+  if (udisks_authorization_cache_get_enabled (cache))
+    check_flags = POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE;
+
+  /* polkit may change or the caller may go away while it decides */
+  cache_generation = udisks_authorization_cache_get_generation (cache);
+
   sub_error = NULL;
-  result = polkit_authority_check_authorization_sync (authority,
-                                                      subject,
-                                                      action_id,
-                                                      details,
-                                                      flags,
-                                                      NULL, /* GCancellable* */
-                                                      &sub_error);
+  result = check_authorization_sync (authority, subject, action_id, details, check_flags, &sub_error);
+  if (result != NULL && check_flags != flags &&
+      !polkit_authorization_result_get_is_authorized (result) &&
+      polkit_authorization_result_get_is_challenge (result))
+    {
+      g_clear_object (&result);
+      check_flags = flags;
+      result = check_authorization_sync (authority, subject, action_id, details, check_flags, &sub_error);
+    }
   if (result == NULL)
     {
       if (sub_error->domain != POLKIT_ERROR)
@@ -954,6 +1009,11 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
       goto out;
     }
 
+  /* temporary authorizations obtained earlier are kept by polkit itself */
+  if (check_flags == POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE &&
+      polkit_authorization_result_get_temporary_authorization_id (result) == NULL)
+    udisks_authorization_cache_add (cache, sender, action_id, details, cache_generation);
+
   ret = TRUE;
 
  out:
@@ -971,60 +1031,6 @@ udisks_daemon_util_check_authorization_sync_with_error (UDisksDaemon           *
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-static gboolean
-dbus_freedesktop_guint32_get (GDBusMethodInvocation   *invocation,
-                              GCancellable            *cancellable,
-                              const gchar             *method,
-                              guint32                 *out_value,
-                              GError                 **error)
-{
-  gboolean ret = FALSE;
-  GError *local_error = NULL;
-  GVariant *value;
-  guint32 fetched = 0;
-  const gchar *caller = g_dbus_method_invocation_get_sender (invocation);
-
-
-  value = g_dbus_connection_call_sync (g_dbus_method_invocation_get_connection (invocation),
-                                       "org.freedesktop.DBus",  /* bus name */
-                                       "/org/freedesktop/DBus", /* object path */
-                                       "org.freedesktop.DBus",  /* interface */
-                                       method, /* method */
-                                       g_variant_new ("(s)", caller),
-                                       G_VARIANT_TYPE ("(u)"),
-                                       G_DBUS_CALL_FLAGS_NONE,
-                                       -1, /* timeout_msec */
-                                       cancellable,
-                                       &local_error);
-  if (value == NULL)
-    {
-      g_set_error (error,
-                   UDISKS_ERROR,
-                   UDISKS_ERROR_FAILED,
-                   "Error determining uid of caller %s: %s (%s, %d)",
-                   caller,
-                   local_error->message,
-                   g_quark_to_string (local_error->domain),
-                   local_error->code);
-      g_clear_error (&local_error);
-      goto out;
-    }
-
-  {
-    G_STATIC_ASSERT (sizeof (uid_t) == sizeof (guint32));
-    G_STATIC_ASSERT (sizeof (pid_t) == sizeof (guint32));
-  }
-
-  g_variant_get (value, "(u)", &fetched);
-  if (out_value != NULL)
-    *out_value = fetched;
-
-  g_variant_unref (value);
-  ret = TRUE;
-out:
-  return ret;
-}
-
 /**
  * udisks_daemon_util_get_user_info:
  * @out_gid: (out) (allow-none): Return location for resolved gid or %NULL.
@@ -1095,27 +1101,51 @@ udisks_daemon_util_get_caller_uid_sync (UDisksDaemon            *daemon,
                                         uid_t                   *out_uid,
                                         GError                 **error)
 {
-  gboolean ret;
-  uid_t uid;
-
-  /* TODO: cache this on @daemon */
-
-  ret = FALSE;
-
-  if (!dbus_freedesktop_guint32_get (invocation, cancellable,
-                                     "GetConnectionUnixUser",
-                                     &uid, error))
-    {
-      goto out;
-    }
-
-  if (out_uid != NULL)
-    *out_uid = uid;
-
-  ret = TRUE;
+  return udisks_credentials_cache_lookup_sync (udisks_daemon_get_credentials_cache (daemon),
+                                               invocation,
+                                               cancellable,
+                                               out_uid,
+                                               NULL, /* out_pid */
+                                               NULL, /* out_gid */
+                                               NULL, /* out_user_name */
+                                               error);
+}
 
- out:
-  return ret;
+/**
+ * udisks_daemon_util_get_caller_user_info_sync:
+ * @daemon: A #UDisksDaemon.
+ * @invocation: A #GDBusMethodInvocation.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @out_uid: (out) (allow-none): Return location for resolved uid or %NULL.
+ * @out_gid: (out) (allow-none): Return location for resolved gid or %NULL.
+ * @out_user_name: (out) (allow-none): Return location for resolved user name or %NULL.
+ * @error: Return location for error.
+ *
+ * Gets the UNIX user id of the peer represented by @invocation along
+ * with the group and user name for it, like
+ * udisks_daemon_util_get_caller_uid_sync() followed by
+ * udisks_daemon_util_get_user_info() but without looking up the user
+ * again for every call from the same peer.
+ *
+ * Returns: %TRUE if the user information was obtained, %FALSE otherwise
+ */
+gboolean
+udisks_daemon_util_get_caller_user_info_sync (UDisksDaemon            *daemon,
+                                              GDBusMethodInvocation   *invocation,
+                                              GCancellable            *cancellable,
+                                              uid_t                   *out_uid,
+                                              gid_t                   *out_gid,
+                                              gchar                  **out_user_name,
+                                              GError                 **error)
+{
+  return udisks_credentials_cache_lookup_sync (udisks_daemon_get_credentials_cache (daemon),
+                                               invocation,
+                                               cancellable,
+                                               out_uid,
+                                               NULL, /* out_pid */
+                                               out_gid,
+                                               out_user_name,
+                                               error);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1139,15 +1169,22 @@ udisks_daemon_util_get_caller_pid_sync (UDisksDaemon            *daemon,
                                         pid_t                   *out_pid,
                                         GError                 **error)
 {
-  /* "GetConnectionUnixProcessID" */
-
-  /* TODO: cache this on @daemon */
-  /* NOTE: pid_t is a signed 32 bit, but the
-   * GetConnectionUnixProcessID dbus method returns an unsigned */
-
-  return dbus_freedesktop_guint32_get (invocation, cancellable,
-                                       "GetConnectionUnixProcessID",
-                                       (guint32*)(out_pid), error);
+  pid_t pid;
+
+  /* always ask for the pid so an error is returned if it is not known */
+  if (!udisks_credentials_cache_lookup_sync (udisks_daemon_get_credentials_cache (daemon),
+                                             invocation,
+                                             cancellable,
+                                             NULL, /* out_uid */
+                                             &pid,
+                                             NULL, /* out_gid */
+                                             NULL, /* out_user_name */
+                                             error))
+    return FALSE;
+
+  if (out_pid != NULL)
+    *out_pid = pid;
+  return TRUE;
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -91,6 +91,14 @@ gboolean udisks_daemon_util_get_caller_uid_sync (UDisksDaemon            *daemon
                                                  uid_t                   *out_uid,
                                                  GError                 **error);
 
+gboolean udisks_daemon_util_get_caller_user_info_sync (UDisksDaemon            *daemon,
+                                                       GDBusMethodInvocation   *invocation,
+                                                       GCancellable            *cancellable,
+                                                       uid_t                   *out_uid,
+                                                       gid_t                   *out_gid,
+                                                       gchar                  **out_user_name,
+                                                       GError                 **error);
+
 gboolean udisks_daemon_util_get_caller_pid_sync (UDisksDaemon            *daemon,
                                                  GDBusMethodInvocation   *invocation,
                                                  GCancellable            *cancellable,
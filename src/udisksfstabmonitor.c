@@ -0,0 +1,616 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2026 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+#include <glib/gi18n-lib.h>
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <libmount/libmount.h>
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "udisksfstabmonitor.h"
+#include "udisksfstabentry.h"
+#include "udisksprivate.h"
+#include "udiskslogging.h"
+#include "udisksdaemonutil.h"
+
+/**
+ * SECTION:udisksfstabmonitor
+ * @title: UDisksFstabMonitor
+ * @short_description: Monitors entries in the fstab file
+ *
+ * This type is used for monitoring entries in the
+ * <filename>/etc/fstab</filename> file. The parsed entries are cached
+ * and indexed by their source (e.g. <literal>/dev/sda1</literal> or
+ * <literal>UUID=...</literal>) and by the <literal>x-parent</literal>
+ * option, the cache is only refreshed when the file changes.
+ */
+
+/**
+ * UDisksFstabMonitor:
+ *
+ * The #UDisksFstabMonitor structure contains only private data and
+ * should only be accessed using the provided API.
+ */
+struct _UDisksFstabMonitor
+{
+  GObject parent_instance;
+
+  GMutex fstab_entries_mutex;
+  GList *fstab_entries;              /* in file order */
+  GHashTable *entries_by_source;     /* source -> GList of UDisksFstabEntry, in file order */
+  GHashTable *entries_by_parent;     /* x-parent UUID -> GList of UDisksFstabEntry, in file order */
+  GHashTable *entry_positions;       /* UDisksFstabEntry -> position in the file */
+
+  /* the file is re-parsed when the monitor reports a change or when the
+   * file doesn't match the last seen stat() data (e.g. right after it's
+   * been written by the daemon, before the change is reported) */
+  gboolean valid;
+  gboolean loaded;
+  struct stat fstab_stat;
+
+  GFileMonitor *file_monitor;
+
+  /* the thread-default context at construction time, signals are emitted there */
+  GMainContext *context;
+};
+
+typedef struct _UDisksFstabMonitorClass UDisksFstabMonitorClass;
+
+struct _UDisksFstabMonitorClass
+{
+  GObjectClass parent_class;
+
+  void (*entry_added)   (UDisksFstabMonitor  *monitor,
+                         UDisksFstabEntry    *entry);
+  void (*entry_removed) (UDisksFstabMonitor  *monitor,
+                         UDisksFstabEntry    *entry);
+};
+
+/*--------------------------------------------------------------------------------------------------------------*/
+
+enum
+  {
+    ENTRY_ADDED_SIGNAL,
+    ENTRY_REMOVED_SIGNAL,
+    LAST_SIGNAL,
+  };
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (UDisksFstabMonitor, udisks_fstab_monitor, G_TYPE_OBJECT)
+
+static void udisks_fstab_monitor_ensure (UDisksFstabMonitor *monitor);
+static void udisks_fstab_monitor_constructed (GObject *object);
+
+static void
+free_index (GHashTable *index)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, index);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_list_free (value);
+  g_hash_table_destroy (index);
+}
+
+static void
+udisks_fstab_monitor_finalize (GObject *object)
+{
+  UDisksFstabMonitor *monitor = UDISKS_FSTAB_MONITOR (object);
+
+  g_clear_object (&monitor->file_monitor);
+  g_main_context_unref (monitor->context);
+
+  free_index (monitor->entries_by_source);
+  free_index (monitor->entries_by_parent);
+  g_hash_table_destroy (monitor->entry_positions);
+  g_list_free_full (monitor->fstab_entries, g_object_unref);
+
+  g_mutex_clear (&monitor->fstab_entries_mutex);
+
+  if (G_OBJECT_CLASS (udisks_fstab_monitor_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (udisks_fstab_monitor_parent_class)->finalize (object);
+}
+
+static void
+udisks_fstab_monitor_init (UDisksFstabMonitor *monitor)
+{
+  g_mutex_init (&monitor->fstab_entries_mutex);
+  monitor->fstab_entries = NULL;
+  /* the lists are freed by free_index() */
+  monitor->entries_by_source = g_hash_table_new (g_str_hash, g_str_equal);
+  monitor->entries_by_parent = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  monitor->entry_positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+static void
+udisks_fstab_monitor_class_init (UDisksFstabMonitorClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+
+  gobject_class->finalize    = udisks_fstab_monitor_finalize;
+  gobject_class->constructed = udisks_fstab_monitor_constructed;
+
+  /**
+   * UDisksFstabMonitor::entry-added
+   * @monitor: A #UDisksFstabMonitor.
+   * @entry: The #UDisksFstabEntry that was added.
+   *
+   * Emitted when a fstab entry is added.
+   *
+   * This signal is emitted in the
+   * <link linkend="g-main-context-push-thread-default">thread-default main loop</link>
+   * that @monitor was created in.
+   */
+  signals[ENTRY_ADDED_SIGNAL] = g_signal_new ("entry-added",
+                                              G_OBJECT_CLASS_TYPE (klass),
+                                              G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
+                                              G_STRUCT_OFFSET (UDisksFstabMonitorClass, entry_added),
+                                              NULL,
+                                              NULL,
+                                              g_cclosure_marshal_VOID__OBJECT,
+                                              G_TYPE_NONE,
+                                              1,
+                                              UDISKS_TYPE_FSTAB_ENTRY);
+
+  /**
+   * UDisksFstabMonitor::entry-removed
+   * @monitor: A #UDisksFstabMonitor.
+   * @entry: The #UDisksFstabEntry that was removed.
+   *
+   * Emitted when a fstab entry is removed.
+   *
+   * This signal is emitted in the
+   * <link linkend="g-main-context-push-thread-default">thread-default main loop</link>
+   * that @monitor was created in.
+   */
+  signals[ENTRY_REMOVED_SIGNAL] = g_signal_new ("entry-removed",
+                                                G_OBJECT_CLASS_TYPE (klass),
+                                                G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
+                                                G_STRUCT_OFFSET (UDisksFstabMonitorClass, entry_removed),
+                                                NULL,
+                                                NULL,
+                                                g_cclosure_marshal_VOID__OBJECT,
+                                                G_TYPE_NONE,
+                                                1,
+                                                UDISKS_TYPE_FSTAB_ENTRY);
+}
+
+static void
+diff_sorted_lists (GList *list1,
+                   GList *list2,
+                   GCompareFunc compare,
+                   GList **added,
+                   GList **removed)
+{
+  int order;
+
+  *added = *removed = NULL;
+
+  while (list1 != NULL && list2 != NULL)
+    {
+      order = (*compare) (list1->data, list2->data);
+      if (order < 0)
+        {
+          *removed = g_list_prepend (*removed, list1->data);
+          list1 = list1->next;
+        }
+      else if (order > 0)
+        {
+          *added = g_list_prepend (*added, list2->data);
+          list2 = list2->next;
+        }
+      else
+        { /* same item */
+          list1 = list1->next;
+          list2 = list2->next;
+        }
+    }
+
+  while (list1 != NULL)
+    {
+      *removed = g_list_prepend (*removed, list1->data);
+      list1 = list1->next;
+    }
+  while (list2 != NULL)
+    {
+      *added = g_list_prepend (*added, list2->data);
+      list2 = list2->next;
+    }
+}
+
+static void
+on_file_monitor_changed (GFileMonitor      *file_monitor,
+                         GFile             *file,
+                         GFile             *other_file,
+                         GFileMonitorEvent  event_type,
+                         gpointer           user_data)
+{
+  UDisksFstabMonitor *monitor = UDISKS_FSTAB_MONITOR (user_data);
+  if (event_type == G_FILE_MONITOR_EVENT_CHANGED ||
+      event_type == G_FILE_MONITOR_EVENT_CREATED ||
+      event_type == G_FILE_MONITOR_EVENT_DELETED)
+    {
+      udisks_debug ("%s changed!", mnt_get_fstab_path ());
+      g_mutex_lock (&monitor->fstab_entries_mutex);
+      monitor->valid = FALSE;
+      g_mutex_unlock (&monitor->fstab_entries_mutex);
+      udisks_fstab_monitor_ensure (monitor);
+    }
+}
+
+static void
+udisks_fstab_monitor_constructed (GObject *object)
+{
+  UDisksFstabMonitor *monitor = UDISKS_FSTAB_MONITOR (object);
+  GError *error;
+  GFile *file;
+
+  monitor->context = g_main_context_ref_thread_default ();
+
+  file = g_file_new_for_path (mnt_get_fstab_path ());
+  error = NULL;
+  monitor->file_monitor = g_file_monitor_file (file,
+                                               G_FILE_MONITOR_NONE,
+                                               NULL, /* cancellable */
+                                               &error);
+  if (monitor->file_monitor == NULL)
+    {
+      udisks_critical ("Error monitoring %s: %s (%s, %d)",
+                       mnt_get_fstab_path (),
+                       error->message, g_quark_to_string (error->domain), error->code);
+      g_clear_error (&error);
+    }
+  else
+    {
+      g_signal_connect (monitor->file_monitor,
+                        "changed",
+                        G_CALLBACK (on_file_monitor_changed),
+                        monitor);
+    }
+  g_object_unref (file);
+
+  /* initial load, no signals are emitted for it */
+  udisks_fstab_monitor_ensure (monitor);
+
+  if (G_OBJECT_CLASS (udisks_fstab_monitor_parent_class)->constructed != NULL)
+    (*G_OBJECT_CLASS (udisks_fstab_monitor_parent_class)->constructed) (object);
+}
+
+/**
+ * udisks_fstab_monitor_new:
+ *
+ * Creates a new #UDisksFstabMonitor object.
+ *
+ * Signals are emitted in the <link
+ * linkend="g-main-context-push-thread-default">thread-default main
+ * loop</link> that this function is called from.
+ *
+ * Returns: A #UDisksFstabMonitor. Free with g_object_unref().
+ */
+UDisksFstabMonitor *
+udisks_fstab_monitor_new (void)
+{
+  return UDISKS_FSTAB_MONITOR (g_object_new (UDISKS_TYPE_FSTAB_MONITOR, NULL));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  UDisksFstabMonitor *monitor;
+  UDisksFstabEntry *entry;
+  guint signal_id;
+} FstabEntryChangedData;
+
+static gboolean
+fstab_entry_changed_cb (gpointer user_data)
+{
+  FstabEntryChangedData *data = user_data;
+
+  g_signal_emit (data->monitor, signals[data->signal_id], 0, data->entry);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+free_fstab_entry_changed_data (gpointer user_data)
+{
+  FstabEntryChangedData *data = user_data;
+
+  g_object_unref (data->monitor);
+  g_object_unref (data->entry);
+  g_free (data);
+}
+
+static void
+emit_entry_changed (UDisksFstabMonitor *monitor,
+                    UDisksFstabEntry   *entry,
+                    guint               signal_id)
+{
+  FstabEntryChangedData *data;
+  GSource *source;
+
+  data = g_new0 (FstabEntryChangedData, 1);
+  data->monitor = g_object_ref (monitor);
+  data->signal_id = signal_id;
+  data->entry = g_object_ref (entry);
+
+  /* always deferred, we're called with fstab_entries_mutex held */
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_DEFAULT_IDLE);
+  g_source_set_callback (source, fstab_entry_changed_cb, data, free_fstab_entry_changed_data);
+  g_source_attach (source, monitor->context);
+  g_source_unref (source);
+}
+
+/* prepends @entry to the list for @key in @index; if @index has a key
+ * destroy function, it takes ownership of @key */
+static void
+index_prepend (GHashTable       *index,
+               gchar            *key,
+               UDisksFstabEntry *entry)
+{
+  GList *list;
+
+  list = g_hash_table_lookup (index, key);
+  g_hash_table_insert (index, key, g_list_prepend (list, entry));
+}
+
+/* must be called with fstab_entries_mutex held */
+static void
+rebuild_indexes (UDisksFstabMonitor *monitor)
+{
+  GList *l;
+  guint position;
+
+  free_index (monitor->entries_by_source);
+  free_index (monitor->entries_by_parent);
+  g_hash_table_destroy (monitor->entry_positions);
+  monitor->entries_by_source = g_hash_table_new (g_str_hash, g_str_equal);
+  monitor->entries_by_parent = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  monitor->entry_positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  position = g_list_length (monitor->fstab_entries);
+  /* walk backwards so that prepending keeps the lists in file order */
+  for (l = g_list_last (monitor->fstab_entries); l != NULL; l = l->prev)
+    {
+      UDisksFstabEntry *entry = UDISKS_FSTAB_ENTRY (l->data);
+      const gchar *source = udisks_fstab_entry_get_fsname (entry);
+      const gchar *opts = udisks_fstab_entry_get_opts (entry);
+
+      g_hash_table_insert (monitor->entry_positions, entry, GUINT_TO_POINTER (--position));
+
+      if (source != NULL && strlen (source) > 0)
+        index_prepend (monitor->entries_by_source, (gchar *) source, entry);
+
+      if (opts != NULL && strstr (opts, "x-parent=") != NULL)
+        {
+          gchar **tokens;
+          guint n;
+
+          tokens = g_strsplit (opts, ",", -1);
+          for (n = 0; tokens[n] != NULL; n++)
+            {
+              if (g_str_has_prefix (tokens[n], "x-parent=") && strlen (tokens[n]) > strlen ("x-parent="))
+                index_prepend (monitor->entries_by_parent,
+                               g_strdup (tokens[n] + strlen ("x-parent=")),
+                               entry);
+            }
+          g_strfreev (tokens);
+        }
+    }
+}
+
+static gboolean
+stat_changed (const struct stat *a,
+              const struct stat *b)
+{
+  return a->st_ino != b->st_ino ||
+         a->st_dev != b->st_dev ||
+         a->st_size != b->st_size ||
+         a->st_mtim.tv_sec != b->st_mtim.tv_sec ||
+         a->st_mtim.tv_nsec != b->st_mtim.tv_nsec ||
+         a->st_ctim.tv_sec != b->st_ctim.tv_sec ||
+         a->st_ctim.tv_nsec != b->st_ctim.tv_nsec;
+}
+
+static void
+udisks_fstab_monitor_ensure (UDisksFstabMonitor *monitor)
+{
+  struct libmnt_table *table;
+  struct libmnt_iter *iter;
+  struct libmnt_fs *fs = NULL;
+  struct stat statbuf;
+  GList *entries;
+  GList *old_sorted;
+  GList *new_sorted;
+  GList *added;
+  GList *removed;
+  GList *l;
+
+  g_mutex_lock (&monitor->fstab_entries_mutex);
+
+  if (stat (mnt_get_fstab_path (), &statbuf) != 0)
+    memset (&statbuf, 0, sizeof (statbuf));
+
+  if (monitor->valid && !stat_changed (&statbuf, &monitor->fstab_stat))
+    goto out;
+
+  /* Parse the contents */
+  entries = NULL;
+  table = mnt_new_table ();
+  if (mnt_table_parse_fstab (table, NULL) == 0)
+    {
+      iter = mnt_new_iter (MNT_ITER_FORWARD);
+      while (mnt_table_next_fs (table, iter, &fs) == 0)
+        entries = g_list_prepend (entries, _udisks_fstab_entry_new_from_mnt_fs (fs));
+      mnt_free_iter (iter);
+    }
+  mnt_free_table (table);
+  entries = g_list_reverse (entries);
+
+  /* Compare and emit changes */
+  if (monitor->loaded)
+    {
+      old_sorted = g_list_sort (g_list_copy (monitor->fstab_entries), (GCompareFunc) udisks_fstab_entry_compare);
+      new_sorted = g_list_sort (g_list_copy (entries), (GCompareFunc) udisks_fstab_entry_compare);
+      diff_sorted_lists (old_sorted, new_sorted, (GCompareFunc) udisks_fstab_entry_compare, &added, &removed);
+
+      for (l = removed; l != NULL; l = l->next)
+        emit_entry_changed (monitor, UDISKS_FSTAB_ENTRY (l->data), ENTRY_REMOVED_SIGNAL);
+      for (l = added; l != NULL; l = l->next)
+        emit_entry_changed (monitor, UDISKS_FSTAB_ENTRY (l->data), ENTRY_ADDED_SIGNAL);
+
+      g_list_free (removed);
+      g_list_free (added);
+      g_list_free (old_sorted);
+      g_list_free (new_sorted);
+    }
+
+  g_list_free_full (monitor->fstab_entries, g_object_unref);
+  monitor->fstab_entries = entries;
+  rebuild_indexes (monitor);
+
+  monitor->fstab_stat = statbuf;
+  monitor->valid = TRUE;
+  monitor->loaded = TRUE;
+
+ out:
+  g_mutex_unlock (&monitor->fstab_entries_mutex);
+}
+
+/**
+ * udisks_fstab_monitor_get_entries:
+ * @monitor: A #UDisksFstabMonitor.
+ *
+ * Gets all /etc/fstab entries.
+ *
+ * Returns: (transfer full) (element-type UDisksFstabEntry): A list of #UDisksFstabEntry objects that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_fstab_monitor_get_entries (UDisksFstabMonitor *monitor)
+{
+  GList *ret;
+
+  g_return_val_if_fail (UDISKS_IS_FSTAB_MONITOR (monitor), NULL);
+
+  udisks_fstab_monitor_ensure (monitor);
+
+  g_mutex_lock (&monitor->fstab_entries_mutex);
+  ret = g_list_copy_deep (monitor->fstab_entries, (GCopyFunc) udisks_g_object_ref_copy, NULL);
+  g_mutex_unlock (&monitor->fstab_entries_mutex);
+
+  return ret;
+}
+
+/* must be called with fstab_entries_mutex held */
+static gint
+compare_positions (gconstpointer a,
+                   gconstpointer b,
+                   gpointer      user_data)
+{
+  UDisksFstabMonitor *monitor = UDISKS_FSTAB_MONITOR (user_data);
+  guint pos_a = GPOINTER_TO_UINT (g_hash_table_lookup (monitor->entry_positions, a));
+  guint pos_b = GPOINTER_TO_UINT (g_hash_table_lookup (monitor->entry_positions, b));
+
+  return pos_a < pos_b ? -1 : (pos_a > pos_b ? 1 : 0);
+}
+
+/**
+ * udisks_fstab_monitor_get_entries_for_ids:
+ * @monitor: A #UDisksFstabMonitor.
+ * @ids: A %NULL-terminated array of block device identifiers.
+ *
+ * Gets all /etc/fstab entries with a source matching one of @ids. Each
+ * identifier is either a device file (or a symlink to it) or a
+ * <literal>KEY=VALUE</literal> pair like <literal>UUID=...</literal>,
+ * <literal>LABEL=...</literal>, <literal>PARTUUID=...</literal> or
+ * <literal>PARTLABEL=...</literal>. The lookup doesn't touch the file
+ * unless it has changed.
+ *
+ * Returns: (transfer full) (element-type UDisksFstabEntry): A list of #UDisksFstabEntry objects in file order that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_fstab_monitor_get_entries_for_ids (UDisksFstabMonitor  *monitor,
+                                          const gchar * const *ids)
+{
+  GList *ret = NULL;
+  GList *l;
+  guint n;
+
+  g_return_val_if_fail (UDISKS_IS_FSTAB_MONITOR (monitor), NULL);
+
+  if (ids == NULL)
+    return NULL;
+
+  udisks_fstab_monitor_ensure (monitor);
+
+  g_mutex_lock (&monitor->fstab_entries_mutex);
+  for (n = 0; ids[n] != NULL; n++)
+    {
+      for (l = g_hash_table_lookup (monitor->entries_by_source, ids[n]); l != NULL; l = l->next)
+        {
+          /* an entry has only one source but @ids may contain duplicates */
+          if (g_list_find (ret, l->data) == NULL)
+            ret = g_list_prepend (ret, g_object_ref (l->data));
+        }
+    }
+  ret = g_list_sort_with_data (ret, compare_positions, monitor);
+  g_mutex_unlock (&monitor->fstab_entries_mutex);
+
+  return ret;
+}
+
+/**
+ * udisks_fstab_monitor_get_entries_for_parent:
+ * @monitor: A #UDisksFstabMonitor.
+ * @parent_uuid: The UUID of a parent device.
+ *
+ * Gets all /etc/fstab entries with a <literal>x-parent=@parent_uuid</literal>
+ * option.
+ *
+ * Returns: (transfer full) (element-type UDisksFstabEntry): A list of #UDisksFstabEntry objects in file order that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_fstab_monitor_get_entries_for_parent (UDisksFstabMonitor *monitor,
+                                             const gchar        *parent_uuid)
+{
+  GList *ret;
+
+  g_return_val_if_fail (UDISKS_IS_FSTAB_MONITOR (monitor), NULL);
+  g_return_val_if_fail (parent_uuid != NULL, NULL);
+
+  udisks_fstab_monitor_ensure (monitor);
+
+  g_mutex_lock (&monitor->fstab_entries_mutex);
+  ret = g_list_copy_deep (g_hash_table_lookup (monitor->entries_by_parent, parent_uuid),
+                          (GCopyFunc) udisks_g_object_ref_copy, NULL);
+  g_mutex_unlock (&monitor->fstab_entries_mutex);
+
+  return ret;
+}
@@ -0,0 +1,721 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2026 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "config.h"
+#include <glib/gi18n-lib.h>
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "udisksjobscheduler.h"
+#include "udisksbasejob.h"
+#include "udisksdaemon.h"
+#include "udisksconfigmanager.h"
+#include "udiskslogging.h"
+
+/**
+ * SECTION:udisksjobscheduler
+ * @title: UDisksJobScheduler
+ * @short_description: Limits the number of jobs running per drive
+ *
+ * This type is used for deciding when threaded, spawned and simple jobs
+ * are started. Each job is mapped to the drives it operates on using the
+ * objects added with udisks_base_job_add_object() and only a limited
+ * number of jobs (the <option>jobs_per_drive</option> option in
+ * <filename>udisks2.conf</filename>) is run on a drive at a time.
+ * Jobs exceeding the limit are put in the
+ * <literal>queued</literal> state until a job on the drive completes.
+ *
+ * Bulk operations such as erasing, formatting or checking a filesystem
+ * are never given the last slot of a drive, so interactive operations
+ * such as mounting or unlocking can run alongside them, and queued
+ * interactive jobs are started before queued bulk jobs. Jobs on
+ * different drives don't affect each other.
+ */
+
+/**
+ * UDisksJobScheduler:
+ *
+ * The #UDisksJobScheduler structure contains only private data and
+ * should only be accessed using the provided API.
+ */
+struct _UDisksJobScheduler
+{
+  GObject parent_instance;
+
+  UDisksDaemon *daemon;
+
+  GMutex lock;
+  GCond cond;                 /* broadcast when a job is admitted */
+  guint jobs_per_drive;
+  GHashTable *drive_slots;    /* drive object path -> DriveSlots */
+  GQueue queue;               /* of ScheduledJob, interactive jobs before bulk jobs */
+  GHashTable *holders;        /* GThread -> number of admitted jobs it waited for */
+};
+
+typedef struct _UDisksJobSchedulerClass UDisksJobSchedulerClass;
+
+struct _UDisksJobSchedulerClass
+{
+  GObjectClass parent_class;
+};
+
+typedef struct
+{
+  guint running;
+  guint running_bulk;
+} DriveSlots;
+
+typedef struct
+{
+  UDisksJobScheduler *scheduler;
+  UDisksBaseJob *job;
+  gchar **drives;                          /* object paths of the drives the job is on */
+  gboolean bulk;
+  gboolean queued;
+  gboolean admitted;
+  UDisksJobSchedulerStartFunc start_func;  /* NULL for udisks_job_scheduler_wait() */
+  GThread *owner;                          /* the thread in udisks_job_scheduler_wait(), if any */
+  GMainContext *context;                   /* where to call @start_func */
+  gulong completed_handler_id;
+  gulong cancelled_handler_id;
+} ScheduledJob;
+
+enum
+{
+  PROP_0,
+  PROP_DAEMON
+};
+
+/* jobs started while running the function of an admitted job are part
+ * of that job, see udisks_job_scheduler_enter_job()
+ */
+static __thread guint job_func_depth = 0;
+
+/* operations that keep a drive busy for a long time */
+static const gchar *bulk_operations[] =
+{
+  "format-erase",
+  "format-mkfs",
+  "filesystem-check",
+  "filesystem-repair",
+  "filesystem-resize",
+  "encrypted-resize",
+  "ata-secure-erase",
+  "ata-secure-erase-enhanced",
+  NULL
+};
+
+G_DEFINE_TYPE (UDisksJobScheduler, udisks_job_scheduler, G_TYPE_OBJECT);
+
+static void
+udisks_job_scheduler_finalize (GObject *object)
+{
+  UDisksJobScheduler *scheduler = UDISKS_JOB_SCHEDULER (object);
+
+  /* all jobs hold a reference to the scheduler while scheduled */
+  g_warn_if_fail (g_queue_is_empty (&scheduler->queue));
+
+  g_hash_table_unref (scheduler->drive_slots);
+  g_hash_table_unref (scheduler->holders);
+  g_cond_clear (&scheduler->cond);
+  g_mutex_clear (&scheduler->lock);
+
+  if (G_OBJECT_CLASS (udisks_job_scheduler_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (udisks_job_scheduler_parent_class)->finalize (object);
+}
+
+static void
+udisks_job_scheduler_get_property (GObject    *object,
+                                   guint       prop_id,
+                                   GValue     *value,
+                                   GParamSpec *pspec)
+{
+  UDisksJobScheduler *scheduler = UDISKS_JOB_SCHEDULER (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_value_set_object (value, scheduler->daemon);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_job_scheduler_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+  UDisksJobScheduler *scheduler = UDISKS_JOB_SCHEDULER (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_assert (scheduler->daemon == NULL);
+      /* we don't take a reference to the daemon */
+      scheduler->daemon = g_value_get_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_job_scheduler_constructed (GObject *object)
+{
+  UDisksJobScheduler *scheduler = UDISKS_JOB_SCHEDULER (object);
+
+  scheduler->jobs_per_drive = udisks_config_manager_get_jobs_per_drive (udisks_daemon_get_config_manager (scheduler->daemon));
+
+  if (G_OBJECT_CLASS (udisks_job_scheduler_parent_class)->constructed != NULL)
+    G_OBJECT_CLASS (udisks_job_scheduler_parent_class)->constructed (object);
+}
+
+static void
+udisks_job_scheduler_init (UDisksJobScheduler *scheduler)
+{
+  g_mutex_init (&scheduler->lock);
+  g_cond_init (&scheduler->cond);
+  scheduler->jobs_per_drive = UDISKS_JOBS_PER_DRIVE_DEFAULT;
+  scheduler->drive_slots = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  g_queue_init (&scheduler->queue);
+  scheduler->holders = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+static void
+udisks_job_scheduler_class_init (UDisksJobSchedulerClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize     = udisks_job_scheduler_finalize;
+  gobject_class->constructed  = udisks_job_scheduler_constructed;
+  gobject_class->set_property = udisks_job_scheduler_set_property;
+  gobject_class->get_property = udisks_job_scheduler_get_property;
+
+  /**
+   * UDisksJobScheduler:daemon:
+   *
+   * The #UDisksDaemon the scheduler is for.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_DAEMON,
+                                   g_param_spec_object ("daemon",
+                                                        "Daemon",
+                                                        "The daemon the scheduler is for",
+                                                        UDISKS_TYPE_DAEMON,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * udisks_job_scheduler_new:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Creates a new #UDisksJobScheduler object.
+ *
+ * Returns: A #UDisksJobScheduler that should be freed with g_object_unref().
+ */
+UDisksJobScheduler *
+udisks_job_scheduler_new (UDisksDaemon *daemon)
+{
+  return UDISKS_JOB_SCHEDULER (g_object_new (UDISKS_TYPE_JOB_SCHEDULER,
+                                             "daemon", daemon,
+                                             NULL));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+add_drive (GPtrArray   *drives,
+           const gchar *object_path)
+{
+  guint n;
+
+  for (n = 0; n < drives->len; n++)
+    if (g_strcmp0 (drives->pdata[n], object_path) == 0)
+      return;
+  g_ptr_array_add (drives, g_strdup (object_path));
+}
+
+/* Adds the drive @object_path is on to @drives. Unlocked encrypted
+ * devices are followed to their backing device, other objects not on a
+ * drive (e.g. loop devices or RAID arrays) are treated as a drive of
+ * their own.
+ */
+static void
+add_drives_for_object (UDisksJobScheduler *scheduler,
+                       GPtrArray          *drives,
+                       const gchar        *object_path,
+                       guint               depth)
+{
+  UDisksObject *object;
+  UDisksBlock *block;
+  const gchar *drive;
+  const gchar *backing_device;
+
+  object = udisks_daemon_find_object (scheduler->daemon, object_path);
+  if (object == NULL)
+    {
+      add_drive (drives, object_path);
+      return;
+    }
+
+  block = udisks_object_peek_block (object);
+  if (block != NULL)
+    {
+      drive = udisks_block_get_drive (block);
+      if (drive != NULL && g_strcmp0 (drive, "/") != 0)
+        {
+          add_drive (drives, drive);
+          goto out;
+        }
+
+      backing_device = udisks_block_get_crypto_backing_device (block);
+      if (backing_device != NULL && g_strcmp0 (backing_device, "/") != 0 && depth < 8)
+        {
+          add_drives_for_object (scheduler, drives, backing_device, depth + 1);
+          goto out;
+        }
+    }
+
+  add_drive (drives, object_path);
+
+ out:
+  g_object_unref (object);
+}
+
+static gboolean
+is_bulk_operation (const gchar *operation)
+{
+  return operation != NULL && g_strv_contains (bulk_operations, operation);
+}
+
+static void on_job_completed (UDisksJob    *job,
+                              gboolean      success,
+                              const gchar  *message,
+                              gpointer      user_data);
+static void on_job_cancelled (GCancellable *cancellable,
+                              gpointer      user_data);
+
+static ScheduledJob *
+scheduled_job_new (UDisksJobScheduler          *scheduler,
+                   UDisksBaseJob               *job,
+                   UDisksJobSchedulerStartFunc  start_func)
+{
+  ScheduledJob *sj;
+  GPtrArray *drives;
+  const gchar *const *objects;
+  guint n;
+
+  drives = g_ptr_array_new ();
+  objects = udisks_job_get_objects (UDISKS_JOB (job));
+  for (n = 0; objects != NULL && objects[n] != NULL; n++)
+    add_drives_for_object (scheduler, drives, objects[n], 0);
+  g_ptr_array_add (drives, NULL);
+
+  sj = g_new0 (ScheduledJob, 1);
+  sj->scheduler = g_object_ref (scheduler);
+  sj->job = g_object_ref (job);
+  sj->drives = (gchar **) g_ptr_array_free (drives, FALSE);
+  sj->bulk = is_bulk_operation (udisks_job_get_operation (UDISKS_JOB (job)));
+  sj->start_func = start_func;
+  if (start_func != NULL)
+    sj->context = g_main_context_ref_thread_default ();
+  else
+    sj->owner = g_thread_self ();
+
+  sj->completed_handler_id = g_signal_connect (job,
+                                               "completed",
+                                               G_CALLBACK (on_job_completed),
+                                               sj);
+  /* invoked right away if already cancelled, that's taken care of by the caller */
+  sj->cancelled_handler_id = g_cancellable_connect (udisks_base_job_get_cancellable (job),
+                                                    G_CALLBACK (on_job_cancelled),
+                                                    sj,
+                                                    NULL);
+  return sj;
+}
+
+static void
+scheduled_job_free (ScheduledJob *sj)
+{
+  g_signal_handler_disconnect (sj->job, sj->completed_handler_id);
+  g_cancellable_disconnect (udisks_base_job_get_cancellable (sj->job), sj->cancelled_handler_id);
+  if (sj->context != NULL)
+    g_main_context_unref (sj->context);
+  g_strfreev (sj->drives);
+  g_object_unref (sj->job);
+  g_object_unref (sj->scheduler);
+  g_free (sj);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* called with lock held */
+static gboolean
+can_run (UDisksJobScheduler *scheduler,
+         ScheduledJob       *sj)
+{
+  guint bulk_limit;
+  guint n;
+
+  /* leave one slot to interactive jobs, if there is more than one */
+  bulk_limit = MAX (scheduler->jobs_per_drive, 2) - 1;
+
+  for (n = 0; sj->drives[n] != NULL; n++)
+    {
+      DriveSlots *slots;
+
+      slots = g_hash_table_lookup (scheduler->drive_slots, sj->drives[n]);
+      if (slots == NULL)
+        continue;
+      if (slots->running >= scheduler->jobs_per_drive)
+        return FALSE;
+      if (sj->bulk && slots->running_bulk >= bulk_limit)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* called with lock held, also used for jobs exceeding the limit */
+static void
+admit (UDisksJobScheduler *scheduler,
+       ScheduledJob       *sj)
+{
+  guint n;
+
+  for (n = 0; sj->drives[n] != NULL; n++)
+    {
+      DriveSlots *slots;
+
+      slots = g_hash_table_lookup (scheduler->drive_slots, sj->drives[n]);
+      if (slots == NULL)
+        {
+          slots = g_new0 (DriveSlots, 1);
+          g_hash_table_insert (scheduler->drive_slots, g_strdup (sj->drives[n]), slots);
+        }
+      slots->running++;
+      if (sj->bulk)
+        slots->running_bulk++;
+    }
+
+  if (sj->owner != NULL)
+    g_hash_table_insert (scheduler->holders, sj->owner,
+                         GUINT_TO_POINTER (GPOINTER_TO_UINT (g_hash_table_lookup (scheduler->holders, sj->owner)) + 1));
+
+  if (sj->queued)
+    {
+      g_queue_remove (&scheduler->queue, sj);
+      sj->queued = FALSE;
+    }
+  sj->admitted = TRUE;
+
+  /* wake up udisks_job_scheduler_wait() */
+  if (sj->start_func == NULL)
+    g_cond_broadcast (&scheduler->cond);
+}
+
+/* called with lock held */
+static void
+release (UDisksJobScheduler *scheduler,
+         ScheduledJob       *sj)
+{
+  guint n;
+
+  for (n = 0; sj->drives[n] != NULL; n++)
+    {
+      DriveSlots *slots;
+
+      slots = g_hash_table_lookup (scheduler->drive_slots, sj->drives[n]);
+      if (slots == NULL)
+        continue;
+      slots->running--;
+      if (sj->bulk)
+        slots->running_bulk--;
+      if (slots->running == 0)
+        g_hash_table_remove (scheduler->drive_slots, sj->drives[n]);
+    }
+
+  if (sj->owner != NULL)
+    {
+      guint held = GPOINTER_TO_UINT (g_hash_table_lookup (scheduler->holders, sj->owner));
+
+      if (held <= 1)
+        g_hash_table_remove (scheduler->holders, sj->owner);
+      else
+        g_hash_table_insert (scheduler->holders, sj->owner, GUINT_TO_POINTER (held - 1));
+    }
+}
+
+/* called with lock held */
+static void
+enqueue (UDisksJobScheduler *scheduler,
+         ScheduledJob       *sj)
+{
+  GList *l;
+
+  sj->queued = TRUE;
+  if (sj->bulk)
+    {
+      g_queue_push_tail (&scheduler->queue, sj);
+      return;
+    }
+
+  /* interactive jobs go after the queued interactive jobs but before any bulk job */
+  for (l = scheduler->queue.head; l != NULL; l = l->next)
+    {
+      ScheduledJob *other = l->data;
+      if (other->bulk)
+        break;
+    }
+  if (l != NULL)
+    g_queue_insert_before (&scheduler->queue, l, sj);
+  else
+    g_queue_push_tail (&scheduler->queue, sj);
+}
+
+/* called with lock held, returns the admitted jobs with a start function
+ * in queue order, they have to be passed to start_admitted_jobs()
+ */
+static GList *
+dispatch (UDisksJobScheduler *scheduler)
+{
+  GList *ret = NULL;
+  GList *l;
+  GList *next;
+
+  for (l = scheduler->queue.head; l != NULL; l = next)
+    {
+      ScheduledJob *sj = l->data;
+
+      next = l->next;
+      if (!can_run (scheduler, sj))
+        continue;
+      admit (scheduler, sj);
+      if (sj->start_func != NULL)
+        ret = g_list_prepend (ret, sj);
+    }
+
+  return g_list_reverse (ret);
+}
+
+static gboolean
+start_in_context (gpointer user_data)
+{
+  ScheduledJob *sj = user_data;
+
+  sj->start_func (sj->job);
+  return G_SOURCE_REMOVE;
+}
+
+/* called without lock held */
+static void
+start_admitted_jobs (GList *admitted)
+{
+  GList *l;
+
+  for (l = admitted; l != NULL; l = l->next)
+    {
+      ScheduledJob *sj = l->data;
+
+      udisks_job_set_state (UDISKS_JOB (sj->job), "running");
+      udisks_job_set_start_time (UDISKS_JOB (sj->job), g_get_real_time ());
+      g_main_context_invoke (sj->context, start_in_context, sj);
+    }
+  g_list_free (admitted);
+}
+
+static void
+on_job_completed (UDisksJob    *job,
+                  gboolean      success,
+                  const gchar  *message,
+                  gpointer      user_data)
+{
+  ScheduledJob *sj = user_data;
+  UDisksJobScheduler *scheduler = sj->scheduler;
+  GList *admitted;
+
+  g_mutex_lock (&scheduler->lock);
+  if (sj->admitted)
+    release (scheduler, sj);
+  else if (sj->queued)
+    g_queue_remove (&scheduler->queue, sj);
+  admitted = dispatch (scheduler);
+  g_mutex_unlock (&scheduler->lock);
+
+  start_admitted_jobs (admitted);
+  scheduled_job_free (sj);
+}
+
+static void
+on_job_cancelled (GCancellable *cancellable,
+                  gpointer      user_data)
+{
+  ScheduledJob *sj = user_data;
+  UDisksJobScheduler *scheduler = sj->scheduler;
+  GList *admitted = NULL;
+
+  /* start queued jobs right away so they complete with a cancellation error */
+  g_mutex_lock (&scheduler->lock);
+  if (sj->queued)
+    {
+      admit (scheduler, sj);
+      if (sj->start_func != NULL)
+        admitted = g_list_prepend (NULL, sj);
+    }
+  g_mutex_unlock (&scheduler->lock);
+
+  start_admitted_jobs (admitted);
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* Returns %TRUE if the job was admitted right away */
+static gboolean
+schedule (UDisksJobScheduler *scheduler,
+          ScheduledJob       *sj)
+{
+  gboolean ret;
+
+  g_mutex_lock (&scheduler->lock);
+  /* Cancelled jobs are started right away to complete with an error. Jobs
+   * started by a thread already holding an admitted job (e.g. a simple job
+   * running a spawned one) are part of that job.
+   */
+  if (job_func_depth > 0 ||
+      g_hash_table_contains (scheduler->holders, g_thread_self ()) ||
+      g_cancellable_is_cancelled (udisks_base_job_get_cancellable (sj->job)) ||
+      can_run (scheduler, sj))
+    {
+      admit (scheduler, sj);
+      ret = TRUE;
+    }
+  else
+    {
+      udisks_debug ("Queueing %s job %s on %u drive(s)",
+                    sj->bulk ? "bulk" : "interactive",
+                    udisks_job_get_operation (UDISKS_JOB (sj->job)),
+                    g_strv_length (sj->drives));
+      enqueue (scheduler, sj);
+      udisks_job_set_state (UDISKS_JOB (sj->job), "queued");
+      ret = FALSE;
+    }
+  g_mutex_unlock (&scheduler->lock);
+
+  return ret;
+}
+
+/**
+ * udisks_job_scheduler_start:
+ * @scheduler: A #UDisksJobScheduler.
+ * @job: A #UDisksBaseJob that has not been started yet.
+ * @start_func: Function to start @job with.
+ *
+ * Calls @start_func for @job right away if the drives @job is on have
+ * a free slot, otherwise puts @job in the <literal>queued</literal>
+ * state and calls @start_func from the
+ * <link linkend="g-main-context-push-thread-default">thread-default main loop</link>
+ * of the calling thread once they do.
+ *
+ * The slots are given back when the #UDisksJob::completed signal is
+ * emitted on @job.
+ */
+void
+udisks_job_scheduler_start (UDisksJobScheduler          *scheduler,
+                            UDisksBaseJob               *job,
+                            UDisksJobSchedulerStartFunc  start_func)
+{
+  ScheduledJob *sj;
+
+  g_return_if_fail (UDISKS_IS_JOB_SCHEDULER (scheduler));
+  g_return_if_fail (UDISKS_IS_BASE_JOB (job));
+  g_return_if_fail (start_func != NULL);
+
+  sj = scheduled_job_new (scheduler, job, start_func);
+  if (schedule (scheduler, sj))
+    start_func (job);
+}
+
+/**
+ * udisks_job_scheduler_wait:
+ * @scheduler: A #UDisksJobScheduler.
+ * @job: A #UDisksBaseJob that has not been started yet.
+ *
+ * Like udisks_job_scheduler_start() but blocks the calling thread
+ * until @job may be started, or until @job is cancelled.
+ */
+void
+udisks_job_scheduler_wait (UDisksJobScheduler *scheduler,
+                           UDisksBaseJob      *job)
+{
+  ScheduledJob *sj;
+
+  g_return_if_fail (UDISKS_IS_JOB_SCHEDULER (scheduler));
+  g_return_if_fail (UDISKS_IS_BASE_JOB (job));
+
+  sj = scheduled_job_new (scheduler, job, NULL);
+  if (schedule (scheduler, sj))
+    return;
+
+  g_mutex_lock (&scheduler->lock);
+  while (!sj->admitted)
+    g_cond_wait (&scheduler->cond, &scheduler->lock);
+  g_mutex_unlock (&scheduler->lock);
+
+  udisks_job_set_state (UDISKS_JOB (job), "running");
+  udisks_job_set_start_time (UDISKS_JOB (job), g_get_real_time ());
+}
+
+/**
+ * udisks_job_scheduler_enter_job:
+ *
+ * Marks the calling thread as running the function of an admitted job
+ * until udisks_job_scheduler_leave_job() is called. Jobs started from
+ * such a thread are never queued since they are part of a job already
+ * holding the slots of its drives.
+ */
+void
+udisks_job_scheduler_enter_job (void)
+{
+  job_func_depth++;
+}
+
+/**
+ * udisks_job_scheduler_leave_job:
+ *
+ * Undoes the effect of udisks_job_scheduler_enter_job().
+ */
+void
+udisks_job_scheduler_leave_job (void)
+{
+  g_return_if_fail (job_func_depth > 0);
+  job_func_depth--;
+}
@@ -0,0 +1,52 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2026 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __UDISKS_JOB_SCHEDULER_H__
+#define __UDISKS_JOB_SCHEDULER_H__
+
+#include "udisksdaemontypes.h"
+
+G_BEGIN_DECLS
+
+#define UDISKS_TYPE_JOB_SCHEDULER  (udisks_job_scheduler_get_type ())
+#define UDISKS_JOB_SCHEDULER(o)    (G_TYPE_CHECK_INSTANCE_CAST ((o), UDISKS_TYPE_JOB_SCHEDULER, UDisksJobScheduler))
+#define UDISKS_IS_JOB_SCHEDULER(o) (G_TYPE_CHECK_INSTANCE_TYPE ((o), UDISKS_TYPE_JOB_SCHEDULER))
+
+/**
+ * UDisksJobSchedulerStartFunc:
+ * @job: The #UDisksBaseJob to start.
+ *
+ * Function used by #UDisksJobScheduler to actually start @job.
+ */
+typedef void (*UDisksJobSchedulerStartFunc) (UDisksBaseJob *job);
+
+GType                udisks_job_scheduler_get_type   (void) G_GNUC_CONST;
+UDisksJobScheduler  *udisks_job_scheduler_new        (UDisksDaemon                *daemon);
+void                 udisks_job_scheduler_start      (UDisksJobScheduler          *scheduler,
+                                                      UDisksBaseJob               *job,
+                                                      UDisksJobSchedulerStartFunc  start_func);
+void                 udisks_job_scheduler_wait       (UDisksJobScheduler          *scheduler,
+                                                      UDisksBaseJob               *job);
+void                 udisks_job_scheduler_enter_job  (void);
+void                 udisks_job_scheduler_leave_job  (void);
+
+G_END_DECLS
+
+#endif /* __UDISKS_JOB_SCHEDULER_H__ */
@@ -25,6 +25,7 @@
 
 #include <sys/types.h>
 #include <sys/mount.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <pwd.h>
@@ -32,6 +33,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
 #include <mntent.h>
 
 #include <glib/gstdio.h>
@@ -49,12 +51,14 @@
 #include "udiskslinuxdriveobject.h"
 #include "udiskslinuxfsinfo.h"
 #include "udisksdaemon.h"
+#include "udisksmethodexecutor.h"
 #include "udisksstate.h"
 #include "udisksprivate.h"
 #include "udisksconfigmanager.h"
 #include "udisksdaemonutil.h"
 #include "udiskslinuxprovider.h"
 #include "udisksfstabentry.h"
+#include "udisksfstabmonitor.h"
 #include "udiskscrypttabmonitor.h"
 #include "udiskscrypttabentry.h"
 #include "udisksdaemonutil.h"
@@ -97,6 +101,12 @@ struct _UDisksLinuxBlock
 
   /* only allow single cryptsetup call at once */
   GMutex encrypted_lock;
+
+  /* identifiers the block device may be referred to by in configuration
+   * files, see update_identities() */
+  GMutex identities_lock;
+  gchar **identities;
+  GHashTable *identities_set;
 };
 
 struct _UDisksLinuxBlockClass
@@ -115,6 +125,9 @@ static void
 udisks_linux_block_init (UDisksLinuxBlock *block)
 {
   g_mutex_init (&(block->encrypted_lock));
+  g_mutex_init (&(block->identities_lock));
+  block->identities = g_new0 (gchar *, 1);
+  block->identities_set = g_hash_table_new (g_str_hash, g_str_equal);
   g_dbus_interface_skeleton_set_flags (G_DBUS_INTERFACE_SKELETON (block),
                                        G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD);
 }
@@ -125,6 +138,9 @@ udisks_linux_block_finalize (GObject *object)
   UDisksLinuxBlock *block = UDISKS_LINUX_BLOCK (object);
 
   g_mutex_clear (&(block->encrypted_lock));
+  g_mutex_clear (&(block->identities_lock));
+  g_hash_table_destroy (block->identities_set);
+  g_strfreev (block->identities);
 
   if (G_OBJECT_CLASS (udisks_linux_block_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (udisks_linux_block_parent_class)->finalize (object);
@@ -468,177 +484,70 @@ gboolean
 udisks_linux_block_matches_id (UDisksLinuxBlock *block,
                                const gchar      *device_path)
 {
-  const gchar *device = NULL;
-  const gchar *label = NULL;
-  const gchar *uuid = NULL;
-  const gchar *partuuid = NULL;
-  const gchar *partlabel = NULL;
-  const gchar *const *symlinks;
+  gboolean ret;
 
   if (device_path == NULL || strlen (device_path) < 1)
-    {
-      return FALSE;
-    }
-  if (g_str_has_prefix (device_path, "UUID="))
-    {
-      uuid = device_path + 5;
-    }
-  else if (g_str_has_prefix (device_path, "LABEL="))
-    {
-      label = device_path + 6;
-    }
-  else if (g_str_has_prefix (device_path, "PARTUUID="))
-    {
-      partuuid = device_path + 9;
-    }
-  else if (g_str_has_prefix (device_path, "PARTLABEL="))
-    {
-      partlabel = device_path + 10;
-    }
-  else if (g_str_has_prefix (device_path, "/dev"))
-    {
-      device = device_path;
-    }
-  else
-    {
-      /* ignore non-device entry */
-      return FALSE;
-    }
+    return FALSE;
 
-  if (device != NULL)
-    {
-      if (g_strcmp0 (device, udisks_block_get_device (UDISKS_BLOCK (block))) == 0)
-        return TRUE;
-
-      symlinks = udisks_block_get_symlinks (UDISKS_BLOCK (block));
-      if (symlinks && g_strv_contains (symlinks, device))
-        return TRUE;
-    }
-  if (label != NULL && g_strcmp0 (label, udisks_block_get_id_label (UDISKS_BLOCK (block))) == 0)
-    {
-      return TRUE;
-    }
-  if (uuid != NULL && g_strcmp0 (uuid, udisks_block_get_id_uuid (UDISKS_BLOCK (block))) == 0)
-    {
-      return TRUE;
-    }
-  if (partlabel != NULL || partuuid != NULL)
-    {
-      UDisksLinuxBlockObject *object;
-      UDisksLinuxDevice *linux_device;
+  g_mutex_lock (&block->identities_lock);
+  ret = g_hash_table_contains (block->identities_set, device_path);
+  g_mutex_unlock (&block->identities_lock);
 
-      object = udisks_daemon_util_dup_object (block, NULL);
-      if (object != NULL)
-        {
-          linux_device = udisks_linux_block_object_get_device (object);
-          g_clear_object (&object);
-          if (linux_device != NULL && linux_device->udev_device != NULL &&
-              ((partuuid != NULL  && g_strcmp0 (partuuid,  g_udev_device_get_property (linux_device->udev_device, "ID_PART_ENTRY_UUID")) == 0) ||
-               (partlabel != NULL && g_strcmp0 (partlabel, g_udev_device_get_property (linux_device->udev_device, "ID_PART_ENTRY_NAME")) == 0)))
-            {
-              g_object_unref (linux_device);
-              return TRUE;
-            }
-          g_clear_object (&linux_device);
-        }
-    }
-
-  return FALSE;
+  return ret;
 }
 
-static GList *
-find_fstab_entries (UDisksDaemon     *daemon,
-                    UDisksLinuxBlock *block,
-                    const gchar      *needle)
+/* Returns a copy of the identifiers @block may be referred to by, see
+ * update_identities().
+ */
+static gchar **
+dup_identities (UDisksLinuxBlock *block)
 {
-  struct libmnt_table *table;
-  struct libmnt_iter* iter;
-  struct libmnt_fs *fs = NULL;
-  GList *ret = NULL;
-
-  table = mnt_new_table ();
-  if (mnt_table_parse_fstab (table, NULL) < 0)
-    {
-      mnt_free_table (table);
-      return NULL;
-    }
+  gchar **ret;
 
-  iter = mnt_new_iter (MNT_ITER_FORWARD);
-  while (mnt_table_next_fs (table, iter, &fs) == 0)
-    {
-      UDisksFstabEntry *entry;
-
-      if (block != NULL)
-        {
-          if (! udisks_linux_block_matches_id (block, mnt_fs_get_source (fs)))
-            continue;
-        }
-      else if (needle != NULL)
-        {
-          const char *opts;
-
-          opts = mnt_fs_get_options (fs);
-          if (! opts || g_strstr_len (opts, -1, needle) == NULL)
-            continue;
-        }
-
-      entry = _udisks_fstab_entry_new_from_mnt_fs (fs);
-      ret = g_list_prepend (ret, entry);
-    }
-  mnt_free_iter (iter);
-  mnt_free_table (table);
+  g_mutex_lock (&block->identities_lock);
+  ret = g_strdupv (block->identities);
+  g_mutex_unlock (&block->identities_lock);
 
-  return g_list_reverse (ret);
+  return ret;
 }
 
-static GList *
-find_crypttab_entries_for_device (UDisksLinuxBlock *block,
-                                  UDisksDaemon     *daemon)
+/**
+ * udisks_linux_block_find_fstab_entries:
+ * @block: A #UDisksLinuxBlock.
+ * @daemon: A #UDisksDaemon.
+ *
+ * Gets the /etc/fstab entries referring to @block by any of its
+ * identifiers, see udisks_fstab_monitor_get_entries_for_ids().
+ *
+ * Returns: (transfer full) (element-type UDisksFstabEntry): A list of #UDisksFstabEntry objects in file order that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_linux_block_find_fstab_entries (UDisksLinuxBlock *block,
+                                       UDisksDaemon     *daemon)
 {
-  GList *entries;
-  GList *l;
   GList *ret;
+  gchar **ids;
 
-  ret = NULL;
-
-  /* if this is too slow, we could add lookup methods to UDisksCrypttabMonitor... */
-  entries = udisks_crypttab_monitor_get_entries (udisks_daemon_get_crypttab_monitor (daemon));
-  for (l = entries; l != NULL; l = l->next)
-    {
-      UDisksCrypttabEntry *entry = UDISKS_CRYPTTAB_ENTRY (l->data);
-      const gchar *device;
-
-      device = udisks_crypttab_entry_get_device (entry);
-      if (udisks_linux_block_matches_id (block, device))
-        ret = g_list_prepend (ret, g_object_ref (entry));
-    }
+  ids = dup_identities (block);
+  ret = udisks_fstab_monitor_get_entries_for_ids (udisks_daemon_get_fstab_monitor (daemon),
+                                                  (const gchar * const *) ids);
+  g_strfreev (ids);
 
-  g_list_free_full (entries, g_object_unref);
   return ret;
 }
 
 static GList *
-find_crypttab_entries_for_needle (gchar        *needle,
-                                  UDisksDaemon *daemon)
+find_crypttab_entries_for_device (UDisksLinuxBlock *block,
+                                  UDisksDaemon     *daemon)
 {
-  GList *entries;
-  GList *l;
   GList *ret;
+  gchar **ids;
 
-  ret = NULL;
-
-  entries = udisks_crypttab_monitor_get_entries (udisks_daemon_get_crypttab_monitor (daemon));
-  for (l = entries; l != NULL; l = l->next)
-    {
-      UDisksCrypttabEntry *entry = UDISKS_CRYPTTAB_ENTRY (l->data);
-      const gchar *opts = NULL;
-
-      opts = udisks_crypttab_entry_get_options (entry);
-      if (opts && strstr(opts, needle))
-        ret = g_list_prepend (ret, g_object_ref (entry));
-    }
+  ids = dup_identities (block);
+  ret = udisks_crypttab_monitor_get_entries_for_ids (udisks_daemon_get_crypttab_monitor (daemon),
+                                                     (const gchar * const *) ids);
+  g_strfreev (ids);
 
-  g_list_free_full (entries, g_object_unref);
   return ret;
 }
 
@@ -647,26 +556,14 @@ static GList *
 find_utab_entries_for_device (UDisksLinuxBlock *block,
                               UDisksDaemon     *daemon)
 {
-  GSList *entries, *l;
   GList *ret;
+  gchar **ids;
 
-  ret = NULL;
-
-  /* if this is too slow, we could add lookup methods to UDisksUtabMonitor... */
-  entries = udisks_utab_monitor_get_entries (udisks_daemon_get_utab_monitor (daemon));
-  for (l = entries; l != NULL; l = l->next)
-    {
-      UDisksUtabEntry *entry = UDISKS_UTAB_ENTRY (l->data);
-      const gchar *source = udisks_utab_entry_get_source (entry);
-
-      if (!g_str_has_prefix (source, "/dev"))
-        continue;
-
-      if (udisks_linux_block_matches_id (block, source))
-        ret = g_list_prepend (ret, g_object_ref (entry));
-    }
+  ids = dup_identities (block);
+  ret = udisks_utab_monitor_get_entries_for_ids (udisks_daemon_get_utab_monitor (daemon),
+                                                 (const gchar * const *) ids);
+  g_strfreev (ids);
 
-  g_slist_free_full (entries, g_object_unref);
   return ret;
 }
 #endif
@@ -775,7 +672,7 @@ calculate_configuration (UDisksLinuxBlock  *block,
 
   g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sa{sv})"));
   /* First the /etc/fstab entries */
-  entries = find_fstab_entries (daemon, block, NULL);
+  entries = udisks_linux_block_find_fstab_entries (block, daemon);
   for (l = entries; l != NULL; l = l->next)
     add_fstab_entry (&builder, UDISKS_FSTAB_ENTRY (l->data));
   g_list_free_full (entries, g_object_unref);
@@ -865,7 +762,7 @@ update_userspace_mount_options (UDisksLinuxBlock *block,
 
 /* returns a floating GVariant */
 static GVariant *
-find_configurations (gchar         *needle,
+find_configurations (const gchar   *parent_uuid,
                      UDisksDaemon  *daemon,
                      gboolean       include_secrets,
                      GError       **error)
@@ -875,21 +772,23 @@ find_configurations (gchar         *needle,
   GVariantBuilder builder;
   GVariant *ret;
 
-  udisks_debug ("Looking for %s", needle);
-
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
+  udisks_debug ("Looking for x-parent=%s", parent_uuid);
+
   ret = NULL;
 
   g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sa{sv})"));
   /* First the /etc/fstab entries */
-  entries = find_fstab_entries (daemon, NULL, needle);
+  entries = udisks_fstab_monitor_get_entries_for_parent (udisks_daemon_get_fstab_monitor (daemon),
+                                                         parent_uuid);
   for (l = entries; l != NULL; l = l->next)
     add_fstab_entry (&builder, UDISKS_FSTAB_ENTRY (l->data));
   g_list_free_full (entries, g_object_unref);
 
   /* Then the /etc/crypttab entries */
-  entries = find_crypttab_entries_for_needle (needle, daemon);
+  entries = udisks_crypttab_monitor_get_entries_for_parent (udisks_daemon_get_crypttab_monitor (daemon),
+                                                            parent_uuid);
   for (l = entries; l != NULL; l = l->next)
     {
       if (!add_crypttab_entry (&builder, UDISKS_CRYPTTAB_ENTRY (l->data), include_secrets, error))
@@ -912,8 +811,7 @@ udisks_linux_find_child_configuration (UDisksDaemon *daemon,
                                        const gchar  *uuid)
 {
   GError *error = NULL;
-  gchar *needle = g_strdup_printf ("x-parent=%s", uuid);
-  GVariant *res = find_configurations (needle, daemon, FALSE, &error);
+  GVariant *res = find_configurations (uuid, daemon, FALSE, &error);
   if (res == NULL)
     {
       udisks_warning ("Error loading configuration: %s (%s, %d)",
@@ -921,7 +819,6 @@ udisks_linux_find_child_configuration (UDisksDaemon *daemon,
       g_clear_error (&error);
       res = g_variant_new ("a(sa{sv})", NULL);
     }
-  g_free (needle);
   return res;
 }
 
@@ -942,6 +839,72 @@ get_slave_sysfs_path (const gchar *sysfs_path)
   return ret;
 }
 
+/* Recomputes the identifiers the block device may be referred to by in
+ * configuration files: the device file, its symlinks and the UUID=, LABEL=,
+ * PARTUUID= and PARTLABEL= forms. The lookup set is only rebuilt when any
+ * of them has changed.
+ */
+static void
+update_identities (UDisksLinuxBlock  *block,
+                   UDisksLinuxDevice *device)
+{
+  UDisksBlock *iface = UDISKS_BLOCK (block);
+  GPtrArray *ids;
+  const gchar *value;
+  const gchar *const *symlinks;
+  gboolean changed;
+  guint n;
+
+  /* the elements are only freed when the array is freed with its segment */
+  ids = g_ptr_array_new_with_free_func (g_free);
+
+  value = udisks_block_get_device (iface);
+  if (value != NULL && strlen (value) > 0)
+    g_ptr_array_add (ids, g_strdup (value));
+
+  symlinks = udisks_block_get_symlinks (iface);
+  for (n = 0; symlinks != NULL && symlinks[n] != NULL; n++)
+    g_ptr_array_add (ids, g_strdup (symlinks[n]));
+
+  value = udisks_block_get_id_uuid (iface);
+  if (value != NULL && strlen (value) > 0)
+    g_ptr_array_add (ids, g_strdup_printf ("UUID=%s", value));
+
+  value = udisks_block_get_id_label (iface);
+  if (value != NULL && strlen (value) > 0)
+    g_ptr_array_add (ids, g_strdup_printf ("LABEL=%s", value));
+
+  value = g_udev_device_get_property (device->udev_device, "ID_PART_ENTRY_UUID");
+  if (value != NULL && strlen (value) > 0)
+    g_ptr_array_add (ids, g_strdup_printf ("PARTUUID=%s", value));
+
+  value = g_udev_device_get_property (device->udev_device, "ID_PART_ENTRY_NAME");
+  if (value != NULL && strlen (value) > 0)
+    g_ptr_array_add (ids, g_strdup_printf ("PARTLABEL=%s", value));
+
+  g_ptr_array_add (ids, NULL);
+
+  g_mutex_lock (&block->identities_lock);
+  changed = g_strv_length (block->identities) != ids->len - 1;
+  for (n = 0; !changed && n < ids->len - 1; n++)
+    changed = g_strcmp0 (block->identities[n], g_ptr_array_index (ids, n)) != 0;
+
+  if (changed)
+    {
+      g_strfreev (block->identities);
+      block->identities = (gchar **) g_ptr_array_free (ids, FALSE);
+      /* the keys are owned by block->identities */
+      g_hash_table_remove_all (block->identities_set);
+      for (n = 0; block->identities[n] != NULL; n++)
+        g_hash_table_add (block->identities_set, block->identities[n]);
+    }
+  else
+    {
+      g_ptr_array_free (ids, TRUE);
+    }
+  g_mutex_unlock (&block->identities_lock);
+}
+
 /**
  * udisks_linux_block_update:
  * @block: A #UDisksLinuxBlock.
@@ -1224,6 +1187,7 @@ udisks_linux_block_update (UDisksLinuxBlock       *block,
   udisks_block_set_id_uuid (iface, s);
   g_free (s);
 
+  update_identities (block, device);
   update_hints (block, device, drive);
   update_configuration (block, daemon);
 #ifdef HAVE_LIBMOUNT_UTAB
@@ -2352,8 +2316,256 @@ erase_ata_device (UDisksBlock   *block,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+#ifndef BLKZEROOUT
+#define BLKZEROOUT _IO(0x12,127)
+#endif
+
 #define ERASE_SIZE (1 * 1024*1024)
 
+/* size of the ranges passed to BLKZEROOUT, small enough to
+ * report progress and check for cancellation every few seconds
+ */
+#define ERASE_RANGE_SIZE (256 * 1024*1024)
+
+/* buffer alignment required for O_DIRECT */
+#define ERASE_BUFFER_ALIGNMENT 4096
+
+static gboolean
+erase_check_cancelled (UDisksBaseJob  *job,
+                       GError        **error)
+{
+  if (g_cancellable_is_cancelled (udisks_base_job_get_cancellable (job)))
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED,
+                   "Job was canceled");
+      return TRUE;
+    }
+  return FALSE;
+}
+
+static void
+erase_update_progress (UDisksBaseJob *job,
+                       guint64        pos,
+                       guint64        size,
+                       gint64        *time_of_last_signal)
+{
+  gint64 now;
+
+  /* only emit D-Bus signal at most once a second */
+  now = g_get_monotonic_time ();
+  if (now - *time_of_last_signal > G_USEC_PER_SEC)
+    {
+      udisks_job_set_progress (UDISKS_JOB (job), ((gdouble) pos) / size);
+      *time_of_last_signal = now;
+    }
+}
+
+/* Zeroes @fd by passing ranges of it to the @request ioctl (BLKZEROOUT).
+ * If the device doesn't support @request, %FALSE is returned without
+ * setting @error and nothing has been written.
+ */
+static gboolean
+erase_device_ranges (gint            fd,
+                     const gchar    *device_file,
+                     guint64         size,
+                     gulong          request,
+                     const gchar    *request_name,
+                     UDisksBaseJob  *job,
+                     GError        **error)
+{
+  guint64 pos;
+  gint64 time_of_last_signal;
+
+  pos = 0;
+  time_of_last_signal = g_get_monotonic_time ();
+  while (pos < size)
+    {
+      guint64 range[2];
+
+      range[0] = pos;
+      range[1] = MIN (size - pos, ERASE_RANGE_SIZE);
+      if (ioctl (fd, request, range) != 0)
+        {
+          if (errno == EINTR)
+            continue;
+          if (pos == 0 && (errno == EOPNOTSUPP || errno == ENOTTY || errno == EINVAL))
+            {
+              udisks_debug ("%s not supported on %s: %m", request_name, device_file);
+              return FALSE;
+            }
+          g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                       "Error doing %s ioctl on %s at offset %" G_GUINT64_FORMAT ": %m",
+                       request_name, device_file, pos);
+          return FALSE;
+        }
+      pos += range[1];
+
+      if (erase_check_cancelled (job, error))
+        return FALSE;
+      erase_update_progress (job, pos, size, &time_of_last_signal);
+    }
+
+  return TRUE;
+}
+
+typedef struct
+{
+  gint fd;
+  guint64 size;
+
+  GMutex lock;
+  GCond cond;          /* signalled whenever a write completes */
+  guint64 next_pos;    /* start of the next range to write */
+  guint64 written;
+  guint running;       /* number of writer threads */
+  gboolean stop;
+  gint error_code;     /* errno of the first failed write */
+  guint64 error_pos;
+} EraseWriters;
+
+static gpointer
+erase_writer_thread_func (gpointer user_data)
+{
+  EraseWriters *writers = user_data;
+  gpointer buf = NULL;
+
+  if (posix_memalign (&buf, ERASE_BUFFER_ALIGNMENT, ERASE_SIZE) != 0)
+    buf = NULL;
+  else
+    memset (buf, 0, ERASE_SIZE);
+
+  g_mutex_lock (&writers->lock);
+  if (buf == NULL && writers->error_code == 0)
+    {
+      writers->error_code = ENOMEM;
+      writers->error_pos = writers->next_pos;
+      writers->stop = TRUE;
+    }
+  while (!writers->stop && writers->next_pos < writers->size)
+    {
+      guint64 pos;
+      gsize len;
+      gsize done;
+      gint error_code = 0;
+
+      pos = writers->next_pos;
+      len = MIN (writers->size - pos, ERASE_SIZE);
+      writers->next_pos += len;
+      g_mutex_unlock (&writers->lock);
+
+      done = 0;
+      while (done < len)
+        {
+          ssize_t num_written;
+
+          num_written = pwrite (writers->fd, (guchar *) buf + done, len - done, pos + done);
+          if (num_written == -1)
+            {
+              if (errno == EINTR)
+                continue;
+              error_code = errno;
+              break;
+            }
+          else if (num_written == 0)
+            {
+              error_code = EIO;
+              break;
+            }
+          done += num_written;
+        }
+
+      g_mutex_lock (&writers->lock);
+      writers->written += done;
+      if (error_code != 0 && writers->error_code == 0)
+        {
+          writers->error_code = error_code;
+          writers->error_pos = pos + done;
+          writers->stop = TRUE;
+        }
+      g_cond_signal (&writers->cond);
+    }
+  writers->running--;
+  g_cond_signal (&writers->cond);
+  g_mutex_unlock (&writers->lock);
+
+  free (buf);
+  return NULL;
+}
+
+/* Zeroes @fd by writing to it from @queue_depth threads, using direct
+ * I/O if possible so the page cache is bypassed. The device cache is
+ * flushed once all writes completed.
+ */
+static gboolean
+erase_device_writes (gint            fd,
+                     const gchar    *device_file,
+                     guint64         size,
+                     guint           queue_depth,
+                     UDisksBaseJob  *job,
+                     GError        **error)
+{
+  gboolean ret = FALSE;
+  EraseWriters writers = { 0 };
+  GThread **threads;
+  gint64 time_of_last_signal;
+  gint flags;
+  guint n;
+
+  flags = fcntl (fd, F_GETFL);
+  if (flags == -1 || fcntl (fd, F_SETFL, flags | O_DIRECT) != 0)
+    udisks_debug ("Error enabling direct I/O for erasing %s, using buffered writes: %m", device_file);
+
+  writers.fd = fd;
+  writers.size = size;
+  g_mutex_init (&writers.lock);
+  g_cond_init (&writers.cond);
+
+  threads = g_new0 (GThread *, queue_depth);
+  writers.running = queue_depth;
+  for (n = 0; n < queue_depth; n++)
+    threads[n] = g_thread_new ("erase-writer", erase_writer_thread_func, &writers);
+
+  time_of_last_signal = g_get_monotonic_time ();
+  g_mutex_lock (&writers.lock);
+  while (writers.running > 0)
+    {
+      guint64 written;
+
+      g_cond_wait_until (&writers.cond, &writers.lock, g_get_monotonic_time () + G_USEC_PER_SEC);
+      if (g_cancellable_is_cancelled (udisks_base_job_get_cancellable (job)))
+        writers.stop = TRUE;
+
+      /* don't keep the writers waiting while the job properties are updated */
+      written = writers.written;
+      g_mutex_unlock (&writers.lock);
+      erase_update_progress (job, written, size, &time_of_last_signal);
+      g_mutex_lock (&writers.lock);
+    }
+  g_mutex_unlock (&writers.lock);
+
+  for (n = 0; n < queue_depth; n++)
+    g_thread_join (threads[n]);
+  g_free (threads);
+
+  if (writers.error_code != 0)
+    {
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error writing to %s at offset %" G_GUINT64_FORMAT ": %s",
+                   device_file, writers.error_pos, g_strerror (writers.error_code));
+      goto out;
+    }
+
+  if (erase_check_cancelled (job, error))
+    goto out;
+
+  ret = TRUE;
+
+ out:
+  g_cond_clear (&writers.cond);
+  g_mutex_clear (&writers.lock);
+  return ret;
+}
+
 static gboolean
 erase_device (UDisksBlock   *block,
               UDisksObject  *object,
@@ -2367,9 +2579,6 @@ erase_device (UDisksBlock   *block,
   UDisksBaseJob *job = NULL;
   gint fd = -1;
   guint64 size;
-  guint64 pos;
-  guchar *buf = NULL;
-  gint64 time_of_last_signal;
   GError *local_error = NULL;
 
   if (g_strcmp0 (erase_type, "ata-secure-erase") == 0)
@@ -2391,7 +2600,7 @@ erase_device (UDisksBlock   *block,
     }
 
   device_file = udisks_block_get_device (block);
-  fd = open (device_file, O_WRONLY | O_SYNC | O_EXCL);
+  fd = open (device_file, O_WRONLY | O_EXCL | O_CLOEXEC);
   if (fd == -1)
     {
       g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
@@ -2400,6 +2609,7 @@ erase_device (UDisksBlock   *block,
     }
 
   job = udisks_daemon_launch_simple_job (daemon, object, "format-erase", caller_uid, NULL);
+  udisks_method_executor_begin_blocking ();
   udisks_base_job_set_auto_estimate (UDISKS_BASE_JOB (job), TRUE);
   udisks_job_set_progress_valid (UDISKS_JOB (job), TRUE);
 
@@ -2412,44 +2622,29 @@ erase_device (UDisksBlock   *block,
 
   udisks_job_set_bytes (UDISKS_JOB (job), size);
 
-  buf = g_new0 (guchar, ERASE_SIZE);
-  pos = 0;
-  time_of_last_signal = g_get_monotonic_time ();
-  while (pos < size)
-    {
-      size_t to_write;
-      ssize_t num_written;
-      gint64 now;
-
-      to_write = MIN (size - pos, ERASE_SIZE);
-    again:
-      num_written = write (fd, buf, to_write);
-      if (num_written == -1 || num_written == 0)
-        {
-          if (errno == EINTR)
-            goto again;
-          g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
-                       "Error writing %d bytes to %s: %m",
-                       (gint) to_write, device_file);
-          goto out;
-        }
-      pos += num_written;
+  /* Let the device zero itself if it can, the kernel falls back to
+   * writing zeroes on its own for devices without a write zeroes command.
+   * Discarding isn't tried as BLKDISCARDZEROES always reports 0 since
+   * Linux 4.12, so there's no telling whether discarded blocks read back
+   * as zeroes.
+   */
+  if (erase_device_ranges (fd, device_file, size, BLKZEROOUT, "BLKZEROOUT", job, &local_error))
+    goto done;
+  if (local_error != NULL)
+    goto out;
 
-      if (g_cancellable_is_cancelled (udisks_base_job_get_cancellable (job)))
-        {
-          g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_CANCELLED,
-                       "Job was canceled");
-          goto out;
-        }
+  if (!erase_device_writes (fd, device_file, size,
+                            udisks_config_manager_get_erase_queue_depth (udisks_daemon_get_config_manager (daemon)),
+                            job, &local_error))
+    goto out;
 
-      /* only emit D-Bus signal at most once a second */
-      now = g_get_monotonic_time ();
-      if (now - time_of_last_signal > G_USEC_PER_SEC)
-        {
-          /* TODO: estimation etc. */
-          udisks_job_set_progress (UDISKS_JOB (job), ((gdouble) pos) / size);
-          time_of_last_signal = now;
-        }
+ done:
+  /* the zeroes may still be sitting in the write cache of the device, whichever way they got there */
+  if (fdatasync (fd) != 0)
+    {
+      g_set_error (&local_error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Error syncing %s: %m", device_file);
+      goto out;
     }
 
   ret = TRUE;
@@ -2457,6 +2652,7 @@ erase_device (UDisksBlock   *block,
  out:
   if (job != NULL)
     {
+      udisks_method_executor_end_blocking ();
       if (local_error != NULL)
         udisks_simple_job_complete (UDISKS_SIMPLE_JOB (job), FALSE, local_error->message);
       else
@@ -2464,7 +2660,6 @@ erase_device (UDisksBlock   *block,
     }
   if (local_error != NULL)
     g_propagate_error (error, local_error);
-  g_free (buf);
   if (fd != -1)
     close (fd);
   return ret;
@@ -2987,13 +3182,8 @@ udisks_linux_block_handle_format (UDisksBlock             *block,
                                                         encrypt_passphrase != NULL ? "crypto_LUKS" : type);
     }
 
-  if (!udisks_daemon_util_get_caller_uid_sync (daemon, invocation, NULL /* GCancellable */, &caller_uid, &error))
-    {
-      g_dbus_method_invocation_take_error (invocation, error);
-      goto out;
-    }
-
-  if (!udisks_daemon_util_get_user_info (caller_uid, &caller_gid, NULL /* user name */, &error))
+  if (!udisks_daemon_util_get_caller_user_info_sync (daemon, invocation, NULL /* GCancellable */,
+                                                     &caller_uid, &caller_gid, NULL /* user name */, &error))
     {
       g_dbus_method_invocation_take_error (invocation, error);
       goto out;
@@ -44,6 +44,9 @@ void         udisks_linux_block_handle_format (UDisksBlock            *block,
 gboolean     udisks_linux_block_matches_id (UDisksLinuxBlock *block,
                                             const gchar      *device_path);
 
+GList       *udisks_linux_block_find_fstab_entries (UDisksLinuxBlock *block,
+                                                    UDisksDaemon     *daemon);
+
 GVariant    *udisks_linux_find_child_configuration (UDisksDaemon *daemon,
                                                     const gchar    *uuid);
 
@@ -116,22 +116,12 @@ enum
 
 G_DEFINE_TYPE (UDisksLinuxBlockObject, udisks_linux_block_object, UDISKS_TYPE_OBJECT_SKELETON);
 
-static void on_mount_monitor_mount_added   (UDisksMountMonitor  *monitor,
-                                            UDisksMount         *mount,
-                                            gpointer             user_data);
-static void on_mount_monitor_mount_removed (UDisksMountMonitor  *monitor,
-                                            UDisksMount         *mount,
-                                            gpointer             user_data);
-
 static void
 udisks_linux_block_object_finalize (GObject *_object)
 {
   UDisksLinuxBlockObject *object = UDISKS_LINUX_BLOCK_OBJECT (_object);
 
   /* note: we don't hold a ref to block->daemon or block->mount_monitor */
-  g_signal_handlers_disconnect_by_func (object->mount_monitor, on_mount_monitor_mount_added, object);
-  g_signal_handlers_disconnect_by_func (object->mount_monitor, on_mount_monitor_mount_removed, object);
-
   g_object_unref (object->device);
   g_mutex_clear (&object->device_mutex);
 
@@ -228,15 +218,8 @@ udisks_linux_block_object_constructed (GObject *_object)
 
   object->module_ifaces = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_object_unref);
 
+  /* mount changes are dispatched by #UDisksDaemon, see udisks_daemon_find_block() */
   object->mount_monitor = udisks_daemon_get_mount_monitor (object->daemon);
-  g_signal_connect (object->mount_monitor,
-                    "mount-added",
-                    G_CALLBACK (on_mount_monitor_mount_added),
-                    object);
-  g_signal_connect (object->mount_monitor,
-                    "mount-removed",
-                    G_CALLBACK (on_mount_monitor_mount_removed),
-                    object);
 
   /* initial coldplug */
   udisks_linux_block_object_uevent (object, "add", NULL);
@@ -937,28 +920,6 @@ udisks_linux_block_object_uevent (UDisksLinuxBlockObject *object,
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-static void
-on_mount_monitor_mount_added (UDisksMountMonitor  *monitor,
-                              UDisksMount         *mount,
-                              gpointer             user_data)
-{
-  UDisksLinuxBlockObject *object = UDISKS_LINUX_BLOCK_OBJECT (user_data);
-  if (udisks_mount_get_dev (mount) == g_udev_device_get_device_number (object->device->udev_device))
-    udisks_linux_block_object_uevent (object, NULL, NULL);
-}
-
-static void
-on_mount_monitor_mount_removed (UDisksMountMonitor  *monitor,
-                                UDisksMount         *mount,
-                                gpointer             user_data)
-{
-  UDisksLinuxBlockObject *object = UDISKS_LINUX_BLOCK_OBJECT (user_data);
-  if (udisks_mount_get_dev (mount) == g_udev_device_get_device_number (object->device->udev_device))
-    udisks_linux_block_object_uevent (object, NULL, NULL);
-}
-
-/* ---------------------------------------------------------------------------------------------------- */
-
 static volatile guint uevent_serial = 0;
 
 static gboolean
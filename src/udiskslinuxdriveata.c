@@ -44,6 +44,7 @@
 #include "udiskslinuxdriveata.h"
 #include "udiskslinuxblockobject.h"
 #include "udisksdaemon.h"
+#include "udisksmethodexecutor.h"
 #include "udisksdaemonutil.h"
 #include "udisksbasejob.h"
 #include "udiskssimplejob.h"
@@ -2073,6 +2074,7 @@ udisks_linux_drive_ata_secure_erase_sync (UDisksLinuxDriveAta  *drive,
                                          UDISKS_OBJECT (object),
                                          enhanced ? "ata-enhanced-secure-erase" : "ata-secure-erase",
                                          caller_uid, NULL);
+  udisks_method_executor_begin_blocking ();
   udisks_job_set_cancelable (UDISKS_JOB (job), FALSE);
 
   /* A value of 510 (255 in the IDENTIFY DATA register) means "erase
@@ -2220,6 +2222,7 @@ udisks_linux_drive_ata_secure_erase_sync (UDisksLinuxDriveAta  *drive,
     g_source_remove (timeout_id);
   if (job != NULL)
     {
+      udisks_method_executor_end_blocking ();
       /* propagate error, if any */
       if (local_error == NULL)
         {
@@ -37,8 +37,6 @@
 #include <blockdev/fs.h>
 #include <blockdev/utils.h>
 
-#include <libmount/libmount.h>
-
 #include <glib/gstdio.h>
 
 #include "udiskslogging.h"
@@ -52,6 +50,7 @@
 #include "udisksdaemonutil.h"
 #include "udisksmountmonitor.h"
 #include "udisksmount.h"
+#include "udisksfstabentry.h"
 #include "udiskslinuxdevice.h"
 #include "udiskssimplejob.h"
 #include "udiskslinuxdriveata.h"
@@ -740,42 +739,34 @@ is_system_managed (UDisksDaemon *daemon,
 {
   UDisksMountMonitor *mount_monitor = udisks_daemon_get_mount_monitor (daemon);
   gboolean ret = FALSE;
-  struct libmnt_table *table;
-  struct libmnt_iter* iter;
-  struct libmnt_fs *fs = NULL;
+  GList *entries;
+  GList *l;
 
-  table = mnt_new_table ();
-  if (mnt_table_parse_fstab (table, NULL) < 0)
+  /* the fstab monitor only re-reads the file when it has changed */
+  entries = udisks_linux_block_find_fstab_entries (UDISKS_LINUX_BLOCK (block), daemon);
+  for (l = entries; l != NULL; l = l->next)
     {
-      mnt_free_table (table);
-      return FALSE;
-    }
+      UDisksFstabEntry *entry = UDISKS_FSTAB_ENTRY (l->data);
+      UDisksMount *mount;
 
-  iter = mnt_new_iter (MNT_ITER_FORWARD);
-  while (mnt_table_next_fs (table, iter, &fs) == 0)
-    {
-      if (udisks_linux_block_matches_id (UDISKS_LINUX_BLOCK (block), mnt_fs_get_source (fs)))
+      /* If this block device is found in fstab, but something else is already
+       * mounted on that mount point, ignore the fstab entry.
+       */
+      mount = udisks_mount_monitor_get_mount_for_path (mount_monitor, udisks_fstab_entry_get_dir (entry));
+      if (mount == NULL || udisks_block_get_device_number (block) == udisks_mount_get_dev (mount))
         {
-          /* If this block device is found in fstab, but something else is already
-           * mounted on that mount point, ignore the fstab entry.
-           */
-          UDisksMount *mount = udisks_mount_monitor_get_mount_for_path (mount_monitor, mnt_fs_get_target (fs));
-          if (mount == NULL || udisks_block_get_device_number (block) == udisks_mount_get_dev (mount))
-            {
-              ret = TRUE;
-              if (out_mount_point != NULL)
-                *out_mount_point = g_strdup (mnt_fs_get_target (fs));
-              if (out_mount_options != NULL)
-                *out_mount_options = mnt_fs_strdup_options (fs);
-            }
-
-          g_clear_object (&mount);
-          if (ret)
-            break;
+          ret = TRUE;
+          if (out_mount_point != NULL)
+            *out_mount_point = g_strdup (udisks_fstab_entry_get_dir (entry));
+          if (out_mount_options != NULL)
+            *out_mount_options = g_strdup (udisks_fstab_entry_get_opts (entry));
         }
+
+      g_clear_object (&mount);
+      if (ret)
+        break;
     }
-  mnt_free_iter (iter);
-  mnt_free_table (table);
+  g_list_free_full (entries, g_object_unref);
 
   return ret;
 }
@@ -859,18 +850,13 @@ handle_mount (UDisksFilesystem      *filesystem,
       goto out;
     }
 
-  if (!udisks_daemon_util_get_caller_uid_sync (daemon,
-                                               invocation,
-                                               NULL /* GCancellable */,
-                                               &caller_uid,
-                                               &error))
-    {
-      g_dbus_method_invocation_return_gerror (invocation, error);
-      g_clear_error (&error);
-      goto out;
-    }
-
-  if (!udisks_daemon_util_get_user_info (caller_uid, &caller_gid, &caller_user_name, &error))
+  if (!udisks_daemon_util_get_caller_user_info_sync (daemon,
+                                                     invocation,
+                                                     NULL /* GCancellable */,
+                                                     &caller_uid,
+                                                     &caller_gid,
+                                                     &caller_user_name,
+                                                     &error))
     {
       g_dbus_method_invocation_return_gerror (invocation, error);
       g_clear_error (&error);
@@ -1296,13 +1282,7 @@ handle_unmount (UDisksFilesystem      *filesystem,
   wait_data.object_path = g_dbus_object_get_object_path (G_DBUS_OBJECT (object));
   wait_data.old_size = g_strv_length ((gchar **) mount_points);
 
-  if (!udisks_daemon_util_get_caller_uid_sync (daemon, invocation, NULL, &caller_uid, &error))
-    {
-      g_dbus_method_invocation_return_gerror (invocation, error);
-      g_clear_error (&error);
-      goto out;
-    }
-  if (!udisks_daemon_util_get_user_info (caller_uid, &caller_gid, NULL, &error))
+  if (!udisks_daemon_util_get_caller_user_info_sync (daemon, invocation, NULL, &caller_uid, &caller_gid, NULL, &error))
     {
       g_dbus_method_invocation_take_error (invocation, error);
       goto out;
@@ -2259,17 +2239,13 @@ handle_take_ownership (UDisksFilesystem      *filesystem,
   udisks_linux_block_object_lock_for_cleanup (UDISKS_LINUX_BLOCK_OBJECT (object));
   udisks_state_check_block (state, udisks_linux_block_object_get_device_number (UDISKS_LINUX_BLOCK_OBJECT (object)));
 
-  if (! udisks_daemon_util_get_caller_uid_sync (daemon,
-                                                invocation,
-                                                NULL /* GCancellable */,
-                                                &caller_uid,
-                                                &error))
-    {
-      g_dbus_method_invocation_return_gerror (invocation, error);
-      goto out;
-    }
-
-  if (!udisks_daemon_util_get_user_info (caller_uid, &caller_gid, NULL /* user name */, &error))
+  if (! udisks_daemon_util_get_caller_user_info_sync (daemon,
+                                                      invocation,
+                                                      NULL /* GCancellable */,
+                                                      &caller_uid,
+                                                      &caller_gid,
+                                                      NULL /* user name */,
+                                                      &error))
     {
       g_dbus_method_invocation_return_gerror (invocation, error);
       goto out;
@@ -1162,24 +1162,75 @@ handle_get_block_devices (UDisksManager         *object,
 }
 
 static gboolean
-compare_paths (UDisksManager         *object,
-               UDisksBlock           *block,
-               const gchar           *path)
+handle_get_block_devices_with_properties (UDisksManager         *object,
+                                          GDBusMethodInvocation *invocation,
+                                          GVariant              *arg_options)
 {
-  const gchar *const *symlinks = NULL;
+  GSList *blocks = NULL;
+  GSList *blocks_p = NULL;
+  GVariantBuilder builder;
+  guint num_blocks = 0;
+
+  blocks = get_block_objects (object, &num_blocks);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{oa{sv}}"));
+  for (blocks_p = blocks; blocks_p != NULL; blocks_p = blocks_p->next)
+    {
+      GDBusInterfaceSkeleton *block = G_DBUS_INTERFACE_SKELETON (blocks_p->data);
+      GDBusObject *block_object = g_dbus_interface_get_object (G_DBUS_INTERFACE (block));
+      GVariant *properties;
+
+      if (block_object == NULL)
+        continue;
+      properties = g_dbus_interface_skeleton_get_properties (block);
+      g_variant_builder_add (&builder, "{o@a{sv}}",
+                             g_dbus_object_get_object_path (block_object),
+                             properties);
+      g_variant_unref (properties);
+    }
+
+  udisks_manager_complete_get_block_devices_with_properties (object,
+                                                             invocation,
+                                                             g_variant_builder_end (&builder));
 
-  if (g_strcmp0 (udisks_block_get_device (block), path) == 0)
-    return TRUE;
+  g_slist_free_full (blocks, g_object_unref);
+
+  return TRUE;  /* returning TRUE means that we handled the method invocation */
+}
+
+static GList *
+resolve_device_lookup (UDisksDaemon *daemon,
+                       const gchar  *key,
+                       const gchar  *value)
+{
+  GList *ret = NULL;
+  UDisksObject *object;
 
-  symlinks = udisks_block_get_symlinks (block);
-  if (symlinks != NULL)
+  if (g_strcmp0 (key, "path") == 0)
     {
-      for (guint i = 0; symlinks[i] != NULL; i++)
-        if (g_strcmp0 (symlinks[i], path) == 0)
-          return TRUE;
+      /* both #UDisksBlock:device and #UDisksBlock:symlinks are matched */
+      object = udisks_daemon_find_block_by_device_file (daemon, value);
+      if (object != NULL)
+        ret = g_list_prepend (ret, object);
+      object = udisks_daemon_find_block_by_symlink (daemon, value);
+      if (object != NULL)
+        {
+          if (g_list_find (ret, object) == NULL)
+            ret = g_list_prepend (ret, object);
+          else
+            g_object_unref (object);
+        }
     }
+  else if (g_strcmp0 (key, "uuid") == 0)
+    ret = udisks_daemon_find_blocks_by_uuid (daemon, value);
+  else if (g_strcmp0 (key, "label") == 0)
+    ret = udisks_daemon_find_blocks_by_label (daemon, value);
+  else if (g_strcmp0 (key, "partuuid") == 0)
+    ret = udisks_daemon_find_blocks_by_partuuid (daemon, value);
+  else if (g_strcmp0 (key, "partlabel") == 0)
+    ret = udisks_daemon_find_blocks_by_partlabel (daemon, value);
 
-  return FALSE;
+  return ret;
 }
 
 static gboolean
@@ -1188,58 +1239,358 @@ handle_resolve_device (UDisksManager         *object,
                        GVariant              *arg_devspec,
                        GVariant              *arg_options)
 {
-  const gchar *devpath = NULL;
-  const gchar *devuuid = NULL;
-  const gchar *devlabel = NULL;
-
-  GSList *blocks = NULL;
-  GSList *blocks_p = NULL;
-  guint num_blocks = 0;
-
-  GSList *ret = NULL;
-  GSList *ret_p = NULL;
-  guint num_found = 0;
+  UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+  static const gchar *const keys[] = { "path", "uuid", "label", "partuuid", "partlabel", NULL };
+  const gchar *value = NULL;
+  gboolean have_key = FALSE;
+
+  GList *ret = NULL;
+  GList *ret_p = NULL;
+  GList *next = NULL;
+  GList *matches = NULL;
   const gchar **ret_paths = NULL;
 
-  gboolean found = FALSE;
   guint i = 0;
 
-  g_variant_lookup (arg_devspec, "path", "&s", &devpath);
-  g_variant_lookup (arg_devspec, "uuid", "&s", &devuuid);
-  g_variant_lookup (arg_devspec, "label", "&s", &devlabel);
+  /* Each key is resolved from the daemon's block indexes and only devices
+   * matching all the given keys are returned.
+   */
+  for (i = 0; keys[i] != NULL; i++)
+    {
+      if (!g_variant_lookup (arg_devspec, keys[i], "&s", &value))
+        continue;
 
-  blocks = get_block_objects (object, &num_blocks);
+      matches = resolve_device_lookup (manager->daemon, keys[i], value);
+      if (!have_key)
+        {
+          ret = matches;
+          have_key = TRUE;
+        }
+      else
+        {
+          for (ret_p = ret; ret_p != NULL; ret_p = next)
+            {
+              next = ret_p->next;
+              if (g_list_find (matches, ret_p->data) == NULL)
+                {
+                  g_object_unref (ret_p->data);
+                  ret = g_list_delete_link (ret, ret_p);
+                }
+            }
+          g_list_free_full (matches, g_object_unref);
+        }
 
-  for (blocks_p = blocks; blocks_p != NULL; blocks_p = blocks_p->next)
+      if (ret == NULL)
+        break;
+    }
+
+  ret_paths = g_new0 (const gchar *, g_list_length (ret) + 1);
+  for (i = 0, ret_p = ret; ret_p != NULL; ret_p = ret_p->next, i++)
+    ret_paths[i] = g_dbus_object_get_object_path (G_DBUS_OBJECT (ret_p->data));
+
+  udisks_manager_complete_resolve_device (object,
+                                          invocation,
+                                          ret_paths);
+
+  g_free (ret_paths);
+  g_list_free_full (ret, g_object_unref);
+
+  return TRUE;  /* returning TRUE means that we handled the method invocation */
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  gchar    *interface_name;
+  gchar    *property_name;
+  GVariant *value;
+} ObjectsMatch;
+
+typedef struct
+{
+  GHashTable *interfaces;   /* interface name -> itself, NULL means all */
+  GHashTable *properties;   /* interface name -> (property name -> itself), NULL means all */
+  GPtrArray  *matches;      /* of ObjectsMatch */
+} ObjectsFilter;
+
+static void
+objects_match_free (ObjectsMatch *match)
+{
+  g_free (match->interface_name);
+  g_free (match->property_name);
+  g_variant_unref (match->value);
+  g_free (match);
+}
+
+static void
+objects_filter_clear (ObjectsFilter *filter)
+{
+  g_clear_pointer (&filter->interfaces, g_hash_table_destroy);
+  g_clear_pointer (&filter->properties, g_hash_table_destroy);
+  g_clear_pointer (&filter->matches, g_ptr_array_unref);
+}
+
+/* Expands short interface names like "Block" or "Drive.Ata" to
+ * "org.freedesktop.UDisks2.Block" or "org.freedesktop.UDisks2.Drive.Ata".
+ */
+static gchar *
+objects_filter_interface_name (const gchar *name)
+{
+  if (!g_str_has_prefix (name, "org.freedesktop."))
+    return g_strdup_printf ("org.freedesktop.UDisks2.%s", name);
+  return g_strdup (name);
+}
+
+/* Splits "Interface.Property" into its parts, the interface name may be a short one. */
+static gboolean
+objects_filter_split_property (const gchar  *spec,
+                               gchar       **out_interface_name,
+                               gchar       **out_property_name,
+                               GError      **error)
+{
+  const gchar *dot;
+  gchar *interface_name;
+
+  dot = strrchr (spec, '.');
+  if (dot == NULL || dot == spec || dot[1] == '\0')
     {
-      if (devpath != NULL)
-          found = compare_paths (object, blocks_p->data, devpath);
+      g_set_error (error, UDISKS_ERROR, UDISKS_ERROR_FAILED,
+                   "Invalid property specification '%s', expected 'Interface.Property'", spec);
+      return FALSE;
+    }
 
-      if (devuuid != NULL)
-          found = g_strcmp0 (udisks_block_get_id_uuid (blocks_p->data), devuuid) == 0;
-      if (devlabel != NULL)
-          found = g_strcmp0 (udisks_block_get_id_label (blocks_p->data), devlabel) == 0;
+  interface_name = g_strndup (spec, dot - spec);
+  *out_interface_name = objects_filter_interface_name (interface_name);
+  *out_property_name = g_strdup (dot + 1);
+  g_free (interface_name);
 
-      if (found)
+  return TRUE;
+}
+
+static gboolean
+objects_filter_init (ObjectsFilter *filter,
+                     GVariant      *arg_filter,
+                     GError       **error)
+{
+  gboolean ret = FALSE;
+  const gchar **interfaces = NULL;
+  const gchar **properties = NULL;
+  GVariant *match_dict = NULL;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *value;
+  guint n;
+
+  memset (filter, 0, sizeof (ObjectsFilter));
+  filter->matches = g_ptr_array_new_with_free_func ((GDestroyNotify) objects_match_free);
+
+  if (g_variant_lookup (arg_filter, "interfaces", "^a&s", &interfaces))
+    {
+      filter->interfaces = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      for (n = 0; interfaces[n] != NULL; n++)
         {
-          ret = g_slist_prepend (ret, blocks_p->data);
-          num_found++;
+          gchar *interface_name = objects_filter_interface_name (interfaces[n]);
+          g_hash_table_add (filter->interfaces, interface_name);
         }
     }
 
-  ret_paths = g_new0 (const gchar *, num_found + 1);
-  for (i = 0,ret_p = ret; ret_p != NULL; ret_p = ret_p->next, i++)
+  if (g_variant_lookup (arg_filter, "properties", "^a&s", &properties))
     {
-      ret_paths[i] = g_dbus_object_get_object_path (g_dbus_interface_get_object (G_DBUS_INTERFACE (ret_p->data)));
+      filter->properties = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                  (GDestroyNotify) g_hash_table_destroy);
+      for (n = 0; properties[n] != NULL; n++)
+        {
+          gchar *interface_name = NULL;
+          gchar *property_name = NULL;
+          GHashTable *names;
+
+          if (!objects_filter_split_property (properties[n], &interface_name, &property_name, error))
+            goto out;
+
+          names = g_hash_table_lookup (filter->properties, interface_name);
+          if (names == NULL)
+            {
+              names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+              g_hash_table_insert (filter->properties, interface_name, names);
+            }
+          else
+            {
+              g_free (interface_name);
+            }
+          g_hash_table_add (names, property_name);
+        }
     }
 
-  udisks_manager_complete_resolve_device (object,
-                                          invocation,
-                                          ret_paths);
+  match_dict = g_variant_lookup_value (arg_filter, "match", G_VARIANT_TYPE_VARDICT);
+  if (match_dict != NULL)
+    {
+      g_variant_iter_init (&iter, match_dict);
+      while (g_variant_iter_next (&iter, "{&sv}", &key, &value))
+        {
+          ObjectsMatch *match = g_new0 (ObjectsMatch, 1);
 
-  g_free (ret_paths);
-  g_slist_free_full (blocks, g_object_unref);
-  g_slist_free (ret);
+          match->value = value;
+          g_ptr_array_add (filter->matches, match);
+          if (!objects_filter_split_property (key, &match->interface_name, &match->property_name, error))
+            goto out;
+        }
+    }
+
+  ret = TRUE;
+
+ out:
+  g_free (interfaces);
+  g_free (properties);
+  if (match_dict != NULL)
+    g_variant_unref (match_dict);
+  if (!ret)
+    objects_filter_clear (filter);
+  return ret;
+}
+
+/* Returns the cached properties of @interface, or %NULL if it's not a skeleton. */
+static GVariant *
+objects_filter_get_properties (GDBusInterface *interface)
+{
+  if (!G_IS_DBUS_INTERFACE_SKELETON (interface))
+    return NULL;
+  return g_dbus_interface_skeleton_get_properties (G_DBUS_INTERFACE_SKELETON (interface));
+}
+
+static gboolean
+objects_filter_matches (ObjectsFilter *filter,
+                        GDBusObject   *object)
+{
+  gboolean ret = TRUE;
+  guint n;
+
+  for (n = 0; ret && n < filter->matches->len; n++)
+    {
+      ObjectsMatch *match = filter->matches->pdata[n];
+      GDBusInterface *interface;
+      GVariant *properties = NULL;
+      GVariant *value = NULL;
+
+      interface = g_dbus_object_get_interface (object, match->interface_name);
+      if (interface != NULL)
+        properties = objects_filter_get_properties (interface);
+      if (properties != NULL)
+        value = g_variant_lookup_value (properties, match->property_name, NULL);
+
+      ret = value != NULL && g_variant_equal (value, match->value);
+
+      if (value != NULL)
+        g_variant_unref (value);
+      if (properties != NULL)
+        g_variant_unref (properties);
+      g_clear_object (&interface);
+    }
+
+  return ret;
+}
+
+/* Adds the selected properties of @interface to @builder (of type a{sa{sv}}) */
+static void
+objects_filter_add_interface (ObjectsFilter   *filter,
+                              GDBusInterface  *interface,
+                              GVariantBuilder *builder)
+{
+  const gchar *interface_name;
+  GHashTable *names = NULL;
+  GVariant *properties;
+  GVariantBuilder props_builder;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *value;
+
+  interface_name = g_dbus_interface_get_info (interface)->name;
+  if (filter->interfaces != NULL && !g_hash_table_contains (filter->interfaces, interface_name))
+    return;
+
+  properties = objects_filter_get_properties (interface);
+  if (properties == NULL)
+    return;
+
+  if (filter->properties != NULL)
+    names = g_hash_table_lookup (filter->properties, interface_name);
+
+  if (names == NULL)
+    {
+      g_variant_builder_add (builder, "{s@a{sv}}", interface_name, properties);
+    }
+  else
+    {
+      g_variant_builder_init (&props_builder, G_VARIANT_TYPE_VARDICT);
+      g_variant_iter_init (&iter, properties);
+      while (g_variant_iter_next (&iter, "{&sv}", &key, &value))
+        {
+          if (g_hash_table_contains (names, key))
+            g_variant_builder_add (&props_builder, "{sv}", key, value);
+          g_variant_unref (value);
+        }
+      g_variant_builder_add (builder, "{sa{sv}}", interface_name, &props_builder);
+    }
+
+  g_variant_unref (properties);
+}
+
+static gboolean
+handle_get_objects (UDisksManager         *object,
+                    GDBusMethodInvocation *invocation,
+                    GVariant              *arg_filter,
+                    GVariant              *arg_options)
+{
+  UDisksLinuxManager *manager = UDISKS_LINUX_MANAGER (object);
+  GDBusObjectManagerServer *object_manager;
+  ObjectsFilter filter;
+  GVariantBuilder builder;
+  GList *objects;
+  GList *objects_p;
+  GError *error = NULL;
+
+  if (!objects_filter_init (&filter, arg_filter, &error))
+    {
+      g_dbus_method_invocation_take_error (invocation, error);
+      return TRUE;
+    }
+
+  object_manager = udisks_daemon_get_object_manager (manager->daemon);
+  objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (object_manager));
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{oa{sa{sv}}}"));
+  for (objects_p = objects; objects_p != NULL; objects_p = objects_p->next)
+    {
+      GDBusObject *dbus_object = G_DBUS_OBJECT (objects_p->data);
+      GVariantBuilder interfaces_builder;
+      GList *interfaces;
+      GList *interfaces_p;
+      GVariant *interfaces_dict;
+
+      if (!objects_filter_matches (&filter, dbus_object))
+        continue;
+
+      g_variant_builder_init (&interfaces_builder, G_VARIANT_TYPE ("a{sa{sv}}"));
+      interfaces = g_dbus_object_get_interfaces (dbus_object);
+      for (interfaces_p = interfaces; interfaces_p != NULL; interfaces_p = interfaces_p->next)
+        objects_filter_add_interface (&filter, G_DBUS_INTERFACE (interfaces_p->data), &interfaces_builder);
+      g_list_free_full (interfaces, g_object_unref);
+
+      /* objects without any of the selected interfaces are left out */
+      interfaces_dict = g_variant_ref_sink (g_variant_builder_end (&interfaces_builder));
+      if (g_variant_n_children (interfaces_dict) > 0)
+        g_variant_builder_add (&builder, "{o@a{sa{sv}}}",
+                               g_dbus_object_get_object_path (dbus_object),
+                               interfaces_dict);
+      g_variant_unref (interfaces_dict);
+    }
+
+  udisks_manager_complete_get_objects (object,
+                                       invocation,
+                                       g_variant_builder_end (&builder));
+
+  g_list_free_full (objects, g_object_unref);
+  objects_filter_clear (&filter);
 
   return TRUE;  /* returning TRUE means that we handled the method invocation */
 }
@@ -1258,5 +1609,7 @@ manager_iface_init (UDisksManagerIface *iface)
   iface->handle_can_check = handle_can_check;
   iface->handle_can_repair = handle_can_repair;
   iface->handle_get_block_devices = handle_get_block_devices;
+  iface->handle_get_block_devices_with_properties = handle_get_block_devices_with_properties;
   iface->handle_resolve_device = handle_resolve_device;
+  iface->handle_get_objects = handle_get_objects;
 }
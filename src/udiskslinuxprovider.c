@@ -29,16 +29,26 @@
 #include "udisksprovider.h"
 #include "udiskslinuxprovider.h"
 #include "udiskslinuxblockobject.h"
+#include "udiskslinuxblock.h"
+#include "udisksfstabentry.h"
+#include "udisksfstabmonitor.h"
+#include "udiskscrypttabentry.h"
 #include "udiskslinuxdriveobject.h"
 #include "udiskslinuxmdraidobject.h"
 #include "udiskslinuxmanager.h"
 #include "udisksstate.h"
+#include "udisksmountmonitor.h"
 #include "udiskslinuxdevice.h"
 #include "udisksmodulemanager.h"
 #include "udisksmodule.h"
 #include "udisksmoduleobject.h"
 #include "udisksdaemonutil.h"
 #include "udisksconfigmanager.h"
+#include "udisksmethodexecutor.h"
+#include "udisksauthorizationcache.h"
+#ifdef HAVE_LIBMOUNT_UTAB
+#include "udisksutabentry.h"
+#endif
 
 /**
  * SECTION:udiskslinuxprovider
@@ -62,8 +72,18 @@ struct _UDisksLinuxProvider
   UDisksProvider parent_instance;
 
   GUdevClient *gudev_client;
-  GAsyncQueue *probe_request_queue;
-  GThread *probe_request_thread;
+
+  /* pool of threads probing devices on uevents, see probe_request_thread_func() */
+  GThreadPool *probe_pool;
+  GMutex probe_lock;
+  /* maps from sysfs path to ProbeDeviceQueue, only for devices with pending requests */
+  GHashTable *probe_device_queues;
+  /* probed requests waiting to be handled in the main thread, see on_idle_with_probed_uevents() */
+  GQueue probed_requests;
+  guint probed_idle_id;
+  /* uevent statistics, protected by probe_lock */
+  guint64 n_uevents_received;
+  guint64 n_uevents_merged;
 
   UDisksObjectSkeleton *manager_object;
 
@@ -82,7 +102,6 @@ struct _UDisksLinuxProvider
   /* maps from UDisksModule to nested hashtables containing object skeleton instances */
   GHashTable *module_objects;
 
-  GUnixMountMonitor *mount_monitor;
   GFileMonitor *etc_udisks2_dir_monitor;
 
   /* Module interfaces hashtable */
@@ -114,8 +133,13 @@ static void udisks_linux_provider_handle_uevent (UDisksLinuxProvider *provider,
 
 static gboolean on_housekeeping_timeout (gpointer user_data);
 
-static void mount_monitor_on_mountpoints_changed (GUnixMountMonitor *monitor,
-                                                  gpointer           user_data);
+static void fstab_monitor_on_entry_added (UDisksFstabMonitor *monitor,
+                                          UDisksFstabEntry   *entry,
+                                          gpointer            user_data);
+
+static void fstab_monitor_on_entry_removed (UDisksFstabMonitor *monitor,
+                                            UDisksFstabEntry   *entry,
+                                            gpointer            user_data);
 
 static void crypttab_monitor_on_entry_added (UDisksCrypttabMonitor *monitor,
                                              UDisksCrypttabEntry   *entry,
@@ -141,7 +165,9 @@ static void on_etc_udisks2_dir_monitor_changed (GFileMonitor     *monitor,
                                                 GFileMonitorEvent event_type,
                                                 gpointer          user_data);
 
-gpointer probe_request_thread_func (gpointer user_data);
+static void probe_request_thread_func (gpointer data,
+                                       gpointer user_data);
+static void probe_device_queue_free (gpointer data);
 
 static void detach_module_interfaces (UDisksLinuxProvider *provider);
 static void ensure_modules (UDisksLinuxProvider *provider);
@@ -163,10 +189,12 @@ udisks_linux_provider_finalize (GObject *object)
   UDisksDaemon *daemon;
   UDisksModuleManager *module_manager;
 
-  /* stop the request thread and wait for it */
-  g_async_queue_push (provider->probe_request_queue, (gpointer) 0xdeadbeef);
-  g_thread_join (provider->probe_request_thread);
-  g_async_queue_unref (provider->probe_request_queue);
+  /* every pending probe request holds a reference to @provider so there's
+   * nothing left to probe at this point - just wait for the workers to exit
+   */
+  g_thread_pool_free (provider->probe_pool, TRUE, TRUE);
+  g_hash_table_unref (provider->probe_device_queues);
+  g_mutex_clear (&provider->probe_lock);
 
   daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
 
@@ -199,8 +227,11 @@ udisks_linux_provider_finalize (GObject *object)
   if (provider->housekeeping_timeout > 0)
     g_source_remove (provider->housekeeping_timeout);
 
-  g_signal_handlers_disconnect_by_func (provider->mount_monitor,
-                                        G_CALLBACK (mount_monitor_on_mountpoints_changed),
+  g_signal_handlers_disconnect_by_func (udisks_daemon_get_fstab_monitor (daemon),
+                                        G_CALLBACK (fstab_monitor_on_entry_added),
+                                        provider);
+  g_signal_handlers_disconnect_by_func (udisks_daemon_get_fstab_monitor (daemon),
+                                        G_CALLBACK (fstab_monitor_on_entry_removed),
                                         provider);
   g_signal_handlers_disconnect_by_func (udisks_daemon_get_crypttab_monitor (daemon),
                                         G_CALLBACK (crypttab_monitor_on_entry_added),
@@ -209,8 +240,6 @@ udisks_linux_provider_finalize (GObject *object)
                                         G_CALLBACK (crypttab_monitor_on_entry_removed),
                                         provider);
 
-  g_object_unref (provider->mount_monitor);
-
   if (G_OBJECT_CLASS (udisks_linux_provider_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (udisks_linux_provider_parent_class)->finalize (object);
 }
@@ -222,6 +251,7 @@ typedef struct
   UDisksLinuxProvider *provider;
   GUdevDevice *udev_device;
   UDisksLinuxDevice *udisks_device;
+  guint n_init_retries;
 } ProbeRequest;
 
 static void
@@ -233,72 +263,216 @@ probe_request_free (ProbeRequest *request)
   g_slice_free (ProbeRequest, request);
 }
 
-/* ---------------------------------------------------------------------------------------------------- */
+/* Requests for a single device. Only one worker at a time handles a
+ * ProbeDeviceQueue so that uevents for the same device are probed (and
+ * handed over to the main thread) in the order they were received while
+ * uevents for different devices are probed concurrently.
+ *
+ * A queue is present in provider->probe_device_queues for as long as it
+ * is either scheduled in provider->probe_pool, being processed by a
+ * worker or parked waiting for udev to initialize the device. Protected
+ * by provider->probe_lock.
+ */
+typedef struct
+{
+  UDisksLinuxProvider *provider;  /* not owned, every request holds a reference */
+  gchar *sysfs_path;
+  GQueue requests;  /* of ProbeRequest, not including the one being probed */
+} ProbeDeviceQueue;
 
-/* called in main thread with a processed ProbeRequest struct - see probe_request_thread_func() */
-static gboolean
-on_idle_with_probed_uevent (gpointer user_data)
-{
-  ProbeRequest *request = user_data;
-  udisks_linux_provider_handle_uevent (request->provider,
-                                       g_udev_device_get_action (request->udev_device),
-                                       request->udisks_device);
-  g_signal_emit (request->provider,
-                 signals[UEVENT_PROBED_SIGNAL],
-                 0,
-                 g_udev_device_get_action (request->udev_device),
-                 request->udisks_device);
-  probe_request_free (request);
-  return FALSE; /* remove source */
+/* how long and how many times to wait for udev to initialize a device before probing it anyway */
+#define PROBE_INIT_RETRY_MSEC   100
+#define PROBE_INIT_MAX_RETRIES  5
+
+static void
+probe_device_queue_free (gpointer data)
+{
+  ProbeDeviceQueue *queue = data;
+
+  g_queue_foreach (&queue->requests, (GFunc) probe_request_free, NULL);
+  g_queue_clear (&queue->requests);
+  g_free (queue->sysfs_path);
+  g_slice_free (ProbeDeviceQueue, queue);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-gpointer
-probe_request_thread_func (gpointer user_data)
+/* Maximum time spent handling probed uevents in a single main loop iteration.
+ * Whatever is left over is handled in the next iteration so that the main
+ * loop stays responsive during uevent storms.
+ */
+#define PROBED_BATCH_MAX_USEC (50 * 1000)
+
+static gboolean handle_uevent (UDisksLinuxProvider *provider,
+                               const gchar         *action,
+                               UDisksLinuxDevice   *device);
+
+/* called in main thread with processed ProbeRequest structs queued in
+ * provider->probed_requests - see probe_request_thread_func()
+ *
+ * All requests ready at this point are handled as one batch under a single
+ * provider_lock acquisition with at most one state check for the whole batch.
+ */
+static gboolean
+on_idle_with_probed_uevents (gpointer user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
   ProbeRequest *request;
-  gboolean dev_initialized = FALSE;
-  guint n_tries = 0;
+  GQueue batch;
+  GQueue handled = G_QUEUE_INIT;
+  GArray *state_check_devs;
+  gboolean ret;
+  gint64 deadline;
+
+  /* the last request may be holding the last reference to @provider */
+  g_object_ref (provider);
+
+  g_mutex_lock (&provider->probe_lock);
+  batch = provider->probed_requests;
+  g_queue_init (&provider->probed_requests);
+  g_mutex_unlock (&provider->probe_lock);
 
-  do
+  deadline = g_get_monotonic_time () + PROBED_BATCH_MAX_USEC;
+
+  state_check_devs = g_array_new (FALSE, FALSE, sizeof (dev_t));
+
+  G_LOCK (provider_lock);
+  while ((request = g_queue_pop_head (&batch)) != NULL)
     {
-      request = g_async_queue_pop (provider->probe_request_queue);
+      if (handle_uevent (provider,
+                         g_udev_device_get_action (request->udev_device),
+                         request->udisks_device))
+        {
+          dev_t dev = g_udev_device_get_device_number (request->udisks_device->udev_device);
+          g_array_append_val (state_check_devs, dev);
+        }
+      g_queue_push_tail (&handled, request);
 
-      /* used by _finalize() above to stop this thread - if received, we can
-       * no longer use @provider
-       */
-      if (request == (gpointer) 0xdeadbeef)
-        goto out;
+      if (g_get_monotonic_time () >= deadline)
+        break;
+    }
+  if (state_check_devs->len > 0)
+    {
+      /* Possibly need to clean up */
+      udisks_state_check_devices (udisks_daemon_get_state (udisks_provider_get_daemon (UDISKS_PROVIDER (provider))),
+                                  (const dev_t *) state_check_devs->data,
+                                  state_check_devs->len);
+    }
+  G_UNLOCK (provider_lock);
+  g_array_free (state_check_devs, TRUE);
 
-      /* Try to wait for the device to become initialized(*) before we start
-       * gathering data for it.
-       *
-       * (*) "Check if udev has already handled the device and has set up device
-       *      node permissions and context, or has renamed a network device.
-       *      This is only implemented for devices with a device node or network
-       *      interfaces. All other devices return 1 here."
-       *        -- UDEV docs
-       *
-       * */
-      dev_initialized = g_udev_device_get_is_initialized (request->udev_device);
-      for (n_tries=5; !dev_initialized && (n_tries > 0); n_tries--)
-      {
-        g_usleep (100000);      /* microseconds */
-        dev_initialized = g_udev_device_get_is_initialized (request->udev_device);
-      }
+  /* let threads waiting for objects re-check */
+  udisks_daemon_notify_objects_changed (udisks_provider_get_daemon (UDISKS_PROVIDER (provider)));
 
-      /* probe the device - this may take a while */
-      request->udisks_device = udisks_linux_device_new_sync (request->udev_device);
+  udisks_debug ("Handled a batch of %u probed uevents, %u left",
+                g_queue_get_length (&handled), g_queue_get_length (&batch));
 
-      /* now that we've probed the device, post the request back to the main thread */
-      g_idle_add (on_idle_with_probed_uevent, request);
+  while ((request = g_queue_pop_head (&handled)) != NULL)
+    {
+      g_signal_emit (provider,
+                     signals[UEVENT_PROBED_SIGNAL],
+                     0,
+                     g_udev_device_get_action (request->udev_device),
+                     request->udisks_device);
+      probe_request_free (request);
     }
-  while (TRUE);
 
- out:
-  return NULL;
+  g_mutex_lock (&provider->probe_lock);
+  /* put back what didn't fit into this batch, ahead of anything probed meanwhile */
+  while ((request = g_queue_pop_tail (&batch)) != NULL)
+    g_queue_push_head (&provider->probed_requests, request);
+  if (g_queue_is_empty (&provider->probed_requests))
+    {
+      provider->probed_idle_id = 0;
+      ret = G_SOURCE_REMOVE;
+    }
+  else
+    {
+      ret = G_SOURCE_CONTINUE;
+    }
+  g_mutex_unlock (&provider->probe_lock);
+
+  g_object_unref (provider);
+
+  return ret;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+/* called in main thread when a parked ProbeDeviceQueue should be probed again */
+static gboolean
+on_probe_init_retry_timeout (gpointer user_data)
+{
+  ProbeDeviceQueue *queue = user_data;
+  UDisksLinuxProvider *provider = queue->provider;
+
+  g_mutex_lock (&provider->probe_lock);
+  g_thread_pool_push (provider->probe_pool, queue, NULL);
+  g_mutex_unlock (&provider->probe_lock);
+
+  return FALSE; /* remove source */
+}
+
+/* runs in a provider->probe_pool worker thread, @data is a ProbeDeviceQueue */
+static void
+probe_request_thread_func (gpointer data,
+                           gpointer user_data)
+{
+  UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
+  ProbeDeviceQueue *queue = data;
+  ProbeRequest *request;
+
+  g_mutex_lock (&provider->probe_lock);
+  request = g_queue_pop_head (&queue->requests);
+  g_mutex_unlock (&provider->probe_lock);
+
+  /* a scheduled or parked queue always has at least one request */
+  g_assert (request != NULL);
+
+  /* Try to wait for the device to become initialized(*) before we start
+   * gathering data for it.
+   *
+   * (*) "Check if udev has already handled the device and has set up device
+   *      node permissions and context, or has renamed a network device.
+   *      This is only implemented for devices with a device node or network
+   *      interfaces. All other devices return 1 here."
+   *        -- UDEV docs
+   *
+   * Rather than sleeping in the worker, park the whole device queue and
+   * re-schedule it from a timeout so that the other devices keep flowing.
+   * The queue stays in provider->probe_device_queues meanwhile, so further
+   * uevents for this device line up behind the parked request.
+   * */
+  if (!g_udev_device_get_is_initialized (request->udev_device) &&
+      request->n_init_retries < PROBE_INIT_MAX_RETRIES)
+    {
+      request->n_init_retries++;
+      g_mutex_lock (&provider->probe_lock);
+      g_queue_push_head (&queue->requests, request);
+      g_timeout_add (PROBE_INIT_RETRY_MSEC, on_probe_init_retry_timeout, queue);
+      g_mutex_unlock (&provider->probe_lock);
+      return;
+    }
+
+  /* probe the device - this may take a while */
+  request->udisks_device = udisks_linux_device_new_sync (request->udev_device);
+
+  g_mutex_lock (&provider->probe_lock);
+
+  /* now that we've probed the device, post the request back to the main thread */
+  g_queue_push_tail (&provider->probed_requests, request);
+  if (provider->probed_idle_id == 0)
+    provider->probed_idle_id = g_idle_add (on_idle_with_probed_uevents, provider);
+
+  /* Either hand the next request for this device over to another worker or
+   * retire the queue. Re-scheduling rather than looping here keeps a device
+   * with a uevent storm from monopolizing a worker.
+   */
+  if (g_queue_is_empty (&queue->requests))
+    g_hash_table_remove (provider->probe_device_queues, queue->sysfs_path);
+  else
+    g_thread_pool_push (provider->probe_pool, queue, NULL);
+  g_mutex_unlock (&provider->probe_lock);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -311,13 +485,58 @@ on_uevent (GUdevClient  *client,
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
   ProbeRequest *request;
+  ProbeDeviceQueue *queue;
+  const gchar *sysfs_path;
 
   request = g_slice_new0 (ProbeRequest);
   request->provider = g_object_ref (provider);
   request->udev_device = g_object_ref (device);
 
-  /* process uevent in "probing-thread" */
-  g_async_queue_push (provider->probe_request_queue, request);
+  sysfs_path = g_udev_device_get_sysfs_path (device);
+
+  /* process uevent in a "probing-thread", after any pending uevent for the same device */
+  g_mutex_lock (&provider->probe_lock);
+  provider->n_uevents_received++;
+  queue = g_hash_table_lookup (provider->probe_device_queues, sysfs_path);
+  if (queue != NULL)
+    {
+      ProbeRequest *last;
+
+      /* A "change" uevent right after another "change" uevent that hasn't been
+       * probed yet carries the very same information, only more recent. Replace
+       * the device of the pending request instead of probing twice. The request
+       * currently being probed isn't in the queue so it's never touched. Other
+       * actions are never merged as they affect object lifecycle, neither are
+       * tagged synthetic uevents someone may be waiting for, see
+       * udisks_linux_block_object_trigger_uevent_sync().
+       */
+      last = g_queue_peek_tail (&queue->requests);
+      if (last != NULL &&
+          g_strcmp0 (action, "change") == 0 &&
+          g_strcmp0 (g_udev_device_get_action (last->udev_device), "change") == 0 &&
+          g_udev_device_get_property (last->udev_device, "SYNTH_ARG_UDISKSSERIAL") == NULL)
+        {
+          g_object_unref (last->udev_device);
+          last->udev_device = g_object_ref (device);
+          probe_request_free (request);
+          provider->n_uevents_merged++;
+        }
+      else
+        {
+          g_queue_push_tail (&queue->requests, request);
+        }
+    }
+  else
+    {
+      queue = g_slice_new0 (ProbeDeviceQueue);
+      queue->provider = provider;
+      queue->sysfs_path = g_strdup (sysfs_path);
+      g_queue_init (&queue->requests);
+      g_queue_push_tail (&queue->requests, request);
+      g_hash_table_insert (provider->probe_device_queues, queue->sysfs_path, queue);
+      g_thread_pool_push (provider->probe_pool, queue, NULL);
+    }
+  g_mutex_unlock (&provider->probe_lock);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -348,12 +567,19 @@ udisks_linux_provider_constructed (GObject *object)
                     G_CALLBACK (on_uevent),
                     provider);
 
-  provider->probe_request_queue = g_async_queue_new ();
-  provider->probe_request_thread = g_thread_new ("probing-thread",
-                                                 probe_request_thread_func,
-                                                 provider);
-
-  provider->mount_monitor = g_unix_mount_monitor_get ();
+  g_mutex_init (&provider->probe_lock);
+  g_queue_init (&provider->probed_requests);
+  provider->probe_device_queues = g_hash_table_new_full (g_str_hash,
+                                                         g_str_equal,
+                                                         NULL,
+                                                         probe_device_queue_free);
+  provider->probe_pool = g_thread_pool_new (probe_request_thread_func,
+                                            provider,
+                                            udisks_config_manager_get_probe_workers (config_manager),
+                                            FALSE,
+                                            NULL);
+  udisks_debug ("Probing uevents with up to %u threads",
+                udisks_config_manager_get_probe_workers (config_manager));
 
   provider->module_ifaces = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
 
@@ -477,30 +703,224 @@ udev_device_name_cmp (GUdevDevice *a,
   return device_name_cmp (g_udev_device_get_name (a), g_udev_device_get_name (b));
 }
 
+/* ---------------------------------------------------------------------------------------------------- */
+
+typedef struct
+{
+  GUdevDevice       *udev_device;
+  UDisksLinuxDevice *udisks_device;
+} ColdplugProbe;
+
+/* runs in a coldplug probing thread, see get_udisks_devices() */
+static void
+coldplug_probe_thread_func (gpointer data,
+                            gpointer user_data)
+{
+  ColdplugProbe *probe = data;
+
+  probe->udisks_device = udisks_linux_device_new_sync (probe->udev_device);
+}
+
+typedef struct _ColdplugNode ColdplugNode;
+
+struct _ColdplugNode
+{
+  UDisksLinuxDevice *device;
+  guint              index;           /* position in name-sorted order */
+  GPtrArray         *deps;            /* of ColdplugNode, devices this one is stacked on */
+  gboolean           has_dependents;
+  gint               level;           /* -1 if not yet computed, -2 while being computed */
+};
+
+static gint
+coldplug_node_get_level (ColdplugNode *node)
+{
+  guint n;
+  gint level = 0;
+
+  if (node->level >= 0)
+    return node->level;
+
+  if (node->level == -2)
+    {
+      /* should never happen, but don't loop forever on a bogus sysfs */
+      udisks_warning ("Dependency cycle detected at %s",
+                      g_udev_device_get_sysfs_path (node->device->udev_device));
+      return 0;
+    }
+
+  node->level = -2;
+  for (n = 0; n < node->deps->len; n++)
+    level = MAX (level, coldplug_node_get_level (node->deps->pdata[n]) + 1);
+  node->level = level;
+
+  return level;
+}
+
+static gint
+coldplug_node_cmp (gconstpointer a,
+                   gconstpointer b)
+{
+  const ColdplugNode *na = *((const ColdplugNode **) a);
+  const ColdplugNode *nb = *((const ColdplugNode **) b);
+
+  if (na->level != nb->level)
+    return na->level - nb->level;
+  return (gint) na->index - (gint) nb->index;
+}
+
+static void
+coldplug_node_add_dep (ColdplugNode *node,
+                       ColdplugNode *dep)
+{
+  if (dep == NULL || dep == node)
+    return;
+  g_ptr_array_add (node->deps, dep);
+  dep->has_dependents = TRUE;
+}
+
+/* Sorts @udisks_devices so that every device comes after all the devices it's
+ * stacked on (disk -> partition -> dm/md -> LUKS/LVM ...) as described by the
+ * partition parent and the holders/slaves relations in sysfs. Devices on the
+ * same level keep their relative order.
+ *
+ * Takes ownership of @udisks_devices. If @out_with_dependents is not %NULL, it
+ * is set to the (sorted) list of devices that other devices are stacked on -
+ * these may need another round once everything else has been added as some of
+ * their properties (e.g. PartitionTable:Partitions) point up the stack.
+ */
+static GList *
+sort_udisks_devices_by_dependencies (GList  *udisks_devices,
+                                     GList **out_with_dependents)
+{
+  GHashTable *name_to_node;
+  GPtrArray *nodes;
+  ColdplugNode *node;
+  GList *ret = NULL;
+  GList *l;
+  guint n;
+
+  name_to_node = g_hash_table_new (g_str_hash, g_str_equal);
+  nodes = g_ptr_array_new ();
+
+  for (l = udisks_devices, n = 0; l != NULL; l = l->next, n++)
+    {
+      node = g_slice_new0 (ColdplugNode);
+      node->device = l->data;
+      node->index = n;
+      node->deps = g_ptr_array_new ();
+      node->level = -1;
+      g_ptr_array_add (nodes, node);
+      g_hash_table_insert (name_to_node, (gpointer) g_udev_device_get_name (node->device->udev_device), node);
+    }
+  g_list_free (udisks_devices);
+
+  for (n = 0; n < nodes->len; n++)
+    {
+      GUdevDevice *udev_device;
+      const gchar *sysfs_path;
+      gchar *slaves_path;
+      GDir *dir;
+
+      node = nodes->pdata[n];
+      udev_device = node->device->udev_device;
+      sysfs_path = g_udev_device_get_sysfs_path (udev_device);
+
+      /* a partition depends on its disk - the parent directory in sysfs */
+      if (g_strcmp0 (g_udev_device_get_devtype (udev_device), "partition") == 0)
+        {
+          gchar *disk_path = g_path_get_dirname (sysfs_path);
+          gchar *disk_name = g_path_get_basename (disk_path);
+          coldplug_node_add_dep (node, g_hash_table_lookup (name_to_node, disk_name));
+          g_free (disk_name);
+          g_free (disk_path);
+        }
+
+      /* stacked devices (dm, md, ...) depend on their slaves */
+      slaves_path = g_build_filename (sysfs_path, "slaves", NULL);
+      dir = g_dir_open (slaves_path, 0, NULL);
+      if (dir != NULL)
+        {
+          const gchar *name;
+          while ((name = g_dir_read_name (dir)) != NULL)
+            coldplug_node_add_dep (node, g_hash_table_lookup (name_to_node, name));
+          g_dir_close (dir);
+        }
+      g_free (slaves_path);
+    }
+
+  for (n = 0; n < nodes->len; n++)
+    coldplug_node_get_level (nodes->pdata[n]);
+  g_ptr_array_sort (nodes, coldplug_node_cmp);
+
+  if (out_with_dependents != NULL)
+    *out_with_dependents = NULL;
+  for (n = nodes->len; n > 0; n--)
+    {
+      node = nodes->pdata[n - 1];
+      if (out_with_dependents != NULL && node->has_dependents)
+        *out_with_dependents = g_list_prepend (*out_with_dependents, g_object_ref (node->device));
+      ret = g_list_prepend (ret, node->device);
+      g_ptr_array_unref (node->deps);
+      g_slice_free (ColdplugNode, node);
+    }
+
+  g_ptr_array_unref (nodes);
+  g_hash_table_unref (name_to_node);
+
+  return ret;
+}
+
+/* Probes all block devices in parallel and returns them in the order they
+ * should be coldplugged in, see sort_udisks_devices_by_dependencies().
+ */
 static GList *
-get_udisks_devices (UDisksLinuxProvider *provider)
+get_udisks_devices (UDisksLinuxProvider  *provider,
+                    GList               **out_with_dependents)
 {
+  UDisksDaemon *daemon;
+  GThreadPool *pool;
+  ColdplugProbe *probes;
   GList *devices;
   GList *udisks_devices;
   GList *l;
+  guint n_probes;
+  guint n;
+
+  daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
 
   devices = g_udev_client_query_by_subsystem (provider->gudev_client, "block");
 
   /* make sure we process sda before sdz and sdz before sdaa */
   devices = g_list_sort (devices, (GCompareFunc) udev_device_name_cmp);
 
-  udisks_devices = NULL;
+  /* probing may take a while for each device - do it in parallel */
+  probes = g_new0 (ColdplugProbe, g_list_length (devices));
+  pool = g_thread_pool_new (coldplug_probe_thread_func,
+                            NULL,
+                            udisks_config_manager_get_probe_workers (udisks_daemon_get_config_manager (daemon)),
+                            FALSE,
+                            NULL);
+  n_probes = 0;
   for (l = devices; l != NULL; l = l->next)
     {
       GUdevDevice *device = G_UDEV_DEVICE (l->data);
       if (!g_udev_device_get_is_initialized (device))
         continue;
-      udisks_devices = g_list_prepend (udisks_devices, udisks_linux_device_new_sync (device));
+      probes[n_probes].udev_device = device;
+      g_thread_pool_push (pool, &probes[n_probes], NULL);
+      n_probes++;
     }
-  udisks_devices = g_list_reverse (udisks_devices);
+  /* wait for all the probes to finish */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  udisks_devices = NULL;
+  for (n = n_probes; n > 0; n--)
+    udisks_devices = g_list_prepend (udisks_devices, probes[n - 1].udisks_device);
+  g_free (probes);
   g_list_free_full (devices, g_object_unref);
 
-  return udisks_devices;
+  return sort_udisks_devices_by_dependencies (udisks_devices, out_with_dependents);
 }
 
 static void
@@ -577,7 +997,7 @@ ensure_modules (UDisksLinuxProvider *provider)
 
   /* Perform coldplug */
   udisks_debug ("Performing coldplug...");
-  udisks_devices = get_udisks_devices (provider);
+  udisks_devices = get_udisks_devices (provider, NULL);
   do_coldplug (provider, udisks_devices);
   g_list_free_full (udisks_devices, g_object_unref);
   udisks_debug ("Coldplug complete");
@@ -657,7 +1077,8 @@ udisks_linux_provider_start (UDisksProvider *_provider)
   UDisksManager *manager;
   UDisksModuleManager *module_manager;
   GList *udisks_devices;
-  guint n;
+  GList *udisks_devices_with_dependents;
+  gint64 phase_start;
   GDBusConnection *dbus_conn;
 
   provider->coldplug = TRUE;
@@ -709,15 +1130,30 @@ udisks_linux_provider_start (UDisksProvider *_provider)
 
   /* probe for extra data we don't get from udev */
   udisks_info ("Initialization (device probing)");
-  udisks_devices = get_udisks_devices (provider);
+  phase_start = g_get_monotonic_time ();
+  udisks_devices = get_udisks_devices (provider, &udisks_devices_with_dependents);
+  udisks_info ("Initialization (device probing) took %" G_GINT64_FORMAT " ms for %u devices",
+               (g_get_monotonic_time () - phase_start) / 1000, g_list_length (udisks_devices));
+
+  /* devices are sorted so that each one comes after all the devices it's stacked on */
+  udisks_info ("Initialization (coldplug)");
+  phase_start = g_get_monotonic_time ();
+  do_coldplug (provider, udisks_devices);
+  udisks_info ("Initialization (coldplug) took %" G_GINT64_FORMAT " ms",
+               (g_get_monotonic_time () - phase_start) / 1000);
+
+  /* revisit the devices with something stacked on top as some of their
+   * properties refer to objects that didn't exist during the first pass
+   */
+  udisks_info ("Initialization (coldplug of %u devices with dependents)",
+               g_list_length (udisks_devices_with_dependents));
+  phase_start = g_get_monotonic_time ();
+  do_coldplug (provider, udisks_devices_with_dependents);
+  udisks_info ("Initialization (coldplug of devices with dependents) took %" G_GINT64_FORMAT " ms",
+               (g_get_monotonic_time () - phase_start) / 1000);
 
-  /* do two coldplug runs to handle dependencies between devices */
-  for (n = 0; n < 2; n++)
-    {
-      udisks_info ("Initialization (coldplug %u/2)", n + 1);
-      do_coldplug (provider, udisks_devices);
-    }
   g_list_free_full (udisks_devices, g_object_unref);
+  g_list_free_full (udisks_devices_with_dependents, g_object_unref);
   udisks_info ("Initialization complete");
 
   /* schedule housekeeping for every 10 minutes */
@@ -730,9 +1166,13 @@ udisks_linux_provider_start (UDisksProvider *_provider)
   provider->coldplug = FALSE;
 
   /* update Block:Configuration whenever fstab or crypttab entries are added or removed */
-  g_signal_connect (provider->mount_monitor,
-                    "mountpoints-changed",
-                    G_CALLBACK (mount_monitor_on_mountpoints_changed),
+  g_signal_connect (udisks_daemon_get_fstab_monitor (daemon),
+                    "entry-added",
+                    G_CALLBACK (fstab_monitor_on_entry_added),
+                    provider);
+  g_signal_connect (udisks_daemon_get_fstab_monitor (daemon),
+                    "entry-removed",
+                    G_CALLBACK (fstab_monitor_on_entry_removed),
                     provider);
   g_signal_connect (udisks_daemon_get_crypttab_monitor (daemon),
                     "entry-added",
@@ -836,6 +1276,32 @@ udisks_linux_provider_get_udev_client (UDisksLinuxProvider *provider)
 }
 
 
+/**
+ * udisks_linux_provider_get_uevent_stats:
+ * @provider: A #UDisksLinuxProvider.
+ * @out_received: (out) (allow-none): Return location for the number of uevents received or %NULL.
+ * @out_merged: (out) (allow-none): Return location for the number of uevents merged into a pending request or %NULL.
+ *
+ * Gets uevent processing statistics of @provider. Consecutive "change" uevents
+ * for a device that haven't been probed yet are merged into a single request.
+ *
+ * This function is thread-safe.
+ */
+void
+udisks_linux_provider_get_uevent_stats (UDisksLinuxProvider *provider,
+                                        guint64             *out_received,
+                                        guint64             *out_merged)
+{
+  g_return_if_fail (UDISKS_IS_LINUX_PROVIDER (provider));
+
+  g_mutex_lock (&provider->probe_lock);
+  if (out_received != NULL)
+    *out_received = provider->n_uevents_received;
+  if (out_merged != NULL)
+    *out_merged = provider->n_uevents_merged;
+  g_mutex_unlock (&provider->probe_lock);
+}
+
 /**
  * udisks_linux_provider_get_coldplug:
  * @provider: A #UDisksLinuxProvider.
@@ -1148,6 +1614,57 @@ out:
   g_free (backing_path);
 }
 
+/* called with lock held
+ *
+ * Uevents for different devices are probed concurrently, so on hotplug the
+ * "add" uevent for a partition or a holder (e.g. a dm device) may have been
+ * handled before the "add" uevent for the device it sits on. Have block objects
+ * already exported for such children of @sysfs_path look up their parent again.
+ */
+static void
+update_block_objects_on_parent (UDisksLinuxProvider *provider,
+                                const gchar         *sysfs_path)
+{
+  GHashTableIter iter;
+  const gchar *child_sysfs_path;
+  UDisksLinuxBlockObject *object;
+  gchar *holders_path;
+  GDir *dir;
+  const gchar *name;
+  gsize len;
+
+  /* partitions live in a subdirectory of the whole disk */
+  len = strlen (sysfs_path);
+  g_hash_table_iter_init (&iter, provider->sysfs_to_block);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &child_sysfs_path, (gpointer *) &object))
+    {
+      if (strncmp (child_sysfs_path, sysfs_path, len) == 0 && child_sysfs_path[len] == '/')
+        udisks_linux_block_object_uevent (object, "change", NULL);
+    }
+
+  /* devices built on top of this one are listed in holders/ */
+  holders_path = g_build_filename (sysfs_path, "holders", NULL);
+  dir = g_dir_open (holders_path, 0, NULL);
+  if (dir != NULL)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          gchar *holder_sysfs_path;
+
+          holder_sysfs_path = udisks_daemon_util_resolve_link (holders_path, name);
+          if (holder_sysfs_path != NULL)
+            {
+              object = g_hash_table_lookup (provider->sysfs_to_block, holder_sysfs_path);
+              if (object != NULL)
+                udisks_linux_block_object_uevent (object, "change", NULL);
+            }
+          g_free (holder_sysfs_path);
+        }
+      g_dir_close (dir);
+    }
+  g_free (holders_path);
+}
+
 /* called with lock held */
 static void
 handle_block_uevent_for_block (UDisksLinuxProvider *provider,
@@ -1192,6 +1709,9 @@ handle_block_uevent_for_block (UDisksLinuxProvider *provider,
           g_dbus_object_manager_server_export_uniquely (udisks_daemon_get_object_manager (daemon),
                                                         G_DBUS_OBJECT_SKELETON (object));
           g_hash_table_insert (provider->sysfs_to_block, g_strdup (sysfs_path), object);
+          /* coldplug already adds parents before their children */
+          if (!provider->coldplug && g_strcmp0 (action, "add") == 0)
+            update_block_objects_on_parent (provider, sysfs_path);
         }
     }
 }
@@ -1362,12 +1882,33 @@ handle_block_uevent (UDisksLinuxProvider *provider,
           handle_block_uevent_for_block (provider, action, device);
         }
     }
+}
 
-  if (g_strcmp0 (action, "add") != 0)
+/* called with lock held
+ *
+ * Returns %TRUE if the uevent may have left stale entries in the state
+ * files referring to @device, i.e. the caller should call
+ * udisks_state_check_devices() for it.
+ */
+static gboolean
+handle_uevent (UDisksLinuxProvider *provider,
+               const gchar         *action,
+               UDisksLinuxDevice   *device)
+{
+  const gchar *subsystem;
+
+  udisks_debug ("uevent %s %s",
+                action,
+                g_udev_device_get_sysfs_path (device->udev_device));
+
+  subsystem = g_udev_device_get_subsystem (device->udev_device);
+  if (g_strcmp0 (subsystem, "block") == 0)
     {
-      /* Possibly need to clean up */
-      udisks_state_check (udisks_daemon_get_state (udisks_provider_get_daemon (UDISKS_PROVIDER (provider))));
+      handle_block_uevent (provider, action, device);
+      return g_strcmp0 (action, "add") != 0;
     }
+
+  return FALSE;
 }
 
 /* called without lock held */
@@ -1376,21 +1917,20 @@ udisks_linux_provider_handle_uevent (UDisksLinuxProvider *provider,
                                      const gchar         *action,
                                      UDisksLinuxDevice   *device)
 {
-  const gchar *subsystem;
-
   G_LOCK (provider_lock);
 
-  udisks_debug ("uevent %s %s",
-                action,
-                g_udev_device_get_sysfs_path (device->udev_device));
-
-  subsystem = g_udev_device_get_subsystem (device->udev_device);
-  if (g_strcmp0 (subsystem, "block") == 0)
+  if (handle_uevent (provider, action, device))
     {
-      handle_block_uevent (provider, action, device);
+      dev_t dev = g_udev_device_get_device_number (device->udev_device);
+
+      /* Possibly need to clean up */
+      udisks_state_check_devices (udisks_daemon_get_state (udisks_provider_get_daemon (UDISKS_PROVIDER (provider))),
+                                  &dev, 1);
     }
 
   G_UNLOCK (provider_lock);
+
+  udisks_daemon_notify_objects_changed (udisks_provider_get_daemon (UDISKS_PROVIDER (provider)));
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1480,8 +2020,17 @@ housekeeping_thread_func (GTask           *task,
                           GCancellable    *cancellable)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (source_object);
+  UDisksDaemon *daemon;
   guint secs_since_last;
   guint64 now;
+  guint calls_queued;
+  guint calls_running;
+  guint64 calls_dispatched;
+  guint64 calls_rejected;
+  gint64 calls_total_wait_usec;
+  gint64 calls_max_wait_usec;
+
+  daemon = udisks_provider_get_daemon (UDISKS_PROVIDER (provider));
 
   /* TODO: probably want some kind of timeout here to avoid faulty devices/drives blocking forever */
 
@@ -1493,6 +2042,27 @@ housekeeping_thread_func (GTask           *task,
 
   udisks_info ("Housekeeping initiated (%u seconds since last housekeeping)", secs_since_last);
 
+  g_mutex_lock (&provider->probe_lock);
+  udisks_debug ("Uevents received: %" G_GUINT64_FORMAT ", merged while pending: %" G_GUINT64_FORMAT,
+                provider->n_uevents_received, provider->n_uevents_merged);
+  g_mutex_unlock (&provider->probe_lock);
+  udisks_debug ("Mount table reloads avoided: %" G_GUINT64_FORMAT,
+                udisks_mount_monitor_get_reloads_avoided (udisks_daemon_get_mount_monitor (daemon)));
+  if (udisks_authorization_cache_get_enabled (udisks_daemon_get_authorization_cache (daemon)))
+    udisks_debug ("Authorization cache hits: %" G_GUINT64_FORMAT ", misses: %" G_GUINT64_FORMAT,
+                  udisks_authorization_cache_get_hits (udisks_daemon_get_authorization_cache (daemon)),
+                  udisks_authorization_cache_get_misses (udisks_daemon_get_authorization_cache (daemon)));
+  udisks_method_executor_get_stats (udisks_daemon_get_method_executor (daemon),
+                                    &calls_queued, &calls_running,
+                                    &calls_dispatched, &calls_rejected,
+                                    &calls_total_wait_usec, &calls_max_wait_usec);
+  udisks_debug ("Method calls queued: %u, running: %u, handled: %" G_GUINT64_FORMAT
+                ", rejected: %" G_GUINT64_FORMAT ", average wait: %" G_GINT64_FORMAT
+                " usec, longest wait: %" G_GINT64_FORMAT " usec",
+                calls_queued, calls_running, calls_dispatched, calls_rejected,
+                calls_dispatched > 0 ? calls_total_wait_usec / (gint64) calls_dispatched : 0,
+                calls_max_wait_usec);
+
   housekeeping_all_drives (provider, secs_since_last);
   housekeeping_all_modules (provider, secs_since_last);
 
@@ -1525,11 +2095,48 @@ on_housekeeping_timeout (gpointer user_data)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Adds the identifiers of the block devices a configuration entry with the
+ * given @source and @options applies to. Besides the source device this
+ * includes the parent given by a x-parent=UUID option since the entry shows
+ * up in the Encrypted:ChildConfiguration property of that device.
+ */
 static void
-update_all_block_objects (UDisksLinuxProvider *provider)
+add_entry_identifiers (GPtrArray   *ids,
+                       const gchar *source,
+                       const gchar *options)
+{
+  gchar **opts;
+  guint n;
+
+  if (source != NULL && strlen (source) > 0)
+    g_ptr_array_add (ids, g_strdup (source));
+
+  if (options == NULL || strstr (options, "x-parent=") == NULL)
+    return;
+
+  opts = g_strsplit (options, ",", -1);
+  for (n = 0; opts[n] != NULL; n++)
+    {
+      if (g_str_has_prefix (opts[n], "x-parent=") && strlen (opts[n]) > strlen ("x-parent="))
+        g_ptr_array_add (ids, g_strdup_printf ("UUID=%s", opts[n] + strlen ("x-parent=")));
+    }
+  g_strfreev (opts);
+}
+
+/* Sends a synthetic 'change' uevent to all block objects matching any of
+ * the identifiers in @ids - see udisks_linux_block_matches_id().
+ */
+static void
+update_block_objects_matching (UDisksLinuxProvider *provider,
+                               GPtrArray           *ids)
 {
   GList *objects;
   GList *l;
+  guint n;
+  guint num_updated = 0;
+
+  if (ids->len == 0)
+    return;
 
   G_LOCK (provider_lock);
   objects = g_hash_table_get_values (provider->sysfs_to_block);
@@ -1539,18 +2146,75 @@ update_all_block_objects (UDisksLinuxProvider *provider)
   for (l = objects; l != NULL; l = l->next)
     {
       UDisksLinuxBlockObject *object = UDISKS_LINUX_BLOCK_OBJECT (l->data);
-      udisks_linux_block_object_uevent (object, "change", NULL);
+      UDisksBlock *block;
+
+      block = udisks_object_peek_block (UDISKS_OBJECT (object));
+      if (block == NULL)
+        continue;
+
+      for (n = 0; n < ids->len; n++)
+        {
+          if (udisks_linux_block_matches_id (UDISKS_LINUX_BLOCK (block), g_ptr_array_index (ids, n)))
+            {
+              udisks_linux_block_object_uevent (object, "change", NULL);
+              num_updated++;
+              break;
+            }
+        }
     }
 
   g_list_free_full (objects, g_object_unref);
+
+  udisks_debug ("Configuration change for %u identifiers updated %u block objects", ids->len, num_updated);
+
+  if (num_updated > 0)
+    udisks_daemon_notify_objects_changed (udisks_provider_get_daemon (UDISKS_PROVIDER (provider)));
+}
+
+static void
+update_for_fstab_entry (UDisksLinuxProvider *provider,
+                        UDisksFstabEntry    *entry)
+{
+  GPtrArray *ids;
+
+  ids = g_ptr_array_new_with_free_func (g_free);
+  add_entry_identifiers (ids,
+                         udisks_fstab_entry_get_fsname (entry),
+                         udisks_fstab_entry_get_opts (entry));
+  update_block_objects_matching (provider, ids);
+  g_ptr_array_free (ids, TRUE);
 }
 
 static void
-mount_monitor_on_mountpoints_changed (GUnixMountMonitor *monitor,
-                                      gpointer           user_data)
+fstab_monitor_on_entry_added (UDisksFstabMonitor *monitor,
+                              UDisksFstabEntry   *entry,
+                              gpointer            user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
-  update_all_block_objects (provider);
+  update_for_fstab_entry (provider, entry);
+}
+
+static void
+fstab_monitor_on_entry_removed (UDisksFstabMonitor *monitor,
+                                UDisksFstabEntry   *entry,
+                                gpointer            user_data)
+{
+  UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
+  update_for_fstab_entry (provider, entry);
+}
+
+static void
+update_for_crypttab_entry (UDisksLinuxProvider *provider,
+                           UDisksCrypttabEntry *entry)
+{
+  GPtrArray *ids;
+
+  ids = g_ptr_array_new_with_free_func (g_free);
+  add_entry_identifiers (ids,
+                         udisks_crypttab_entry_get_device (entry),
+                         udisks_crypttab_entry_get_options (entry));
+  update_block_objects_matching (provider, ids);
+  g_ptr_array_free (ids, TRUE);
 }
 
 static void
@@ -1559,7 +2223,7 @@ crypttab_monitor_on_entry_added (UDisksCrypttabMonitor *monitor,
                                  gpointer               user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
-  update_all_block_objects (provider);
+  update_for_crypttab_entry (provider, entry);
 }
 
 static void
@@ -1568,17 +2232,29 @@ crypttab_monitor_on_entry_removed (UDisksCrypttabMonitor *monitor,
                                    gpointer               user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
-  update_all_block_objects (provider);
+  update_for_crypttab_entry (provider, entry);
 }
 
 #ifdef HAVE_LIBMOUNT_UTAB
+static void
+update_for_utab_entry (UDisksLinuxProvider *provider,
+                       UDisksUtabEntry     *entry)
+{
+  GPtrArray *ids;
+
+  ids = g_ptr_array_new_with_free_func (g_free);
+  add_entry_identifiers (ids, udisks_utab_entry_get_source (entry), NULL);
+  update_block_objects_matching (provider, ids);
+  g_ptr_array_free (ids, TRUE);
+}
+
 static void
 utab_monitor_on_entry_added (UDisksUtabMonitor *monitor,
                              UDisksUtabEntry   *entry,
                              gpointer           user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
-  update_all_block_objects (provider);
+  update_for_utab_entry (provider, entry);
 }
 
 static void
@@ -1587,6 +2263,6 @@ utab_monitor_on_entry_removed (UDisksUtabMonitor *monitor,
                                gpointer           user_data)
 {
   UDisksLinuxProvider *provider = UDISKS_LINUX_PROVIDER (user_data);
-  update_all_block_objects (provider);
+  update_for_utab_entry (provider, entry);
 }
 #endif
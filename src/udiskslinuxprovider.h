@@ -34,6 +34,9 @@ GType                  udisks_linux_provider_get_type        (void) G_GNUC_CONST
 UDisksLinuxProvider   *udisks_linux_provider_new             (UDisksDaemon        *daemon);
 GUdevClient           *udisks_linux_provider_get_udev_client (UDisksLinuxProvider *provider);
 gboolean               udisks_linux_provider_get_coldplug    (UDisksLinuxProvider *provider);
+void                   udisks_linux_provider_get_uevent_stats (UDisksLinuxProvider *provider,
+                                                               guint64             *out_received,
+                                                               guint64             *out_merged);
 
 G_END_DECLS
 
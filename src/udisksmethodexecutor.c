@@ -0,0 +1,582 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2026 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include "config.h"
+#include <glib/gi18n-lib.h>
+
+#include "udisksmethodexecutor.h"
+#include "udisksdaemon.h"
+#include "udisksconfigmanager.h"
+#include "udiskslogging.h"
+
+/**
+ * SECTION:udisksmethodexecutor
+ * @title: UDisksMethodExecutor
+ * @short_description: Runs D-Bus method calls on a bounded set of threads
+ *
+ * Interface skeletons are created with the
+ * %G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD
+ * flag, which makes GDBus run every method call in a thread of its
+ * own. Once attached with udisks_method_executor_attach(), method calls
+ * on an interface are instead queued, in the order they arrive, to a
+ * pool of at most <option>method_workers</option> threads (see
+ * <filename>udisks2.conf</filename>). Calls on the
+ * <link linkend="gdbus-interface-org-freedesktop-UDisks2-Manager.top_of_page">org.freedesktop.UDisks2.Manager</link>
+ * interfaces are cheap queries or need to be answered right away and
+ * keep running in threads of their own.
+ *
+ * At most <option>method_queue_size</option> calls wait for a thread,
+ * further calls fail right away with the
+ * %G_DBUS_ERROR_LIMITS_EXCEEDED error. Calls on interfaces whose
+ * handlers are serialized anyway (e.g. the
+ * <link linkend="gdbus-interface-org-freedesktop-UDisks2-Filesystem.top_of_page">org.freedesktop.UDisks2.Filesystem</link>
+ * interface) are run one after another for each object, so they don't
+ * occupy threads waiting for each other.
+ *
+ * A handler that blocks for a long time, typically waiting for a job,
+ * should do so between udisks_method_executor_begin_blocking() and
+ * udisks_method_executor_end_blocking() so that it doesn't keep the
+ * other calls from being handled.
+ */
+
+/* interfaces whose handlers can't run concurrently on the same object */
+static const gchar *serialized_interfaces[] =
+{
+  "org.freedesktop.UDisks2.Filesystem",
+  NULL
+};
+
+/* prefix of the interfaces that are never attached */
+#define MANAGER_INTERFACE_PREFIX "org.freedesktop.UDisks2.Manager"
+
+/* the executor a pool thread runs calls for, NULL for other threads */
+static __thread UDisksMethodExecutor *worker_executor = NULL;
+
+/* the call being passed to its method handler by the current thread */
+static __thread GDBusMethodInvocation *dispatching_invocation = NULL;
+
+static __thread guint blocking_depth = 0;
+
+/**
+ * UDisksMethodExecutor:
+ *
+ * The #UDisksMethodExecutor structure contains only private data and
+ * should only be accessed using the provided API.
+ */
+struct _UDisksMethodExecutor
+{
+  GObject parent_instance;
+
+  UDisksDaemon *daemon;
+
+  GThreadPool *pool;
+  guint max_workers;
+  guint max_queued;
+
+  GMutex lock;
+  GHashTable *serialized;       /* object path -> GQueue of PendingCall waiting for the running call */
+  guint queued;                 /* calls waiting for a thread */
+  guint running;
+  guint blocking;               /* running calls not counted against max_workers */
+  gboolean rejecting;           /* whether calls are being rejected */
+
+  /* instrumentation */
+  guint64 dispatched;
+  guint64 rejected;
+  gint64 total_wait_usec;
+  gint64 max_wait_usec;
+};
+
+typedef struct _UDisksMethodExecutorClass UDisksMethodExecutorClass;
+
+struct _UDisksMethodExecutorClass
+{
+  GObjectClass parent_class;
+};
+
+typedef struct
+{
+  GDBusInterfaceSkeleton *interface;
+  GDBusMethodInvocation *invocation;
+  gchar *serialize_key;               /* NULL unless serialized */
+  gint64 queued_time;
+} PendingCall;
+
+enum
+{
+  PROP_0,
+  PROP_DAEMON
+};
+
+G_DEFINE_TYPE (UDisksMethodExecutor, udisks_method_executor, G_TYPE_OBJECT);
+
+static void run_call (gpointer data,
+                      gpointer user_data);
+
+static void
+pending_call_free (PendingCall *call)
+{
+  g_object_unref (call->interface);
+  g_object_unref (call->invocation);
+  g_free (call->serialize_key);
+  g_free (call);
+}
+
+static void
+udisks_method_executor_finalize (GObject *object)
+{
+  UDisksMethodExecutor *executor = UDISKS_METHOD_EXECUTOR (object);
+
+  if (executor->pool != NULL)
+    g_thread_pool_free (executor->pool, FALSE, TRUE);
+  g_hash_table_unref (executor->serialized);
+  g_mutex_clear (&executor->lock);
+
+  if (G_OBJECT_CLASS (udisks_method_executor_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (udisks_method_executor_parent_class)->finalize (object);
+}
+
+static void
+udisks_method_executor_get_property (GObject    *object,
+                                     guint       prop_id,
+                                     GValue     *value,
+                                     GParamSpec *pspec)
+{
+  UDisksMethodExecutor *executor = UDISKS_METHOD_EXECUTOR (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_value_set_object (value, executor->daemon);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_method_executor_set_property (GObject      *object,
+                                     guint         prop_id,
+                                     const GValue *value,
+                                     GParamSpec   *pspec)
+{
+  UDisksMethodExecutor *executor = UDISKS_METHOD_EXECUTOR (object);
+
+  switch (prop_id)
+    {
+    case PROP_DAEMON:
+      g_assert (executor->daemon == NULL);
+      /* we don't take a reference to the daemon */
+      executor->daemon = g_value_get_object (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+udisks_method_executor_constructed (GObject *object)
+{
+  UDisksMethodExecutor *executor = UDISKS_METHOD_EXECUTOR (object);
+  UDisksConfigManager *config_manager;
+  GError *error = NULL;
+
+  config_manager = udisks_daemon_get_config_manager (executor->daemon);
+  executor->max_workers = udisks_config_manager_get_method_workers (config_manager);
+  executor->max_queued = udisks_config_manager_get_method_queue_size (config_manager);
+  executor->pool = g_thread_pool_new (run_call,
+                                      executor,
+                                      executor->max_workers,
+                                      FALSE, /* exclusive */
+                                      &error);
+  if (executor->pool == NULL)
+    {
+      /* method calls keep being handled in threads of their own */
+      udisks_critical ("Error creating the method call thread pool: %s (%s, %d)",
+                       error->message, g_quark_to_string (error->domain), error->code);
+      g_clear_error (&error);
+    }
+
+  if (G_OBJECT_CLASS (udisks_method_executor_parent_class)->constructed != NULL)
+    G_OBJECT_CLASS (udisks_method_executor_parent_class)->constructed (object);
+}
+
+static void
+udisks_method_executor_init (UDisksMethodExecutor *executor)
+{
+  g_mutex_init (&executor->lock);
+  executor->serialized = g_hash_table_new_full (g_str_hash,
+                                                g_str_equal,
+                                                g_free,
+                                                (GDestroyNotify) g_queue_free);
+}
+
+static void
+udisks_method_executor_class_init (UDisksMethodExecutorClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize     = udisks_method_executor_finalize;
+  gobject_class->constructed  = udisks_method_executor_constructed;
+  gobject_class->set_property = udisks_method_executor_set_property;
+  gobject_class->get_property = udisks_method_executor_get_property;
+
+  /**
+   * UDisksMethodExecutor:daemon:
+   *
+   * The #UDisksDaemon the executor is for.
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_DAEMON,
+                                   g_param_spec_object ("daemon",
+                                                        "Daemon",
+                                                        "The daemon the executor is for",
+                                                        UDISKS_TYPE_DAEMON,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * udisks_method_executor_new:
+ * @daemon: A #UDisksDaemon.
+ *
+ * Creates a new #UDisksMethodExecutor object.
+ *
+ * Returns: A #UDisksMethodExecutor that should be freed with g_object_unref().
+ */
+UDisksMethodExecutor *
+udisks_method_executor_new (UDisksDaemon *daemon)
+{
+  return UDISKS_METHOD_EXECUTOR (g_object_new (UDISKS_TYPE_METHOD_EXECUTOR,
+                                               "daemon", daemon,
+                                               NULL));
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+run_call (gpointer data,
+          gpointer user_data)
+{
+  UDisksMethodExecutor *executor = UDISKS_METHOD_EXECUTOR (user_data);
+  PendingCall *call = data;
+  GDBusMethodInvocation *invocation = call->invocation;
+  const GDBusInterfaceVTable *vtable;
+  PendingCall *next = NULL;
+  gint64 wait_usec;
+
+  wait_usec = g_get_monotonic_time () - call->queued_time;
+
+  g_mutex_lock (&executor->lock);
+  executor->queued--;
+  executor->running++;
+  executor->dispatched++;
+  executor->total_wait_usec += wait_usec;
+  executor->max_wait_usec = MAX (executor->max_wait_usec, wait_usec);
+  if (executor->rejecting && executor->queued < executor->max_queued / 2)
+    {
+      udisks_notice ("Accepting method calls again, %u waiting", executor->queued);
+      executor->rejecting = FALSE;
+    }
+  g_mutex_unlock (&executor->lock);
+
+  if (wait_usec > G_USEC_PER_SEC)
+    udisks_debug ("%s.%s() on %s waited %" G_GINT64_FORMAT " ms to be handled",
+                  g_dbus_method_invocation_get_interface_name (invocation),
+                  g_dbus_method_invocation_get_method_name (invocation),
+                  g_dbus_method_invocation_get_object_path (invocation),
+                  wait_usec / 1000);
+
+  /* emits the handle-* signal again, this time for the method handler */
+  worker_executor = executor;
+  dispatching_invocation = invocation;
+  vtable = g_dbus_interface_skeleton_get_vtable (call->interface);
+  vtable->method_call (g_dbus_method_invocation_get_connection (invocation),
+                       g_dbus_method_invocation_get_sender (invocation),
+                       g_dbus_method_invocation_get_object_path (invocation),
+                       g_dbus_method_invocation_get_interface_name (invocation),
+                       g_dbus_method_invocation_get_method_name (invocation),
+                       g_dbus_method_invocation_get_parameters (invocation),
+                       invocation,
+                       call->interface);
+  dispatching_invocation = NULL;
+
+  g_mutex_lock (&executor->lock);
+  executor->running--;
+  if (call->serialize_key != NULL)
+    {
+      GQueue *waiting;
+
+      waiting = g_hash_table_lookup (executor->serialized, call->serialize_key);
+      next = g_queue_pop_head (waiting);
+      if (next == NULL)
+        g_hash_table_remove (executor->serialized, call->serialize_key);
+    }
+  g_mutex_unlock (&executor->lock);
+
+  if (next != NULL)
+    g_thread_pool_push (executor->pool, next, NULL);
+
+  pending_call_free (call);
+}
+
+/* Called in the thread the interface is exported in, in the order the calls arrive. */
+static gboolean
+enqueue_call (UDisksMethodExecutor   *executor,
+              GDBusInterfaceSkeleton *interface_,
+              GDBusMethodInvocation  *invocation)
+{
+  PendingCall *call;
+
+  g_mutex_lock (&executor->lock);
+  if (executor->queued >= executor->max_queued)
+    {
+      executor->rejected++;
+      if (!executor->rejecting)
+        {
+          udisks_warning ("Too many method calls waiting (%u running), rejecting further calls",
+                          executor->running);
+          executor->rejecting = TRUE;
+        }
+      g_mutex_unlock (&executor->lock);
+
+      g_dbus_method_invocation_return_error (invocation,
+                                             G_DBUS_ERROR,
+                                             G_DBUS_ERROR_LIMITS_EXCEEDED,
+                                             "Too many method calls are waiting to be handled, try again later");
+      return TRUE;
+    }
+
+  call = g_new0 (PendingCall, 1);
+  call->interface = g_object_ref (interface_);
+  call->invocation = g_object_ref (invocation);
+  call->queued_time = g_get_monotonic_time ();
+  if (g_strv_contains (serialized_interfaces, g_dbus_method_invocation_get_interface_name (invocation)))
+    call->serialize_key = g_strdup (g_dbus_method_invocation_get_object_path (invocation));
+
+  executor->queued++;
+  if (call->serialize_key != NULL)
+    {
+      GQueue *waiting;
+
+      waiting = g_hash_table_lookup (executor->serialized, call->serialize_key);
+      if (waiting != NULL)
+        {
+          /* started by run_call() once the running call on the object returns */
+          g_queue_push_tail (waiting, call);
+          g_mutex_unlock (&executor->lock);
+          return TRUE;
+        }
+      g_hash_table_insert (executor->serialized, g_strdup (call->serialize_key), g_queue_new ());
+    }
+  g_mutex_unlock (&executor->lock);
+
+  g_thread_pool_push (executor->pool, call, NULL);
+  return TRUE;
+}
+
+/* Marshaller for the closure connected to the handle-* signals of attached
+ * interfaces, all of them have the interface and the #GDBusMethodInvocation
+ * as their first two parameters. Returning %TRUE stops the emission before
+ * it reaches the method handler.
+ */
+static void
+on_handle_method (GClosure     *closure,
+                  GValue       *return_value,
+                  guint         n_param_values,
+                  const GValue *param_values,
+                  gpointer      invocation_hint,
+                  gpointer      marshal_data)
+{
+  UDisksMethodExecutor *executor = UDISKS_METHOD_EXECUTOR (closure->data);
+  GDBusMethodInvocation *invocation;
+  gboolean handled = FALSE;
+
+  invocation = g_value_get_object (&param_values[1]);
+  if (invocation != dispatching_invocation)
+    handled = enqueue_call (executor, g_value_get_object (&param_values[0]), invocation);
+
+  g_value_set_boolean (return_value, handled);
+}
+
+/**
+ * udisks_method_executor_attach:
+ * @executor: A #UDisksMethodExecutor.
+ * @interface_: A #GDBusInterfaceSkeleton.
+ *
+ * Makes @executor handle the method calls on @interface_ if it was
+ * created with the
+ * %G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD
+ * flag and isn't one of the Manager interfaces. Other interfaces keep
+ * handling method calls as before. Attaching an interface more than
+ * once is harmless.
+ */
+void
+udisks_method_executor_attach (UDisksMethodExecutor   *executor,
+                               GDBusInterfaceSkeleton *interface_)
+{
+  GDBusInterfaceSkeletonFlags flags;
+  GType *ifaces;
+  guint n_ifaces;
+  guint n;
+
+  g_return_if_fail (UDISKS_IS_METHOD_EXECUTOR (executor));
+  g_return_if_fail (G_IS_DBUS_INTERFACE_SKELETON (interface_));
+
+  if (executor->pool == NULL)
+    return;
+
+  if (g_str_has_prefix (g_dbus_interface_skeleton_get_info (interface_)->name, MANAGER_INTERFACE_PREFIX))
+    return;
+
+  /* the flag is cleared once attached */
+  flags = g_dbus_interface_skeleton_get_flags (interface_);
+  if (!(flags & G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD))
+    return;
+
+  /* Without the flag (and without g-authorize-method handlers, which GDBus
+   * runs in threads of its own) the handle-* signals are emitted in the
+   * thread the interface is exported in, in the order the calls arrive.
+   * Connecting to them lets us queue the calls in that order.
+   */
+  ifaces = g_type_interfaces (G_TYPE_FROM_INSTANCE (interface_), &n_ifaces);
+  for (n = 0; n < n_ifaces; n++)
+    {
+      guint *signal_ids;
+      guint n_signal_ids;
+      guint m;
+
+      signal_ids = g_signal_list_ids (ifaces[n], &n_signal_ids);
+      for (m = 0; m < n_signal_ids; m++)
+        {
+          GSignalQuery query;
+          GClosure *closure;
+
+          g_signal_query (signal_ids[m], &query);
+          if (!g_str_has_prefix (query.signal_name, "handle-") ||
+              query.return_type != G_TYPE_BOOLEAN ||
+              query.n_params < 1 ||
+              (query.param_types[0] & ~G_SIGNAL_TYPE_STATIC_SCOPE) != G_TYPE_DBUS_METHOD_INVOCATION)
+            continue;
+
+          closure = g_closure_new_object (sizeof (GClosure), G_OBJECT (executor));
+          g_closure_set_marshal (closure, on_handle_method);
+          g_signal_connect_closure_by_id (interface_, signal_ids[m], 0, closure, FALSE);
+        }
+      g_free (signal_ids);
+    }
+  g_free (ifaces);
+
+  g_dbus_interface_skeleton_set_flags (interface_,
+                                       flags & ~G_DBUS_INTERFACE_SKELETON_FLAGS_HANDLE_METHOD_INVOCATIONS_IN_THREAD);
+}
+
+/**
+ * udisks_method_executor_begin_blocking:
+ *
+ * Marks the calling thread as blocked, e.g. waiting for a job to
+ * finish, until udisks_method_executor_end_blocking() is called. If
+ * the thread is handling a method call for a #UDisksMethodExecutor,
+ * another thread is allowed to handle waiting calls in the meantime.
+ * Does nothing when called from other threads.
+ */
+void
+udisks_method_executor_begin_blocking (void)
+{
+  UDisksMethodExecutor *executor = worker_executor;
+
+  if (executor == NULL || dispatching_invocation == NULL || blocking_depth++ > 0)
+    return;
+
+  g_mutex_lock (&executor->lock);
+  executor->blocking++;
+  g_thread_pool_set_max_threads (executor->pool, executor->max_workers + executor->blocking, NULL);
+  g_mutex_unlock (&executor->lock);
+}
+
+/**
+ * udisks_method_executor_end_blocking:
+ *
+ * Undoes the effect of udisks_method_executor_begin_blocking().
+ */
+void
+udisks_method_executor_end_blocking (void)
+{
+  UDisksMethodExecutor *executor = worker_executor;
+
+  if (executor == NULL || dispatching_invocation == NULL)
+    return;
+
+  g_return_if_fail (blocking_depth > 0);
+  if (--blocking_depth > 0)
+    return;
+
+  g_mutex_lock (&executor->lock);
+  executor->blocking--;
+  g_thread_pool_set_max_threads (executor->pool, executor->max_workers + executor->blocking, NULL);
+  g_mutex_unlock (&executor->lock);
+}
+
+/**
+ * udisks_method_executor_get_stats:
+ * @executor: A #UDisksMethodExecutor.
+ * @out_queued: (out) (allow-none): Return location for the number of calls waiting for a thread or %NULL.
+ * @out_running: (out) (allow-none): Return location for the number of calls being handled or %NULL.
+ * @out_dispatched: (out) (allow-none): Return location for the number of calls handled so far or %NULL.
+ * @out_rejected: (out) (allow-none): Return location for the number of calls rejected so far or %NULL.
+ * @out_total_wait_usec: (out) (allow-none): Return location for the time all handled calls waited for a thread or %NULL.
+ * @out_max_wait_usec: (out) (allow-none): Return location for the longest time a call waited for a thread or %NULL.
+ *
+ * Gets statistics about the method calls handled by @executor.
+ */
+void
+udisks_method_executor_get_stats (UDisksMethodExecutor *executor,
+                                  guint                *out_queued,
+                                  guint                *out_running,
+                                  guint64              *out_dispatched,
+                                  guint64              *out_rejected,
+                                  gint64               *out_total_wait_usec,
+                                  gint64               *out_max_wait_usec)
+{
+  g_return_if_fail (UDISKS_IS_METHOD_EXECUTOR (executor));
+
+  g_mutex_lock (&executor->lock);
+  if (out_queued != NULL)
+    *out_queued = executor->queued;
+  if (out_running != NULL)
+    *out_running = executor->running;
+  if (out_dispatched != NULL)
+    *out_dispatched = executor->dispatched;
+  if (out_rejected != NULL)
+    *out_rejected = executor->rejected;
+  if (out_total_wait_usec != NULL)
+    *out_total_wait_usec = executor->total_wait_usec;
+  if (out_max_wait_usec != NULL)
+    *out_max_wait_usec = executor->max_wait_usec;
+  g_mutex_unlock (&executor->lock);
+}
@@ -0,0 +1,49 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2026 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef __UDISKS_METHOD_EXECUTOR_H__
+#define __UDISKS_METHOD_EXECUTOR_H__
+
+#include "udisksdaemontypes.h"
+
+G_BEGIN_DECLS
+
+#define UDISKS_TYPE_METHOD_EXECUTOR  (udisks_method_executor_get_type ())
+#define UDISKS_METHOD_EXECUTOR(o)    (G_TYPE_CHECK_INSTANCE_CAST ((o), UDISKS_TYPE_METHOD_EXECUTOR, UDisksMethodExecutor))
+#define UDISKS_IS_METHOD_EXECUTOR(o) (G_TYPE_CHECK_INSTANCE_TYPE ((o), UDISKS_TYPE_METHOD_EXECUTOR))
+
+GType                 udisks_method_executor_get_type  (void) G_GNUC_CONST;
+UDisksMethodExecutor *udisks_method_executor_new       (UDisksDaemon           *daemon);
+void                  udisks_method_executor_attach    (UDisksMethodExecutor   *executor,
+                                                        GDBusInterfaceSkeleton *interface_);
+void                  udisks_method_executor_begin_blocking (void);
+void                  udisks_method_executor_end_blocking   (void);
+void                  udisks_method_executor_get_stats (UDisksMethodExecutor   *executor,
+                                                        guint                  *out_queued,
+                                                        guint                  *out_running,
+                                                        guint64                *out_dispatched,
+                                                        guint64                *out_rejected,
+                                                        gint64                 *out_total_wait_usec,
+                                                        gint64                 *out_max_wait_usec);
+
+G_END_DECLS
+
+#endif /* __UDISKS_METHOD_EXECUTOR_H__ */
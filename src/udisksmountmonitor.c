@@ -30,6 +30,9 @@
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
 #include <mntent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <glib-object.h>
@@ -56,6 +59,18 @@
  * <literal>/proc/swaps</literal> files.
  */
 
+/* An immutable snapshot of the mount table. A new one is built on every
+ * reload and published in monitor->table, readers take a reference under
+ * monitor->table_lock (held only for that) and use it without any locking.
+ */
+typedef struct
+{
+  volatile gint ref_count;
+  GList *mounts;          /* UDisksMount objects sorted with udisks_mount_compare() */
+  GHashTable *by_dev;     /* dev_t -> sorted GList of UDisksMount objects from @mounts */
+  GHashTable *by_path;    /* mount path -> UDisksMount, only for filesystem mounts */
+} MountTable;
+
 /**
  * UDisksMountMonitor:
  *
@@ -72,12 +87,27 @@ struct _UDisksMountMonitor
   GIOChannel *swaps_channel;
   GSource *swaps_watch_source;
 
-  GList *mounts;
-  GList *old_mounts;
-  GMutex mounts_mutex;
+  MountTable *table;                /* protected by table_lock */
+  GMutex table_lock;
+  guint64 n_reloads_avoided;        /* protected by table_lock */
+
+  /* the table signals were last emitted for, only used in monitor_context */
+  MountTable *old_table;
+
+  /* serializes reloads, see udisks_mount_monitor_ensure() */
+  GMutex reload_mutex;
+  gchar *mountinfo_checksum;        /* protected by reload_mutex */
+  gchar *swaps_checksum;            /* protected by reload_mutex */
 
-  gchar *mountinfo_checksum;
-  gchar *swaps_checksum;
+  /* bumped whenever /proc/self/mountinfo or /proc/swaps signal a change,
+   * the files are only re-read if it moved since the last load, see
+   * udisks_mount_monitor_ensure() */
+  volatile gint generation;
+  volatile gint loaded_generation;
+  /* private descriptors polled by udisks_mount_monitor_ensure() so that
+   * queries from other threads don't have to wait for the watches */
+  gint mountinfo_poll_fd;
+  gint swaps_poll_fd;
 
   GMainContext *monitor_context;
 };
@@ -107,9 +137,12 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE (UDisksMountMonitor, udisks_mount_monitor, G_TYPE_OBJECT)
 
-static void udisks_mount_monitor_ensure (UDisksMountMonitor *monitor);
+static gboolean udisks_mount_monitor_ensure (UDisksMountMonitor *monitor);
 static void udisks_mount_monitor_constructed (GObject *object);
 
+static MountTable *mount_table_new (void);
+static void mount_table_unref (MountTable *table);
+
 static void
 udisks_mount_monitor_finalize (GObject *object)
 {
@@ -125,16 +158,23 @@ udisks_mount_monitor_finalize (GObject *object)
   if (monitor->swaps_watch_source != NULL)
     g_source_destroy (monitor->swaps_watch_source);
 
+  if (monitor->mountinfo_poll_fd >= 0)
+    close (monitor->mountinfo_poll_fd);
+  if (monitor->swaps_poll_fd >= 0)
+    close (monitor->swaps_poll_fd);
+
   if (monitor->monitor_context != NULL)
     g_main_context_unref (monitor->monitor_context);
 
-  g_list_free_full (monitor->mounts, g_object_unref);
-  g_list_free_full (monitor->old_mounts, g_object_unref);
+  mount_table_unref (monitor->table);
+  if (monitor->old_table != NULL)
+    mount_table_unref (monitor->old_table);
 
   g_free (monitor->mountinfo_checksum);
   g_free (monitor->swaps_checksum);
 
-  g_mutex_clear (&monitor->mounts_mutex);
+  g_mutex_clear (&monitor->table_lock);
+  g_mutex_clear (&monitor->reload_mutex);
 
   if (G_OBJECT_CLASS (udisks_mount_monitor_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (udisks_mount_monitor_parent_class)->finalize (object);
@@ -143,9 +183,16 @@ udisks_mount_monitor_finalize (GObject *object)
 static void
 udisks_mount_monitor_init (UDisksMountMonitor *monitor)
 {
-  monitor->mounts = NULL;
-  monitor->old_mounts = NULL;
-  g_mutex_init (&monitor->mounts_mutex);
+  monitor->table = mount_table_new ();
+  monitor->old_table = NULL;
+  g_mutex_init (&monitor->table_lock);
+  g_mutex_init (&monitor->reload_mutex);
+
+  /* force the initial load */
+  monitor->generation = 1;
+  monitor->loaded_generation = 0;
+  monitor->mountinfo_poll_fd = -1;
+  monitor->swaps_poll_fd = -1;
 }
 
 static void
@@ -201,6 +248,121 @@ udisks_mount_monitor_class_init (UDisksMountMonitorClass *klass)
                                                 UDISKS_TYPE_MOUNT);
 }
 
+static MountTable *
+mount_table_new (void)
+{
+  MountTable *table;
+
+  table = g_new0 (MountTable, 1);
+  table->ref_count = 1;
+  table->by_dev = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+  table->by_path = g_hash_table_new (g_str_hash, g_str_equal);
+
+  return table;
+}
+
+static MountTable *
+mount_table_ref (MountTable *table)
+{
+  g_atomic_int_inc (&table->ref_count);
+  return table;
+}
+
+static void
+mount_table_unref (MountTable *table)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  if (!g_atomic_int_dec_and_test (&table->ref_count))
+    return;
+
+  /* the lists are not freed by the hash table, see mount_table_finish() */
+  g_hash_table_iter_init (&iter, table->by_dev);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_list_free (value);
+  g_hash_table_destroy (table->by_dev);
+  g_hash_table_destroy (table->by_path);
+  g_list_free_full (table->mounts, g_object_unref);
+  g_free (table);
+}
+
+/* only used while @table is being built and not yet published */
+static void
+mount_table_add (MountTable      *table,
+                 dev_t            dev,
+                 const gchar     *mount_point,
+                 UDisksMountType  type)
+{
+  gint64 *key;
+  GList *dev_mounts;
+  GList *l;
+  UDisksMount *mount;
+
+  key = g_new (gint64, 1);
+  *key = dev;
+
+  dev_mounts = g_hash_table_lookup (table->by_dev, key);
+  for (l = dev_mounts; l != NULL; l = l->next)
+    {
+      if (g_strcmp0 (udisks_mount_get_mount_path (UDISKS_MOUNT (l->data)), mount_point) == 0)
+        {
+          g_free (key);
+          return;
+        }
+    }
+
+  mount = _udisks_mount_new (dev, mount_point, type);
+  table->mounts = g_list_prepend (table->mounts, mount);
+  /* frees @key if there's an existing one */
+  g_hash_table_insert (table->by_dev, key, g_list_prepend (dev_mounts, mount));
+}
+
+/* sorts the lists and builds the path index once @table is complete */
+static void
+mount_table_finish (MountTable *table)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GList *l;
+
+  /* @mounts is still in reverse parse order here, so for overmounted paths
+   * the most recently mounted filesystem (the one visible there) wins */
+  for (l = table->mounts; l != NULL; l = l->next)
+    {
+      UDisksMount *mount = UDISKS_MOUNT (l->data);
+
+      if (udisks_mount_get_mount_type (mount) == UDISKS_MOUNT_TYPE_FILESYSTEM &&
+          !g_hash_table_contains (table->by_path, udisks_mount_get_mount_path (mount)))
+        g_hash_table_insert (table->by_path, (gpointer) udisks_mount_get_mount_path (mount), mount);
+    }
+
+  table->mounts = g_list_sort (table->mounts, (GCompareFunc) udisks_mount_compare);
+
+  /* shortest mount paths first, the hash table has no value destroy function */
+  g_hash_table_iter_init (&iter, table->by_dev);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_hash_table_iter_replace (&iter, g_list_sort (value, (GCompareFunc) udisks_mount_compare));
+}
+
+/* returns a reference to the current, up-to-date, mount table */
+static MountTable *
+get_mount_table (UDisksMountMonitor *monitor)
+{
+  MountTable *table;
+  gboolean reload_avoided;
+
+  reload_avoided = udisks_mount_monitor_ensure (monitor);
+
+  g_mutex_lock (&monitor->table_lock);
+  if (reload_avoided)
+    monitor->n_reloads_avoided++;
+  table = mount_table_ref (monitor->table);
+  g_mutex_unlock (&monitor->table_lock);
+
+  return table;
+}
+
 static void
 diff_sorted_lists (GList *list1,
                    GList *list2,
@@ -247,21 +409,19 @@ diff_sorted_lists (GList *list1,
 static void
 reload_mounts (UDisksMountMonitor *monitor)
 {
-  GList *cur_mounts;
+  MountTable *table;
   GList *added;
   GList *removed;
   GList *l;
 
-  udisks_mount_monitor_ensure (monitor);
-
-  g_mutex_lock (&monitor->mounts_mutex);
-  cur_mounts = g_list_copy_deep (monitor->mounts, (GCopyFunc) udisks_g_object_ref_copy, NULL);
-  g_mutex_unlock (&monitor->mounts_mutex);
+  table = get_mount_table (monitor);
 
-  /* no need to lock monitor->old_mounts as reload_mounts() should
+  /* no need to lock monitor->old_table as reload_mounts() should
    * always be called from monitor->monitor_context. */
-  cur_mounts = g_list_sort (cur_mounts, (GCompareFunc) udisks_mount_compare);
-  diff_sorted_lists (monitor->old_mounts, cur_mounts, (GCompareFunc) udisks_mount_compare, &added, &removed);
+  diff_sorted_lists (monitor->old_table != NULL ? monitor->old_table->mounts : NULL,
+                     table->mounts,
+                     (GCompareFunc) udisks_mount_compare,
+                     &added, &removed);
 
   for (l = removed; l != NULL; l = l->next)
     {
@@ -275,8 +435,9 @@ reload_mounts (UDisksMountMonitor *monitor)
       g_signal_emit (monitor, signals[MOUNT_ADDED_SIGNAL], 0, mount);
     }
 
-  g_list_free_full (monitor->old_mounts, g_object_unref);
-  monitor->old_mounts = cur_mounts;
+  if (monitor->old_table != NULL)
+    mount_table_unref (monitor->old_table);
+  monitor->old_table = table;
 
   g_list_free (removed);
   g_list_free (added);
@@ -290,6 +451,7 @@ mounts_changed_event (GIOChannel *channel,
   UDisksMountMonitor *monitor = UDISKS_MOUNT_MONITOR (user_data);
   if (cond & ~G_IO_ERR)
     goto out;
+  g_atomic_int_inc (&monitor->generation);
   reload_mounts (monitor);
  out:
   return TRUE;
@@ -303,6 +465,7 @@ swaps_changed_event (GIOChannel *channel,
   UDisksMountMonitor *monitor = UDISKS_MOUNT_MONITOR (user_data);
   if (cond & ~G_IO_ERR)
     goto out;
+  g_atomic_int_inc (&monitor->generation);
   reload_mounts (monitor);
  out:
   return TRUE;
@@ -327,6 +490,9 @@ udisks_mount_monitor_constructed (GObject *object)
 
   monitor->monitor_context = g_main_context_ref_thread_default ();
 
+  monitor->mountinfo_poll_fd = open ("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+  monitor->swaps_poll_fd = open ("/proc/swaps", O_RDONLY | O_CLOEXEC);
+
   /* fetch initial data */
   udisks_mount_monitor_ensure (monitor);
 
@@ -407,30 +573,6 @@ udisks_mount_monitor_new (void)
   return UDISKS_MOUNT_MONITOR (g_object_new (UDISKS_TYPE_MOUNT_MONITOR, NULL));
 }
 
-static gboolean
-have_mount (UDisksMountMonitor *monitor,
-            dev_t               dev,
-            const gchar        *mount_point)
-{
-  GList *l;
-  gboolean ret;
-
-  ret = FALSE;
-
-  for (l = monitor->mounts; l != NULL; l = l->next)
-    {
-      UDisksMount *mount = UDISKS_MOUNT (l->data);
-      if (udisks_mount_get_dev (mount) == dev &&
-          g_strcmp0 (udisks_mount_get_mount_path (mount), mount_point) == 0)
-        {
-          ret = TRUE;
-          break;
-        }
-    }
-
-  return ret;
-}
-
 /* ---------------------------------------------------------------------------------------------------- */
 
 static gboolean
@@ -451,21 +593,22 @@ udisks_mount_monitor_read_mountinfo (gchar  **contents,
 }
 
 static void
-udisks_mount_monitor_parse_mountinfo (UDisksMountMonitor  *monitor,
-                                      const gchar         *contents)
+udisks_mount_monitor_parse_mountinfo (MountTable   *table,
+                                      const gchar  *contents)
 {
-  gchar **lines;
-  guint n;
+  const gchar *line;
+  const gchar *line_end;
 
   /* See Documentation/filesystems/proc.txt for the format of /proc/self/mountinfo
    *
    * Note that things like space are encoded as \020.
+   *
+   * The contents are parsed in place, line by line.
    */
   if (contents == NULL)
     return;
 
-  lines = g_strsplit (contents, "\n", 0);
-  for (n = 0; lines[n] != NULL; n++)
+  for (line = contents; line != NULL && *line != '\0'; line = line_end != NULL ? line_end + 1 : NULL)
     {
       guint mount_id;
       guint parent_id;
@@ -473,12 +616,16 @@ udisks_mount_monitor_parse_mountinfo (UDisksMountMonitor  *monitor,
       gchar encoded_root[PATH_MAX + 1];
       gchar encoded_mount_point[PATH_MAX + 1];
       gchar *mount_point;
+      gint line_len;
       dev_t dev;
 
-      if (strlen (lines[n]) == 0)
+      line_end = strchr (line, '\n');
+      line_len = line_end != NULL ? line_end - line : (gint) strlen (line);
+      if (line_len == 0)
         continue;
 
-      if (sscanf (lines[n],
+      /* sscanf() stops at the newline as it is whitespace */
+      if (sscanf (line,
                   "%u %u %u:%u " PATH_MAX_FMT " " PATH_MAX_FMT,
                   &mount_id,
                   &parent_id,
@@ -487,7 +634,7 @@ udisks_mount_monitor_parse_mountinfo (UDisksMountMonitor  *monitor,
                   encoded_root,
                   encoded_mount_point) != 6)
         {
-          udisks_warning ("Error parsing line '%s'", lines[n]);
+          udisks_warning ("Error parsing line '%.*s'", line_len, line);
           continue;
         }
       encoded_root[sizeof encoded_root - 1] = '\0';
@@ -503,16 +650,20 @@ udisks_mount_monitor_parse_mountinfo (UDisksMountMonitor  *monitor,
       if (major == 0)
         {
           const gchar *sep;
-          sep = strstr (lines[n], " - ");
+          sep = g_strstr_len (line, line_len, " - ");
           if (sep != NULL)
             {
               gchar fstype[PATH_MAX + 1];
               gchar mount_source[PATH_MAX + 1];
               struct stat statbuf;
 
+              /* only btrfs is interesting, avoid parsing the rest for all the other virtual filesystems */
+              if (!g_str_has_prefix (sep + 3, "btrfs "))
+                continue;
+
               if (sscanf (sep + 3, PATH_MAX_FMT " " PATH_MAX_FMT, fstype, mount_source) != 2)
                 {
-                  udisks_warning ("Error parsing things past - for '%s'", lines[n]);
+                  udisks_warning ("Error parsing things past - for '%.*s'", line_len, line);
                   continue;
                 }
               fstype[sizeof fstype - 1] = '\0';
@@ -549,18 +700,9 @@ udisks_mount_monitor_parse_mountinfo (UDisksMountMonitor  *monitor,
         }
 
       mount_point = g_strcompress (encoded_mount_point);
-
-      /* TODO: we can probably use a hash table or something if this turns out to be slow */
-      if (!have_mount (monitor, dev, mount_point))
-        {
-          UDisksMount *mount;
-          mount = _udisks_mount_new (dev, mount_point, UDISKS_MOUNT_TYPE_FILESYSTEM);
-          monitor->mounts = g_list_prepend (monitor->mounts, mount);
-        }
-
+      mount_table_add (table, dev, mount_point, UDISKS_MOUNT_TYPE_FILESYSTEM);
       g_free (mount_point);
     }
-  g_strfreev (lines);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -591,8 +733,8 @@ udisks_mount_monitor_read_swaps (gchar  **contents,
 }
 
 static void
-udisks_mount_monitor_parse_swaps (UDisksMountMonitor  *monitor,
-                                  const gchar         *contents)
+udisks_mount_monitor_parse_swaps (MountTable   *table,
+                                  const gchar  *contents)
 {
   gchar **lines;
   guint n;
@@ -628,20 +770,67 @@ udisks_mount_monitor_parse_swaps (UDisksMountMonitor  *monitor,
         }
 
       dev = statbuf.st_rdev;
-
-      if (!have_mount (monitor, dev, NULL))
-        {
-          UDisksMount *mount;
-          mount = _udisks_mount_new (dev, NULL, UDISKS_MOUNT_TYPE_SWAP);
-          monitor->mounts = g_list_prepend (monitor->mounts, mount);
-        }
+      mount_table_add (table, dev, NULL, UDISKS_MOUNT_TYPE_SWAP);
     }
   g_strfreev (lines);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+/* Checks the private descriptors for changes not yet seen by the watches in
+ * monitor->monitor_context. Both /proc/self/mountinfo and /proc/swaps signal
+ * POLLERR|POLLPRI once per change and per open file.
+ */
 static void
+udisks_mount_monitor_check_poll_fds (UDisksMountMonitor *monitor)
+{
+  struct pollfd fds[2];
+  nfds_t nfds = 0;
+  nfds_t n;
+
+  if (monitor->mountinfo_poll_fd >= 0)
+    {
+      fds[nfds].fd = monitor->mountinfo_poll_fd;
+      fds[nfds].events = POLLPRI;
+      fds[nfds].revents = 0;
+      nfds++;
+    }
+  if (monitor->swaps_poll_fd >= 0)
+    {
+      fds[nfds].fd = monitor->swaps_poll_fd;
+      fds[nfds].events = POLLPRI;
+      fds[nfds].revents = 0;
+      nfds++;
+    }
+
+  if (nfds == 0)
+    {
+      /* no way to tell, always reload */
+      g_atomic_int_inc (&monitor->generation);
+      return;
+    }
+
+  if (poll (fds, nfds, 0) <= 0)
+    return;
+
+  for (n = 0; n < nfds; n++)
+    {
+      if (fds[n].revents & (POLLERR | POLLPRI))
+        {
+          g_atomic_int_inc (&monitor->generation);
+          break;
+        }
+    }
+}
+
+/* Makes sure monitor->table reflects the current mount table. Readers
+ * only get here for the cheap generation check unless something changed,
+ * a reload never blocks readers of the table already published nor other
+ * threads noticing the same change meanwhile.
+ *
+ * Returns TRUE if the files were not re-read by this call.
+ */
+static gboolean
 udisks_mount_monitor_ensure (UDisksMountMonitor *monitor)
 {
   gchar *mountinfo_contents = NULL;
@@ -653,8 +842,27 @@ udisks_mount_monitor_ensure (UDisksMountMonitor *monitor)
   GSource *idle_source;
   gboolean have_mountinfo;
   gboolean have_swaps;
+  gint generation;
+
+  udisks_mount_monitor_check_poll_fds (monitor);
+  if (g_atomic_int_get (&monitor->generation) == g_atomic_int_get (&monitor->loaded_generation))
+    return TRUE;
+
+  /* Another thread is reloading already, serve the table published so far
+   * rather than waiting for it. Should that reload have read the files
+   * before the change seen here, loaded_generation stays behind and the
+   * next query reloads again.
+   */
+  if (!g_mutex_trylock (&monitor->reload_mutex))
+    return TRUE;
 
-  g_mutex_lock (&monitor->mounts_mutex);
+  /* another thread may have reloaded meanwhile */
+  generation = g_atomic_int_get (&monitor->generation);
+  if (generation == g_atomic_int_get (&monitor->loaded_generation))
+    {
+      g_mutex_unlock (&monitor->reload_mutex);
+      return TRUE;
+    }
 
   have_mountinfo = udisks_mount_monitor_read_mountinfo (&mountinfo_contents, &mountinfo_length);
   have_swaps = udisks_mount_monitor_read_swaps (&swaps_contents, &swaps_length);
@@ -672,11 +880,20 @@ udisks_mount_monitor_ensure (UDisksMountMonitor *monitor)
       if (g_strcmp0 (mountinfo_checksum, monitor->mountinfo_checksum) != 0 ||
           g_strcmp0 (swaps_checksum, monitor->swaps_checksum) != 0)
         {
-          g_list_free_full (monitor->mounts, g_object_unref);
-          monitor->mounts = NULL;
+          MountTable *table;
+          MountTable *old_table;
 
-          udisks_mount_monitor_parse_mountinfo (monitor, mountinfo_contents);
-          udisks_mount_monitor_parse_swaps (monitor, swaps_contents);
+          table = mount_table_new ();
+          udisks_mount_monitor_parse_mountinfo (table, mountinfo_contents);
+          udisks_mount_monitor_parse_swaps (table, swaps_contents);
+          mount_table_finish (table);
+
+          /* publish the new table */
+          g_mutex_lock (&monitor->table_lock);
+          old_table = monitor->table;
+          monitor->table = table;
+          g_mutex_unlock (&monitor->table_lock);
+          mount_table_unref (old_table);
 
           /* save current checksums */
           g_free (monitor->mountinfo_checksum);
@@ -695,10 +912,14 @@ udisks_mount_monitor_ensure (UDisksMountMonitor *monitor)
         g_free (mountinfo_checksum);
         g_free (swaps_checksum);
     }
+  if (have_mountinfo && have_swaps)
+    g_atomic_int_set (&monitor->loaded_generation, generation);
   g_free (mountinfo_contents);
   g_free (swaps_contents);
 
-  g_mutex_unlock (&monitor->mounts_mutex);
+  g_mutex_unlock (&monitor->reload_mutex);
+
+  return FALSE;
 }
 
 /**
@@ -716,30 +937,17 @@ GList *
 udisks_mount_monitor_get_mounts_for_dev (UDisksMountMonitor *monitor,
                                          dev_t               dev)
 {
+  MountTable *table;
   GList *ret;
-  GList *l;
-
-  ret = NULL;
-
-  udisks_mount_monitor_ensure (monitor);
-
-  g_mutex_lock (&monitor->mounts_mutex);
-
-  for (l = monitor->mounts; l != NULL; l = l->next)
-    {
-      UDisksMount *mount = UDISKS_MOUNT (l->data);
-
-      if (udisks_mount_get_dev (mount) == dev)
-        {
-          ret = g_list_prepend (ret, g_object_ref (mount));
-        }
-    }
+  gint64 key = dev;
 
-  g_mutex_unlock (&monitor->mounts_mutex);
+  table = get_mount_table (monitor);
 
-  /* Sort the list to ensure that shortest mount paths appear first */
-  ret = g_list_sort (ret, (GCompareFunc) udisks_mount_compare);
+  /* the list is sorted to ensure that shortest mount paths appear first */
+  ret = g_list_copy_deep (g_hash_table_lookup (table->by_dev, &key),
+                          (GCopyFunc) udisks_g_object_ref_copy, NULL);
 
+  mount_table_unref (table);
   return ret;
 }
 
@@ -758,29 +966,23 @@ udisks_mount_monitor_is_dev_in_use (UDisksMountMonitor  *monitor,
                                     dev_t                dev,
                                     UDisksMountType     *out_type)
 {
+  MountTable *table;
   gboolean ret;
-  GList *l;
+  GList *dev_mounts;
+  gint64 key = dev;
 
   ret = FALSE;
-  udisks_mount_monitor_ensure (monitor);
+  table = get_mount_table (monitor);
 
-  g_mutex_lock (&monitor->mounts_mutex);
-
-  for (l = monitor->mounts; l != NULL; l = l->next)
+  dev_mounts = g_hash_table_lookup (table->by_dev, &key);
+  if (dev_mounts != NULL)
     {
-      UDisksMount *mount = UDISKS_MOUNT (l->data);
-
-      if (udisks_mount_get_dev (mount) == dev)
-        {
-          if (out_type != NULL)
-            *out_type = udisks_mount_get_mount_type (mount);
-          ret = TRUE;
-          goto out;
-        }
+      if (out_type != NULL)
+        *out_type = udisks_mount_get_mount_type (UDISKS_MOUNT (dev_mounts->data));
+      ret = TRUE;
     }
 
- out:
-  g_mutex_unlock (&monitor->mounts_mutex);
+  mount_table_unref (table);
   return ret;
 }
 
@@ -799,28 +1001,42 @@ UDisksMount *
 udisks_mount_monitor_get_mount_for_path (UDisksMountMonitor  *monitor,
                                          const gchar         *mount_path)
 {
-  GList *l;
+  MountTable *table;
+  UDisksMount *mount;
 
   g_return_val_if_fail (UDISKS_IS_MOUNT_MONITOR (monitor), NULL);
   g_return_val_if_fail (mount_path != NULL, NULL);
 
-  udisks_mount_monitor_ensure (monitor);
+  table = get_mount_table (monitor);
 
-  g_mutex_lock (&monitor->mounts_mutex);
+  mount = g_hash_table_lookup (table->by_path, mount_path);
+  if (mount != NULL)
+    g_object_ref (mount);
 
-  for (l = monitor->mounts; l != NULL; l = l->next)
-    {
-      UDisksMount *mount = UDISKS_MOUNT (l->data);
+  mount_table_unref (table);
+  return mount;
+}
 
-      if (udisks_mount_get_mount_type (mount) == UDISKS_MOUNT_TYPE_FILESYSTEM &&
-          g_strcmp0 (udisks_mount_get_mount_path (mount), mount_path) == 0)
-        {
-          g_object_ref (mount);
-          g_mutex_unlock (&monitor->mounts_mutex);
-          return mount;
-        }
-    }
+/**
+ * udisks_mount_monitor_get_reloads_avoided:
+ * @monitor: A #UDisksMountMonitor.
+ *
+ * Gets the number of queries that were answered without re-reading
+ * <literal>/proc/self/mountinfo</literal> and <literal>/proc/swaps</literal>
+ * because neither of them changed since they were last read.
+ *
+ * Returns: The number of avoided reloads.
+ */
+guint64
+udisks_mount_monitor_get_reloads_avoided (UDisksMountMonitor *monitor)
+{
+  guint64 ret;
+
+  g_return_val_if_fail (UDISKS_IS_MOUNT_MONITOR (monitor), 0);
 
-  g_mutex_unlock (&monitor->mounts_mutex);
-  return NULL;
+  g_mutex_lock (&monitor->table_lock);
+  ret = monitor->n_reloads_avoided;
+  g_mutex_unlock (&monitor->table_lock);
+
+  return ret;
 }
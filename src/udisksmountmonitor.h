@@ -38,6 +38,7 @@ gboolean             udisks_mount_monitor_is_dev_in_use      (UDisksMountMonitor
                                                               UDisksMountType     *out_type);
 UDisksMount         *udisks_mount_monitor_get_mount_for_path (UDisksMountMonitor  *monitor,
                                                               const gchar         *mount_path);
+guint64              udisks_mount_monitor_get_reloads_avoided (UDisksMountMonitor *monitor);
 
 G_END_DECLS
 
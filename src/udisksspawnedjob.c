@@ -35,6 +35,7 @@
 #include "udisks-daemon-marshal.h"
 #include "udisksdaemon.h"
 #include "udisksdaemonutil.h"
+#include "udisksjobscheduler.h"
 
 /**
  * SECTION:udisksspawnedjob
@@ -890,16 +891,10 @@ udisks_spawned_job_release_resources (UDisksSpawnedJob *job)
     }
 }
 
-/**
- * udisks_spawned_job_start:
- * @job: the job to start
- *
- * Connect to the #UDisksSpawnedJob::spawned-job-completed or
- * #UDisksJob::completed signals to get notified when the job is done.
- *
- * */
-void udisks_spawned_job_start (UDisksSpawnedJob *job)
+static void
+spawned_job_start_now (UDisksBaseJob *base_job)
 {
+  UDisksSpawnedJob *job = UDISKS_SPAWNED_JOB (base_job);
   GError *error;
   gint child_argc;
   gchar **child_argv = NULL;
@@ -1075,6 +1070,31 @@ void udisks_spawned_job_start (UDisksSpawnedJob *job)
   g_strfreev (child_argv);
 }
 
+/**
+ * udisks_spawned_job_start:
+ * @job: the job to start
+ *
+ * Connect to the #UDisksSpawnedJob::spawned-job-completed or
+ * #UDisksJob::completed signals to get notified when the job is done.
+ *
+ * If the drives @job is on are busy, @job is queued by the
+ * #UDisksJobScheduler of the daemon and the command is spawned later
+ * from the thread-default main loop of the calling thread.
+ */
+void
+udisks_spawned_job_start (UDisksSpawnedJob *job)
+{
+  UDisksDaemon *daemon;
+
+  daemon = udisks_base_job_get_daemon (UDISKS_BASE_JOB (job));
+  if (daemon != NULL)
+    udisks_job_scheduler_start (udisks_daemon_get_job_scheduler (daemon),
+                                UDISKS_BASE_JOB (job),
+                                spawned_job_start_now);
+  else
+    spawned_job_start_now (UDISKS_BASE_JOB (job));
+}
+
 /* manage strings with potentially unsafe content */
 
 static gpointer
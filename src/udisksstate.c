@@ -32,6 +32,8 @@
 
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <errno.h>
 
 #include "udisksdaemon.h"
@@ -41,6 +43,7 @@
 #include "udiskslogging.h"
 #include "udiskslinuxprovider.h"
 #include "udisksdaemonutil.h"
+#include "udisksconfigmanager.h"
 #include "udiskslinuxencryptedhelpers.h"
 #include "udiskslinuxblockobject.h"
 
@@ -150,13 +153,28 @@
  *     </tbody>
  *   </tgroup>
  * </table>
+ * The files are loaded once into in-memory tables indexed by their
+ * key (and, where relevant, the #dev_t recorded in the details) and
+ * changes are written back in batches by a dedicated writer thread.
+ *
+ * If the <option>state_journal</option> option is set in
+ * <filename>udisks2.conf</filename>, changes are instead appended as
+ * small records to a journal next to each file (e.g.
+ * <filename>/run/udisks2/mounted-fs.journal</filename>) that is
+ * replayed on top of the file when it is loaded. Once a journal grows
+ * large it is compacted into a single snapshot of the table. A journal
+ * left behind with the option unset is folded back into the file, so
+ * it is possible to switch in either direction.
+ *
  * Cleaning up is implemented by running a thread (to ensure that
  * actions are serialized) that checks all data in the files mentioned
  * above and cleans up the entry in question by e.g. unmounting a
  * filesystem, removing a mount point or tearing down a device-mapper
  * device when needed. The clean-up thread itself needs to be manually
  * kicked using e.g. udisks_state_check() from suitable places in
- * the #UDisksDaemon and #UDisksProvider implementations.
+ * the #UDisksDaemon and #UDisksProvider implementations, or using
+ * udisks_state_check_devices() to only check the entries referring to
+ * specific devices. In addition, a full check is done periodically.
  *
  * Since cleaning up is only necessary when a device has been removed
  * without having been properly stopped or shut down, the fact that it
@@ -172,6 +190,81 @@
 #define UDISKS_STATE_FILE_MDRAID                 "mdraid"
 #define UDISKS_STATE_FILE_MODULES                "modules"
 
+/* Time to wait for more changes before writing dirty tables to disk */
+#define UDISKS_STATE_WRITE_BEHIND_DELAY_USEC     (50 * G_TIME_SPAN_MILLISECOND)
+
+/* Suffix, header and compaction threshold of state file journals */
+#define UDISKS_STATE_JOURNAL_SUFFIX              ".journal"
+#define UDISKS_STATE_JOURNAL_MAGIC               "UDSJRNL1"
+#define UDISKS_STATE_JOURNAL_MAX_RECORDS         256
+
+/* Interval of the full clean-up pass run regardless of requested checks */
+#define UDISKS_STATE_FULL_CHECK_INTERVAL_SECONDS (10 * 60)
+
+typedef enum
+{
+  STATE_TABLE_MOUNTED_FS,
+  STATE_TABLE_MOUNTED_FS_PERSISTENT,
+  STATE_TABLE_UNLOCKED_CRYPTO_DEV,
+  STATE_TABLE_LOOP,
+  STATE_TABLE_MDRAID,
+  STATE_TABLE_MODULES,
+  N_STATE_TABLES
+} StateTableId;
+
+typedef struct
+{
+  const gchar *key;             /* state file name */
+  gboolean     keyed_by_dev;    /* 'a{ta{sv}}' rather than 'a{sa{sv}}' */
+  const gchar *dev_detail;      /* 't' detail to index entries by, or NULL */
+  const gchar *uid_detail;      /* 'u' detail holding the uid, or NULL */
+} StateTableInfo;
+
+static const StateTableInfo state_table_info[N_STATE_TABLES] =
+{
+  { UDISKS_STATE_FILE_MOUNTED_FS,            FALSE, "block-device",  "mounted-by-uid" },
+  { UDISKS_STATE_FILE_MOUNTED_FS_PERSISTENT, FALSE, "block-device",  "mounted-by-uid" },
+  { UDISKS_STATE_FILE_UNLOCKED_CRYPTO_DEV,   TRUE,  "crypto-device", "unlocked-by-uid" },
+  { UDISKS_STATE_FILE_LOOP,                  FALSE, NULL,            "setup-by-uid" },
+  { UDISKS_STATE_FILE_MDRAID,                TRUE,  NULL,            "started-by-uid" },
+  { UDISKS_STATE_FILE_MODULES,               FALSE, NULL,            NULL },
+};
+
+/* Journal records are serialized as '(yst@a{sv})' GVariants holding the
+ * operation, the key of the entry (name or id) and its details, each
+ * preceded by its little-endian 32-bit size and padded to 8 bytes.
+ */
+typedef enum
+{
+  STATE_JOURNAL_OP_SET    = 's',   /* add or replace the entry */
+  STATE_JOURNAL_OP_REMOVE = 'r',   /* remove the entry */
+  STATE_JOURNAL_OP_CLEAR  = 'c',   /* remove all entries */
+} StateJournalOp;
+
+typedef struct
+{
+  gchar    *name;      /* key of 'a{sa{sv}}' tables */
+  guint64   id;        /* key of 'a{ta{sv}}' tables */
+  guint64   dev;       /* value of the dev_detail, 0 if not set */
+  uid_t     uid;       /* value of the uid_detail, 0 if not set */
+  GVariant *details;   /* 'a{sv}' */
+} StateEntry;
+
+typedef struct
+{
+  const StateTableInfo *info;
+  gboolean loaded;
+  gboolean dirty;
+  GQueue entries;        /* of StateEntry, in file order */
+  GHashTable *by_key;    /* name or &id -> GList link in entries */
+  GHashTable *by_dev;    /* guint64 dev -> GList of StateEntry, in file order */
+
+  gboolean journal;         /* append changes to the journal */
+  gboolean journal_present; /* the journal file exists */
+  guint journal_records;    /* records in the journal, G_MAXUINT if damaged */
+  GQueue journal_pending;   /* of '(yst@a{sv})' records not yet written */
+} StateTable;
+
 /**
  * UDisksState:
  *
@@ -189,9 +282,25 @@ struct _UDisksState
   GThread *thread;
   GMainContext *context;
   GMainLoop *loop;
+  GSource *full_check_source;
 
-  /* key-path -> GVariant */
-  GHashTable *cache;
+  /* requested clean-up checks not yet picked up by the clean-up thread,
+   * see udisks_state_queue_check()
+   */
+  GMutex check_lock;
+  gboolean check_pending;
+  gboolean check_full;
+  GHashTable *check_devs;        /* set of guint64 dev */
+
+  /* in-memory contents of the state files, protected by @lock */
+  StateTable tables[N_STATE_TABLES];
+
+  /* write-behind of dirty tables, see udisks_state_writer_thread_func() */
+  GThread *writer_thread;
+  GMutex writer_lock;
+  GCond writer_cond;
+  gboolean writer_pending;
+  gboolean writer_quit;
 };
 
 typedef struct _UDisksStateClass UDisksStateClass;
@@ -207,46 +316,94 @@ enum
   PROP_DAEMON
 };
 
-static void      udisks_state_check_in_thread     (UDisksState          *state);
+static void      udisks_state_check_in_thread     (UDisksState          *state,
+                                                   GHashTable           *match_devs);
 static void      udisks_state_check_mounted_fs    (UDisksState          *state,
-                                                   const gchar          *key,
+                                                   StateTableId          table_id,
                                                    GArray               *devs_to_clean,
-                                                   dev_t                 match_block_device);
+                                                   dev_t                 match_block_device,
+                                                   GHashTable           *match_devs);
 static void      udisks_state_check_unlocked_crypto_dev (UDisksState          *state,
                                                          gboolean              check_only,
-                                                         GArray               *devs_to_clean);
+                                                         GArray               *devs_to_clean,
+                                                         GHashTable           *match_devs);
 static void      udisks_state_check_loop          (UDisksState          *state,
                                                    gboolean              check_only,
-                                                   GArray               *devs_to_clean);
+                                                   GArray               *devs_to_clean,
+                                                   GHashTable           *match_devs);
 static void      udisks_state_check_mdraid        (UDisksState          *state,
                                                    gboolean              check_only,
-                                                   GArray               *devs_to_clean);
+                                                   GArray               *devs_to_clean,
+                                                   GHashTable           *match_devs);
+static GHashTable *dev_set_new                    (void);
+static void      dev_set_add                      (GHashTable           *set,
+                                                   guint64               dev);
 static gchar    *get_state_file_path              (const gchar          *key);
-static GVariant *udisks_state_get                 (UDisksState          *state,
-                                                   const gchar          *key,
-                                                   const GVariantType   *type);
-static gboolean  udisks_state_set                 (UDisksState          *state,
-                                                   const gchar          *key,
-                                                   const GVariantType   *type,
-                                                   GVariant             *value);
+static void      state_table_init                 (StateTable           *table,
+                                                   const StateTableInfo *info);
+static void      state_table_clear                (StateTable           *table);
+static void      state_table_mark_dirty           (UDisksState          *state,
+                                                   StateTable           *table);
+static gpointer  udisks_state_writer_thread_func  (gpointer              user_data);
 
 G_DEFINE_TYPE (UDisksState, udisks_state, G_TYPE_OBJECT);
 
 static void
 udisks_state_init (UDisksState *state)
 {
+  guint n;
+
   g_mutex_init (&state->lock);
-  state->cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_variant_unref);
+  for (n = 0; n < N_STATE_TABLES; n++)
+    state_table_init (&state->tables[n], &state_table_info[n]);
+
+  g_mutex_init (&state->check_lock);
+  state->check_devs = dev_set_new ();
+
+  g_mutex_init (&state->writer_lock);
+  g_cond_init (&state->writer_cond);
+  state->writer_thread = g_thread_new ("state-writer",
+                                       udisks_state_writer_thread_func,
+                                       state);
+}
+
+static void
+udisks_state_constructed (GObject *object)
+{
+  UDisksState *state = UDISKS_STATE (object);
+  gboolean journal;
+  guint n;
+
+  journal = udisks_config_manager_get_state_journal (udisks_daemon_get_config_manager (state->daemon));
+  for (n = 0; n < N_STATE_TABLES; n++)
+    state->tables[n].journal = journal;
+
+  if (G_OBJECT_CLASS (udisks_state_parent_class)->constructed != NULL)
+    G_OBJECT_CLASS (udisks_state_parent_class)->constructed (object);
 }
 
 static void
 udisks_state_finalize (GObject *object)
 {
   UDisksState *state = UDISKS_STATE (object);
+  guint n;
 
-  g_hash_table_unref (state->cache);
+  /* the writer thread writes out pending changes before quitting */
+  g_mutex_lock (&state->writer_lock);
+  state->writer_quit = TRUE;
+  g_cond_broadcast (&state->writer_cond);
+  g_mutex_unlock (&state->writer_lock);
+  g_thread_join (state->writer_thread);
+  g_cond_clear (&state->writer_cond);
+  g_mutex_clear (&state->writer_lock);
+
+  for (n = 0; n < N_STATE_TABLES; n++)
+    state_table_clear (&state->tables[n]);
   g_mutex_clear (&state->lock);
 
+  g_hash_table_unref (state->check_devs);
+  g_mutex_clear (&state->check_lock);
+
   G_OBJECT_CLASS (udisks_state_parent_class)->finalize (object);
 }
 
@@ -299,6 +456,7 @@ udisks_state_class_init (UDisksStateClass *klass)
   GObjectClass *gobject_class;
 
   gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->constructed = udisks_state_constructed;
   gobject_class->finalize = udisks_state_finalize;
   gobject_class->set_property = udisks_state_set_property;
   gobject_class->get_property = udisks_state_get_property;
@@ -336,6 +494,16 @@ udisks_state_new (UDisksDaemon *daemon)
                                      NULL));
 }
 
+static gboolean
+on_full_check_timeout (gpointer user_data)
+{
+  UDisksState *state = UDISKS_STATE (user_data);
+
+  /* safety net for anything the targeted checks did not cover */
+  udisks_state_check (state);
+  return G_SOURCE_CONTINUE;
+}
+
 static gpointer
 udisks_state_thread_func (gpointer user_data)
 {
@@ -374,6 +542,9 @@ udisks_state_start_cleanup (UDisksState *state)
 
   state->context = g_main_context_new ();
   state->loop = g_main_loop_new (state->context, FALSE);
+  state->full_check_source = g_timeout_source_new_seconds (UDISKS_STATE_FULL_CHECK_INTERVAL_SECONDS);
+  g_source_set_callback (state->full_check_source, on_full_check_timeout, state, NULL);
+  g_source_attach (state->full_check_source, state->context);
   state->thread = g_thread_new ("cleanup",
                                 udisks_state_thread_func,
                                 g_object_ref (state));
@@ -394,6 +565,9 @@ udisks_state_stop_cleanup (UDisksState *state)
   g_return_if_fail (state->thread != NULL);
 
   thread = state->thread;
+  g_source_destroy (state->full_check_source);
+  g_source_unref (state->full_check_source);
+  state->full_check_source = NULL;
   g_main_loop_quit (state->loop);
   g_thread_join (thread);
 }
@@ -402,10 +576,65 @@ static gboolean
 udisks_state_check_func (gpointer user_data)
 {
   UDisksState *state = UDISKS_STATE (user_data);
-  udisks_state_check_in_thread (state);
+  GHashTable *match_devs = NULL;
+
+  g_mutex_lock (&state->check_lock);
+  if (!state->check_pending)
+    {
+      /* already picked up by an earlier invocation */
+      g_mutex_unlock (&state->check_lock);
+      return FALSE;
+    }
+  if (!state->check_full)
+    {
+      match_devs = state->check_devs;
+      state->check_devs = dev_set_new ();
+    }
+  state->check_pending = FALSE;
+  state->check_full = FALSE;
+  g_mutex_unlock (&state->check_lock);
+
+  udisks_state_check_in_thread (state, match_devs);
+
+  if (match_devs != NULL)
+    g_hash_table_unref (match_devs);
   return FALSE;
 }
 
+/* Merges the request into the pending one, if any - only the first
+ * request since the clean-up thread last picked them up schedules a pass.
+ *
+ * A %NULL @devs requests a full pass.
+ */
+static void
+udisks_state_queue_check (UDisksState *state,
+                          const dev_t *devs,
+                          guint        n_devs)
+{
+  gboolean schedule;
+  guint n;
+
+  g_mutex_lock (&state->check_lock);
+  if (devs == NULL)
+    {
+      state->check_full = TRUE;
+      g_hash_table_remove_all (state->check_devs);
+    }
+  else if (!state->check_full)
+    {
+      for (n = 0; n < n_devs; n++)
+        dev_set_add (state->check_devs, devs[n]);
+    }
+  schedule = !state->check_pending;
+  state->check_pending = TRUE;
+  g_mutex_unlock (&state->check_lock);
+
+  if (schedule)
+    g_main_context_invoke (state->context,
+                           udisks_state_check_func,
+                           state);
+}
+
 /**
  * udisks_state_check:
  * @state: A #UDisksState.
@@ -420,9 +649,46 @@ udisks_state_check (UDisksState *state)
   g_return_if_fail (UDISKS_IS_STATE (state));
   g_return_if_fail (state->thread != NULL);
 
-  g_main_context_invoke (state->context,
-                         udisks_state_check_func,
-                         state);
+  udisks_state_queue_check (state, NULL, 0);
+}
+
+/**
+ * udisks_state_check_devices:
+ * @state: A #UDisksState.
+ * @devs: (array length=n_devs): Device numbers of the block devices that changed or went away.
+ * @n_devs: Number of elements in @devs.
+ *
+ * Like udisks_state_check() but only the entries referring to one of
+ * @devs (and the mounted filesystems on devices cleaned up as a result)
+ * are checked. Requests made before the clean-up thread gets to them
+ * are merged into a single pass.
+ *
+ * This can be called from any thread and will not block the calling thread.
+ */
+void
+udisks_state_check_devices (UDisksState *state,
+                            const dev_t *devs,
+                            guint        n_devs)
+{
+  guint n;
+
+  g_return_if_fail (UDISKS_IS_STATE (state));
+  g_return_if_fail (state->thread != NULL);
+
+  if (n_devs == 0)
+    return;
+
+  /* an unknown device could be referenced by any entry */
+  for (n = 0; n < n_devs; n++)
+    {
+      if (devs[n] == 0)
+        {
+          udisks_state_queue_check (state, NULL, 0);
+          return;
+        }
+    }
+
+  udisks_state_queue_check (state, devs, n_devs);
 }
 
 
@@ -437,7 +703,7 @@ typedef struct
 static gboolean
 udisks_state_check_sync_func (UDisksStateCheckSyncData *data)
 {
-  udisks_state_check_in_thread (data->state);
+  udisks_state_check_in_thread (data->state, NULL);
 
   /* signal the calling thread the cleanup has finished */
   g_mutex_lock (&data->data_mutex);
@@ -503,13 +769,15 @@ udisks_state_check_block (UDisksState   *state,
   g_mutex_lock (&state->lock);
 
   udisks_state_check_mounted_fs (state,
-                                 UDISKS_STATE_FILE_MOUNTED_FS,
+                                 STATE_TABLE_MOUNTED_FS,
                                  NULL,
-                                 block_device);
+                                 block_device,
+                                 NULL);
   udisks_state_check_mounted_fs (state,
-                                 UDISKS_STATE_FILE_MOUNTED_FS_PERSISTENT,
+                                 STATE_TABLE_MOUNTED_FS_PERSISTENT,
                                  NULL,
-                                 block_device);
+                                 block_device,
+                                 NULL);
 
   g_mutex_unlock (&state->lock);
 }
@@ -531,11 +799,20 @@ udisks_state_get_daemon (UDisksState *state)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-/* must be called from state thread */
+/* must be called from state thread
+ *
+ * If @match_devs is not %NULL, only the entries referring to one of
+ * the device numbers in the set are checked.
+ */
 static void
-udisks_state_check_in_thread (UDisksState *state)
+udisks_state_check_in_thread (UDisksState *state,
+                              GHashTable  *match_devs)
 {
   GArray *devs_to_clean;
+  GHashTable *mount_match_devs = NULL;
+  GHashTableIter iter;
+  gpointer key;
+  guint n;
 
   g_mutex_lock (&state->lock);
 
@@ -543,7 +820,10 @@ udisks_state_check_in_thread (UDisksState *state)
    * can't be stopped if they are in use
    */
 
-  udisks_info ("Cleanup check start");
+  if (match_devs != NULL)
+    udisks_info ("Cleanup check start (%u devices)", g_hash_table_size (match_devs));
+  else
+    udisks_info ("Cleanup check start");
 
   /* First go through all block devices we might tear down
    * but only check + record devices marked for cleaning
@@ -551,42 +831,65 @@ udisks_state_check_in_thread (UDisksState *state)
   devs_to_clean = g_array_new (FALSE, FALSE, sizeof (dev_t));
   udisks_state_check_unlocked_crypto_dev (state,
                                           TRUE, /* check_only */
-                                          devs_to_clean);
+                                          devs_to_clean,
+                                          match_devs);
   udisks_state_check_loop (state,
                            TRUE, /* check_only */
-                           devs_to_clean);
+                           devs_to_clean,
+                           match_devs);
 
   udisks_state_check_mdraid (state,
                              TRUE, /* check_only */
-                             devs_to_clean);
+                             devs_to_clean,
+                             match_devs);
+
+  /* Filesystems mounted on the devices we intend to clean need to be
+   * checked as well, even if they were not asked for
+   */
+  if (match_devs != NULL)
+    {
+      mount_match_devs = dev_set_new ();
+      g_hash_table_iter_init (&iter, match_devs);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        dev_set_add (mount_match_devs, *((guint64 *) key));
+      for (n = 0; n < devs_to_clean->len; n++)
+        dev_set_add (mount_match_devs, g_array_index (devs_to_clean, dev_t, n));
+    }
 
   /* Then go through all mounted filesystems and pass the
    * devices that we intend to clean...
    */
   udisks_state_check_mounted_fs (state,
-                                 UDISKS_STATE_FILE_MOUNTED_FS,
+                                 STATE_TABLE_MOUNTED_FS,
                                  devs_to_clean,
-                                 0);
+                                 0,
+                                 mount_match_devs);
   udisks_state_check_mounted_fs (state,
-                                 UDISKS_STATE_FILE_MOUNTED_FS_PERSISTENT,
+                                 STATE_TABLE_MOUNTED_FS_PERSISTENT,
                                  devs_to_clean,
-                                 0);
+                                 0,
+                                 mount_match_devs);
 
   /* Then go through all block devices and clear them up
    * ... for real this time
    */
   udisks_state_check_unlocked_crypto_dev (state,
                                           FALSE, /* check_only */
-                                          NULL);
+                                          NULL,
+                                          match_devs);
   udisks_state_check_loop (state,
                            FALSE, /* check_only */
-                           NULL);
+                           NULL,
+                           match_devs);
 
   udisks_state_check_mdraid (state,
                              FALSE, /* check_only */
-                             NULL);
+                             NULL,
+                             match_devs);
 
   g_array_free (devs_to_clean, TRUE);
+  if (mount_match_devs != NULL)
+    g_hash_table_unref (mount_match_devs);
 
   udisks_info ("Cleanup check end");
 
@@ -628,140 +931,1111 @@ lookup_asv (GVariant    *asv,
 /* ---------------------------------------------------------------------------------------------------- */
 
 static void
-trigger_change_uevent (const gchar *sysfs_path)
+state_entry_free (StateEntry *entry)
 {
-  gchar* path = NULL;
-  gint fd = -1;
+  g_free (entry->name);
+  g_variant_unref (entry->details);
+  g_free (entry);
+}
 
-  g_return_if_fail (sysfs_path != NULL);
+static void
+state_table_init (StateTable           *table,
+                  const StateTableInfo *info)
+{
+  table->info = info;
+  table->loaded = FALSE;
+  table->dirty = FALSE;
+  g_queue_init (&table->entries);
+  g_queue_init (&table->journal_pending);
+  if (info->keyed_by_dev)
+    table->by_key = g_hash_table_new (g_int64_hash, g_int64_equal);
+  else
+    table->by_key = g_hash_table_new (g_str_hash, g_str_equal);
+  /* the lists are freed by state_table_clear() */
+  table->by_dev = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+}
 
-  path = g_strconcat (sysfs_path, "/uevent", NULL);
-  fd = open (path, O_WRONLY);
-  if (fd < 0)
-    {
-      udisks_warning ("Error opening %s for trigerring change uevent: %m", path);
-      goto out;
-    }
+static void
+state_table_clear (StateTable *table)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_remove_all (table->by_key);
+  g_hash_table_iter_init (&iter, table->by_dev);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_list_free (value);
+  g_hash_table_remove_all (table->by_dev);
+  while (!g_queue_is_empty (&table->entries))
+    state_entry_free (g_queue_pop_head (&table->entries));
+  /* anything pending is superseded by clearing the table */
+  while (!g_queue_is_empty (&table->journal_pending))
+    g_variant_unref (g_queue_pop_head (&table->journal_pending));
+}
 
-  if (write (fd, "change", sizeof "change" - 1) != sizeof "change" - 1)
+/* records a change of a loaded table for appending it to the journal */
+static void
+state_table_journal (StateTable     *table,
+                     StateJournalOp  op,
+                     StateEntry     *entry)
+{
+  GVariant *record;
+
+  if (!table->journal || !table->loaded)
+    return;
+
+  record = g_variant_new ("(yst@a{sv})",
+                          (guchar) op,
+                          entry != NULL && entry->name != NULL ? entry->name : "",
+                          entry != NULL ? entry->id : 0,
+                          op == STATE_JOURNAL_OP_SET ? entry->details : g_variant_new ("a{sv}", NULL));
+  g_queue_push_tail (&table->journal_pending, g_variant_ref_sink (record));
+}
+
+/* sets the list of entries for @dev in the by_dev index, an empty list removes it */
+static void
+state_table_set_dev_list (StateTable *table,
+                          guint64     dev,
+                          GList      *list)
+{
+  guint64 *key;
+
+  if (list == NULL)
     {
-      udisks_warning ("Error writing 'change' to file %s: %m", path);
-      goto out;
+      g_hash_table_remove (table->by_dev, &dev);
+      return;
     }
+  key = g_new (guint64, 1);
+  *key = dev;
+  /* frees @key if the index already contains @dev */
+  g_hash_table_insert (table->by_dev, key, list);
+}
 
- out:
-  if (fd >= 0)
-    close (fd);
-  g_free (path);
+static StateEntry *
+state_table_lookup (StateTable  *table,
+                    const gchar *name,
+                    guint64      id)
+{
+  GList *link;
+
+  if (table->info->keyed_by_dev)
+    link = g_hash_table_lookup (table->by_key, &id);
+  else
+    link = g_hash_table_lookup (table->by_key, name);
+
+  return link != NULL ? link->data : NULL;
 }
 
-/* returns TRUE if the entry should be kept */
-static gboolean
-udisks_state_check_mounted_fs_entry (UDisksState  *state,
-                                     GVariant     *value,
-                                     GArray       *devs_to_clean,
-                                     dev_t         match_block_device)
+/* returns the entries with @dev as the value of the table's dev_detail, do not free */
+static GList *
+state_table_lookup_dev (StateTable *table,
+                        guint64     dev)
 {
-  const gchar *mount_point_str;
-  gchar mount_point[PATH_MAX] = { '\0', };
-  GVariant *details;
-  GVariant *block_device_value;
-  dev_t block_device = 0;
-  GVariant *fstab_mount_value;
-  gboolean fstab_mount;
-  gboolean keep;
-  gchar *s;
-  GList *mounts;
-  GList *l;
-  gboolean is_mounted;
-  gboolean device_exists;
-  gboolean device_to_be_cleaned;
-  UDisksMountMonitor *monitor;
-  GUdevClient *udev_client;
-  GUdevDevice *udev_device;
-  guint n;
-  gchar *change_sysfs_path = NULL;
-  UDisksObject *block_object = NULL;
-  gboolean locked;
+  return g_hash_table_lookup (table->by_dev, &dev);
+}
 
-  keep = FALSE;
-  is_mounted = FALSE;
-  device_exists = FALSE;
-  device_to_be_cleaned = FALSE;
-  block_device_value = NULL;
-  fstab_mount_value = NULL;
-  fstab_mount = FALSE;
-  details = NULL;
-  locked = FALSE;
+static GHashTable *
+dev_set_new (void)
+{
+  return g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+}
 
-  monitor = udisks_daemon_get_mount_monitor (state->daemon);
+static void
+dev_set_add (GHashTable *set,
+             guint64     dev)
+{
+  guint64 *key;
 
-  g_variant_get (value,
-                 "{&s@a{sv}}",
-                 &mount_point_str,
-                 &details);
+  if (g_hash_table_contains (set, &dev))
+    return;
+  key = g_new (guint64, 1);
+  *key = dev;
+  g_hash_table_add (set, key);
+}
 
-  block_device_value = lookup_asv (details, "block-device");
-  if (block_device_value == NULL)
-    {
-      s = g_variant_print (value, TRUE);
-      udisks_critical ("udisks_state_check_mounted_fs_entry: mounted-fs entry %s is invalid: no block-device key/value pair", s);
-      g_free (s);
-      goto out;
-    }
-  block_device = g_variant_get_uint64 (block_device_value);
+/* Returns the entries of @table referring to one of the devices in
+ * @match_devs - either as the key, the dev_detail or, for tables keyed
+ * by device file, the device node - or all entries if @match_devs is
+ * %NULL. Free with g_list_free().
+ */
+static GList *
+state_table_get_entries_to_check (StateTable *table,
+                                  GHashTable *match_devs)
+{
+  GList *ret = NULL;
+  GList *l;
 
-  if (match_block_device != 0 && match_block_device != block_device)
-    {
-      /* not intended for this block device, continue with parent iteration */
-      keep = TRUE;
-      goto out;
-    }
+  if (match_devs == NULL)
+    return g_list_copy (table->entries.head);
 
-  block_object = udisks_daemon_find_block (state->daemon, block_device);
-  /* skip locking if called from udisks_state_check_block() */
-  if (block_object != NULL && match_block_device == 0)
+  for (l = table->entries.tail; l != NULL; l = l->prev)
     {
-      if (! udisks_linux_block_object_try_lock_for_cleanup (UDISKS_LINUX_BLOCK_OBJECT (block_object)))
+      StateEntry *entry = l->data;
+      gboolean match = FALSE;
+
+      if (table->info->keyed_by_dev)
+        match = g_hash_table_contains (match_devs, &entry->id);
+      if (!match && table->info->dev_detail != NULL && entry->dev != 0)
+        match = g_hash_table_contains (match_devs, &entry->dev);
+      if (!match && !table->info->keyed_by_dev && table->info->dev_detail == NULL &&
+          g_str_has_prefix (entry->name, "/dev/"))
         {
-          gchar *device_file;
-
-          device_file = udisks_linux_block_object_get_device_file (UDISKS_LINUX_BLOCK_OBJECT (block_object));
-          udisks_notice ("udisks_state_check_mounted_fs_entry: block device %s is busy, skipping cleanup", device_file);
-          g_free (device_file);
+          struct stat statbuf;
+          guint64 rdev;
 
-          keep = TRUE;
-          goto out;
+          /* a missing device node needs checking as well */
+          if (stat (entry->name, &statbuf) != 0 || !S_ISBLK (statbuf.st_mode))
+            {
+              match = TRUE;
+            }
+          else
+            {
+              rdev = statbuf.st_rdev;
+              match = g_hash_table_contains (match_devs, &rdev);
+            }
         }
-      locked = TRUE;
+
+      if (match)
+        ret = g_list_prepend (ret, entry);
     }
 
-  if (realpath (mount_point_str, mount_point) == NULL)
+  return ret;
+}
+
+/* removes @entry from @table without recording it in the journal */
+static void
+state_table_unlink (StateTable *table,
+                    StateEntry *entry)
+{
+  GList *link;
+
+  if (table->info->keyed_by_dev)
     {
-      udisks_critical ("udisks_state_check_mounted_fs_entry: mountpoint %s is invalid, cannot recover the canonical path ", mount_point_str);
+      link = g_hash_table_lookup (table->by_key, &entry->id);
+      g_hash_table_remove (table->by_key, &entry->id);
     }
-
-  fstab_mount_value = lookup_asv (details, "fstab-mount");
-  if (fstab_mount_value == NULL)
+  else
     {
-      s = g_variant_print (value, TRUE);
-      udisks_critical ("udisks_state_check_mounted_fs_entry: mounted-fs entry %s is invalid: no fstab-mount key/value pair", s);
-      g_free (s);
-      goto out;
+      link = g_hash_table_lookup (table->by_key, entry->name);
+      g_hash_table_remove (table->by_key, entry->name);
     }
-  fstab_mount = g_variant_get_boolean (fstab_mount_value);
 
-  /* udisks_debug ("Validating mounted-fs entry for mount point %s", mount_point); */
+  if (table->info->dev_detail != NULL && entry->dev != 0)
+    state_table_set_dev_list (table,
+                              entry->dev,
+                              g_list_remove (state_table_lookup_dev (table, entry->dev), entry));
 
-  /* Figure out if still mounted */
-  mounts = udisks_mount_monitor_get_mounts_for_dev (monitor, block_device);
-  for (l = mounts; l != NULL; l = l->next)
+  g_queue_delete_link (&table->entries, link);
+  state_entry_free (entry);
+}
+
+static void
+state_table_remove (StateTable *table,
+                    StateEntry *entry)
+{
+  state_table_journal (table, STATE_JOURNAL_OP_REMOVE, entry);
+  state_table_unlink (table, entry);
+}
+
+/* Appends a new entry, replacing any existing entry with the same key.
+ * Takes a reference to @details.
+ */
+static StateEntry *
+state_table_insert (StateTable  *table,
+                    const gchar *name,
+                    guint64      id,
+                    GVariant    *details)
+{
+  StateEntry *entry;
+  GVariant *value;
+
+  /* replaced entries don't need a separate record */
+  entry = state_table_lookup (table, name, id);
+  if (entry != NULL)
+    state_table_unlink (table, entry);
+
+  entry = g_new0 (StateEntry, 1);
+  entry->name = g_strdup (name);
+  entry->id = id;
+  entry->details = g_variant_ref_sink (details);
+
+  if (table->info->dev_detail != NULL)
     {
-      UDisksMount *mount = UDISKS_MOUNT (l->data);
-      if (udisks_mount_get_mount_type (mount) == UDISKS_MOUNT_TYPE_FILESYSTEM &&
-          g_strcmp0 (udisks_mount_get_mount_path (mount), mount_point) == 0)
+      value = lookup_asv (details, table->info->dev_detail);
+      if (value != NULL)
         {
-          is_mounted = TRUE;
+          entry->dev = g_variant_get_uint64 (value);
+          g_variant_unref (value);
+        }
+    }
+  if (table->info->uid_detail != NULL)
+    {
+      value = lookup_asv (details, table->info->uid_detail);
+      if (value != NULL)
+        {
+          entry->uid = g_variant_get_uint32 (value);
+          g_variant_unref (value);
+        }
+    }
+
+  g_queue_push_tail (&table->entries, entry);
+  if (table->info->keyed_by_dev)
+    g_hash_table_insert (table->by_key, &entry->id, table->entries.tail);
+  else
+    g_hash_table_insert (table->by_key, entry->name, table->entries.tail);
+
+  if (table->info->dev_detail != NULL && entry->dev != 0)
+    state_table_set_dev_list (table,
+                              entry->dev,
+                              g_list_append (state_table_lookup_dev (table, entry->dev), entry));
+
+  state_table_journal (table, STATE_JOURNAL_OP_SET, entry);
+
+  return entry;
+}
+
+/* returns a '{sa{sv}}' or '{ta{sv}}' GVariant for @entry, free with g_variant_unref() */
+static GVariant *
+state_entry_to_variant (StateTable *table,
+                        StateEntry *entry)
+{
+  GVariant *ret;
+
+  if (table->info->keyed_by_dev)
+    ret = g_variant_new ("{t@a{sv}}", entry->id, entry->details);
+  else
+    ret = g_variant_new ("{s@a{sv}}", entry->name, entry->details);
+
+  return g_variant_ref_sink (ret);
+}
+
+/* returns a floating 'a{sa{sv}}' or 'a{ta{sv}}' GVariant */
+static GVariant *
+state_table_to_variant (StateTable *table)
+{
+  GVariantBuilder builder;
+  GList *l;
+
+  g_variant_builder_init (&builder, table->info->keyed_by_dev ? G_VARIANT_TYPE ("a{ta{sv}}")
+                                                              : G_VARIANT_TYPE ("a{sa{sv}}"));
+  for (l = table->entries.head; l != NULL; l = l->next)
+    {
+      StateEntry *entry = l->data;
+
+      if (table->info->keyed_by_dev)
+        g_variant_builder_add (&builder, "{t@a{sv}}", entry->id, entry->details);
+      else
+        g_variant_builder_add (&builder, "{s@a{sv}}", entry->name, entry->details);
+    }
+
+  return g_variant_builder_end (&builder);
+}
+
+static gchar *
+get_state_journal_path (const gchar *key)
+{
+  gchar *path;
+  gchar *ret;
+
+  path = get_state_file_path (key);
+  ret = g_strconcat (path, UDISKS_STATE_JOURNAL_SUFFIX, NULL);
+  g_free (path);
+  return ret;
+}
+
+static void
+state_table_apply_journal_record (StateTable *table,
+                                  GVariant   *record)
+{
+  guchar op;
+  const gchar *name;
+  guint64 id;
+  GVariant *details;
+  StateEntry *entry;
+
+  g_variant_get (record, "(y&st@a{sv})", &op, &name, &id, &details);
+  switch (op)
+    {
+    case STATE_JOURNAL_OP_SET:
+      state_table_insert (table, table->info->keyed_by_dev ? NULL : name, id, details);
+      break;
+
+    case STATE_JOURNAL_OP_REMOVE:
+      entry = state_table_lookup (table, name, id);
+      if (entry != NULL)
+        state_table_unlink (table, entry);
+      break;
+
+    case STATE_JOURNAL_OP_CLEAR:
+      state_table_clear (table);
+      break;
+
+    default:
+      udisks_warning ("Ignoring unknown record type 0x%02x in state journal %s",
+                      op, table->info->key);
+      break;
+    }
+  g_variant_unref (details);
+}
+
+/* Replays the journal of @table on top of its current entries.
+ *
+ * Returns %FALSE if the journal could not be read completely, e.g. if
+ * the daemon crashed while appending to it.
+ */
+static gboolean
+state_table_replay_journal (StateTable *table,
+                            gboolean   *out_present,
+                            guint      *out_records)
+{
+  gboolean ret = FALSE;
+  gchar *path;
+  gchar *contents = NULL;
+  gsize length = 0;
+  GBytes *bytes = NULL;
+  GError *local_error = NULL;
+  gsize offset;
+
+  *out_present = FALSE;
+  *out_records = 0;
+
+  path = get_state_journal_path (table->info->key);
+  if (!g_file_get_contents (path,
+                            &contents,
+                            &length,
+                            &local_error))
+    {
+      if (local_error->domain == G_FILE_ERROR && local_error->code == G_FILE_ERROR_NOENT)
+        {
+          /* this is not an error */
+          g_clear_error (&local_error);
+          ret = TRUE;
+          goto out;
+        }
+
+      udisks_warning ("Error getting state journal %s: %s (%s, %d)",
+                      table->info->key,
+                      local_error->message,
+                      g_quark_to_string (local_error->domain),
+                      local_error->code);
+      g_clear_error (&local_error);
+      *out_present = TRUE;
+      goto out;
+    }
+  *out_present = TRUE;
+  bytes = g_bytes_new_take (contents, length);
+
+  if (length < strlen (UDISKS_STATE_JOURNAL_MAGIC) ||
+      memcmp (contents, UDISKS_STATE_JOURNAL_MAGIC, strlen (UDISKS_STATE_JOURNAL_MAGIC)) != 0)
+    {
+      udisks_warning ("Ignoring state journal %s in an unknown format", table->info->key);
+      goto out;
+    }
+
+  offset = strlen (UDISKS_STATE_JOURNAL_MAGIC);
+  while (offset < length)
+    {
+      guint32 size;
+      GBytes *slice;
+      GVariant *record;
+
+      if (length - offset < 8)
+        break;
+      memcpy (&size, contents + offset, sizeof (size));
+      size = GUINT32_FROM_LE (size);
+      if (size > length - offset - 8)
+        break;
+      offset += 8;
+
+      /* records are 8-byte aligned, as are the buffers of g_file_get_contents() */
+      slice = g_bytes_new_from_bytes (bytes, offset, size);
+      record = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE ("(ysta{sv})"), slice, FALSE));
+      state_table_apply_journal_record (table, record);
+      g_variant_unref (record);
+      g_bytes_unref (slice);
+
+      offset += MIN (length - offset, (size + 7) & ~7);
+      *out_records += 1;
+    }
+
+  if (offset < length)
+    {
+      udisks_warning ("Ignoring %" G_GSIZE_FORMAT " trailing bytes of truncated state journal %s",
+                      length - offset, table->info->key);
+      goto out;
+    }
+
+  ret = TRUE;
+
+ out:
+  if (bytes != NULL)
+    g_bytes_unref (bytes);
+  g_free (path);
+  return ret;
+}
+
+/* Returns %TRUE if the files of @table need to be written out again,
+ * i.e. if the journal needs to be compacted or folded into the file.
+ */
+static gboolean
+state_table_load (StateTable *table)
+{
+  gchar *path;
+  gchar *contents = NULL;
+  gsize length = 0;
+  GError *local_error = NULL;
+  GVariant *value;
+  GVariantIter iter;
+  GVariant *details;
+  const GVariantType *type;
+  gboolean journal_intact;
+  gboolean journal_present;
+  guint journal_records;
+
+  path = get_state_file_path (table->info->key);
+  if (!g_file_get_contents (path,
+                            &contents,
+                            &length,
+                            &local_error))
+    {
+      if (local_error->domain != G_FILE_ERROR || local_error->code != G_FILE_ERROR_NOENT)
+        {
+          udisks_warning ("Error getting state data %s: %s (%s, %d)",
+                          table->info->key,
+                          local_error->message,
+                          g_quark_to_string (local_error->domain),
+                          local_error->code);
+        }
+      /* a missing file is not an error */
+      g_clear_error (&local_error);
+      goto journal;
+    }
+
+  type = table->info->keyed_by_dev ? G_VARIANT_TYPE ("a{ta{sv}}") : G_VARIANT_TYPE ("a{sa{sv}}");
+  value = g_variant_new_from_data (type,
+                                   (gconstpointer) contents,
+                                   length,
+                                   FALSE,
+                                   g_free,
+                                   contents);
+  contents = NULL; /* ownership transfered to the GVariant */
+  g_variant_ref_sink (value);
+
+  g_variant_iter_init (&iter, value);
+  if (table->info->keyed_by_dev)
+    {
+      guint64 id;
+      while (g_variant_iter_next (&iter, "{t@a{sv}}", &id, &details))
+        {
+          state_table_insert (table, NULL, id, details);
+          g_variant_unref (details);
+        }
+    }
+  else
+    {
+      const gchar *name;
+      while (g_variant_iter_next (&iter, "{&s@a{sv}}", &name, &details))
+        {
+          state_table_insert (table, name, 0, details);
+          g_variant_unref (details);
+        }
+    }
+  g_variant_unref (value);
+
+ journal:
+  /* the journal is replayed even if journaling is disabled, to pick up
+   * changes made while it was enabled
+   */
+  journal_intact = state_table_replay_journal (table, &journal_present, &journal_records);
+  table->journal_present = journal_present;
+  table->journal_records = journal_intact ? journal_records : G_MAXUINT;
+
+  g_free (contents);
+  g_free (path);
+
+  return journal_present && (!table->journal || !journal_intact);
+}
+
+/* called with state->lock held, loads the table on first use */
+static StateTable *
+get_table (UDisksState  *state,
+           StateTableId  table_id)
+{
+  StateTable *table = &state->tables[table_id];
+
+  if (!table->loaded)
+    {
+      gboolean need_write;
+
+      need_write = state_table_load (table);
+      table->loaded = TRUE;
+      if (need_write)
+        state_table_mark_dirty (state, table);
+    }
+
+  return table;
+}
+
+/* called with state->lock held, schedules writing @table to disk */
+static void
+state_table_mark_dirty (UDisksState *state,
+                        StateTable  *table)
+{
+  table->dirty = TRUE;
+
+  g_mutex_lock (&state->writer_lock);
+  state->writer_pending = TRUE;
+  g_cond_broadcast (&state->writer_cond);
+  g_mutex_unlock (&state->writer_lock);
+}
+
+/* writes @value to the state file for @key, or removes the file if @value is %NULL */
+static gboolean
+write_state_file (const gchar *key,
+                  GVariant    *value)
+{
+  gboolean ret = FALSE;
+  gsize size;
+  gchar *path;
+  gchar *data = NULL;
+  GVariant *normalized = NULL;
+  GError *error = NULL;
+
+  path = get_state_file_path (key);
+
+  if (value == NULL)
+    {
+      if (g_unlink (path) != 0 && errno != ENOENT)
+        {
+          udisks_warning ("Error removing state file %s: %m", path);
+          goto out;
+        }
+      ret = TRUE;
+      goto out;
+    }
+
+  normalized = g_variant_get_normal_form (value);
+  size = g_variant_get_size (normalized);
+  data = g_malloc (size);
+  g_variant_store (normalized, data);
+
+  if (!g_file_set_contents (path,
+                            data,
+                            size,
+                            &error))
+    {
+      udisks_warning ("Error setting state data %s: %s (%s, %d)", key,
+                     error->message,
+                     g_quark_to_string (error->domain),
+                     error->code);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  ret = TRUE;
+
+ out:
+  g_free (path);
+  g_free (data);
+  if (normalized != NULL)
+    g_variant_unref (normalized);
+  return ret;
+}
+
+/* appends @record to @buf, prefixed with its size and padded to 8 bytes */
+static void
+journal_append_record (GByteArray *buf,
+                       GVariant   *record)
+{
+  static const guint8 padding[8] = { 0, };
+  GVariant *normalized;
+  guint32 header[2];
+  gsize size;
+  guint offset;
+
+  normalized = g_variant_get_normal_form (record);
+  size = g_variant_get_size (normalized);
+
+  header[0] = GUINT32_TO_LE ((guint32) size);
+  header[1] = 0;
+  g_byte_array_append (buf, (const guint8 *) header, sizeof (header));
+
+  offset = buf->len;
+  g_byte_array_set_size (buf, offset + size);
+  g_variant_store (normalized, buf->data + offset);
+  if (size % 8 != 0)
+    g_byte_array_append (buf, padding, 8 - size % 8);
+
+  g_variant_unref (normalized);
+}
+
+static gboolean
+write_all (gint          fd,
+           const guint8 *data,
+           gsize         length)
+{
+  while (length > 0)
+    {
+      gssize written;
+
+      written = write (fd, data, length);
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return FALSE;
+        }
+      data += written;
+      length -= written;
+    }
+  return TRUE;
+}
+
+/* appends @records to the journal for @key */
+static gboolean
+append_state_journal (const gchar *key,
+                      GList       *records)
+{
+  gboolean ret = FALSE;
+  gchar *path;
+  GByteArray *buf;
+  struct stat statbuf;
+  gint fd = -1;
+  GList *l;
+
+  path = get_state_journal_path (key);
+
+  buf = g_byte_array_new ();
+  for (l = records; l != NULL; l = l->next)
+    journal_append_record (buf, l->data);
+
+  fd = open (path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0)
+    {
+      udisks_warning ("Error opening state journal %s: %m", path);
+      goto out;
+    }
+  if (fstat (fd, &statbuf) != 0)
+    {
+      udisks_warning ("Error statting state journal %s: %m", path);
+      goto out;
+    }
+  /* don't append to a journal with an incomplete record at the end */
+  if (statbuf.st_size % 8 != 0)
+    {
+      udisks_warning ("State journal %s is truncated", path);
+      goto out;
+    }
+  if (statbuf.st_size == 0 &&
+      !write_all (fd, (const guint8 *) UDISKS_STATE_JOURNAL_MAGIC, strlen (UDISKS_STATE_JOURNAL_MAGIC)))
+    {
+      udisks_warning ("Error writing state journal %s: %m", path);
+      goto out;
+    }
+  if (!write_all (fd, buf->data, buf->len))
+    {
+      udisks_warning ("Error writing state journal %s: %m", path);
+      goto out;
+    }
+  if (fdatasync (fd) != 0)
+    {
+      udisks_warning ("Error syncing state journal %s: %m", path);
+      goto out;
+    }
+
+  ret = TRUE;
+
+ out:
+  if (fd >= 0)
+    close (fd);
+  g_byte_array_unref (buf);
+  g_free (path);
+  return ret;
+}
+
+/* Atomically replaces the journal for @info with a record clearing the
+ * table followed by one record for each entry in @value (may be %NULL).
+ * Since replaying it yields @value no matter what the state file
+ * contains, the state file can then be rewritten or removed safely.
+ */
+static gboolean
+write_compacted_state_journal (const StateTableInfo *info,
+                               GVariant             *value)
+{
+  gboolean ret = FALSE;
+  gchar *path;
+  GByteArray *buf;
+  GVariant *record;
+  GVariantIter iter;
+  GVariant *details;
+  GError *error = NULL;
+
+  path = get_state_journal_path (info->key);
+
+  buf = g_byte_array_new ();
+  g_byte_array_append (buf, (const guint8 *) UDISKS_STATE_JOURNAL_MAGIC, strlen (UDISKS_STATE_JOURNAL_MAGIC));
+
+  record = g_variant_ref_sink (g_variant_new ("(yst@a{sv})",
+                                              (guchar) STATE_JOURNAL_OP_CLEAR,
+                                              "",
+                                              (guint64) 0,
+                                              g_variant_new ("a{sv}", NULL)));
+  journal_append_record (buf, record);
+  g_variant_unref (record);
+
+  if (value != NULL)
+    {
+      g_variant_iter_init (&iter, value);
+      if (info->keyed_by_dev)
+        {
+          guint64 id;
+          while (g_variant_iter_next (&iter, "{t@a{sv}}", &id, &details))
+            {
+              record = g_variant_new ("(yst@a{sv})", (guchar) STATE_JOURNAL_OP_SET, "", id, details);
+              journal_append_record (buf, g_variant_ref_sink (record));
+              g_variant_unref (record);
+              g_variant_unref (details);
+            }
+        }
+      else
+        {
+          const gchar *name;
+          while (g_variant_iter_next (&iter, "{&s@a{sv}}", &name, &details))
+            {
+              record = g_variant_new ("(yst@a{sv})", (guchar) STATE_JOURNAL_OP_SET, name, (guint64) 0, details);
+              journal_append_record (buf, g_variant_ref_sink (record));
+              g_variant_unref (record);
+              g_variant_unref (details);
+            }
+        }
+    }
+
+  if (!g_file_set_contents (path,
+                            (const gchar *) buf->data,
+                            buf->len,
+                            &error))
+    {
+      udisks_warning ("Error compacting state journal %s: %s (%s, %d)", info->key,
+                      error->message,
+                      g_quark_to_string (error->domain),
+                      error->code);
+      g_clear_error (&error);
+      goto out;
+    }
+
+  ret = TRUE;
+
+ out:
+  g_byte_array_unref (buf);
+  g_free (path);
+  return ret;
+}
+
+static void
+remove_state_journal (const gchar *key)
+{
+  gchar *path;
+
+  path = get_state_journal_path (key);
+  if (g_unlink (path) != 0 && errno != ENOENT)
+    udisks_warning ("Error removing state journal %s: %m", path);
+  g_free (path);
+}
+
+/* Writes @value (%NULL if there are no entries) out in full - into a
+ * compacted journal if @journal is %TRUE, into the state file otherwise.
+ * Returns %FALSE if @value didn't make it to disk.
+ */
+static gboolean
+write_state_table (const StateTableInfo *info,
+                   GVariant             *value,
+                   gboolean              journal,
+                   gboolean              journal_present)
+{
+  if (journal || journal_present)
+    {
+      if (!write_compacted_state_journal (info, value))
+        return FALSE;
+    }
+
+  if (journal)
+    {
+      /* the journal now holds everything */
+      write_state_file (info->key, NULL);
+      if (value == NULL)
+        remove_state_journal (info->key);
+    }
+  else
+    {
+      if (!write_state_file (info->key, value))
+        return FALSE;
+      if (journal_present)
+        remove_state_journal (info->key);
+    }
+
+  return TRUE;
+}
+
+/* Takes a snapshot of all dirty tables and writes them to disk. Only ever
+ * called from the writer thread so the snapshots are written in order.
+ *
+ * With journaling, only the changes since the last write are appended
+ * unless the journal has grown large enough to be compacted.
+ */
+static void
+write_dirty_tables (UDisksState *state)
+{
+  GVariant *values[N_STATE_TABLES] = { NULL, };
+  GList *records[N_STATE_TABLES] = { NULL, };
+  gboolean dirty[N_STATE_TABLES] = { FALSE, };
+  gboolean append[N_STATE_TABLES] = { FALSE, };
+  gboolean journal[N_STATE_TABLES] = { FALSE, };
+  gboolean journal_present[N_STATE_TABLES] = { FALSE, };
+  guint n;
+
+  g_mutex_lock (&state->lock);
+  for (n = 0; n < N_STATE_TABLES; n++)
+    {
+      StateTable *table = &state->tables[n];
+      guint n_entries;
+
+      if (!table->dirty)
+        continue;
+      dirty[n] = TRUE;
+      journal[n] = table->journal;
+      journal_present[n] = table->journal_present;
+
+      n_entries = g_queue_get_length (&table->entries);
+      if (table->journal &&
+          table->journal_records != G_MAXUINT &&
+          table->journal_records + g_queue_get_length (&table->journal_pending) <=
+          MAX (UDISKS_STATE_JOURNAL_MAX_RECORDS, 2 * n_entries))
+        {
+          append[n] = TRUE;
+          records[n] = table->journal_pending.head;
+          table->journal_records += g_queue_get_length (&table->journal_pending);
+          g_queue_init (&table->journal_pending);
+          if (records[n] != NULL)
+            table->journal_present = TRUE;
+        }
+      else
+        {
+          /* a missing file is the same as an empty one */
+          if (n_entries > 0)
+            values[n] = g_variant_ref_sink (state_table_to_variant (table));
+          while (!g_queue_is_empty (&table->journal_pending))
+            g_variant_unref (g_queue_pop_head (&table->journal_pending));
+          table->journal_records = n_entries + 1;
+          table->journal_present = table->journal && n_entries > 0;
+        }
+      table->dirty = FALSE;
+    }
+  g_mutex_unlock (&state->lock);
+
+  for (n = 0; n < N_STATE_TABLES; n++)
+    {
+      if (!dirty[n])
+        continue;
+
+      if (append[n])
+        {
+          if (records[n] != NULL && !append_state_journal (state_table_info[n].key, records[n]))
+            {
+              /* the records are in the in-memory table, compact to get them on disk */
+              g_mutex_lock (&state->lock);
+              state->tables[n].journal_records = G_MAXUINT;
+              state->tables[n].journal_present = TRUE;
+              state_table_mark_dirty (state, &state->tables[n]);
+              g_mutex_unlock (&state->lock);
+            }
+          g_list_free_full (records[n], (GDestroyNotify) g_variant_unref);
+        }
+      else
+        {
+          if (!write_state_table (&state_table_info[n], values[n], journal[n], journal_present[n]))
+            {
+              /* the journal on disk wasn't replaced, don't append to it but retry the full write */
+              g_mutex_lock (&state->lock);
+              state->tables[n].journal_records = G_MAXUINT;
+              state->tables[n].journal_present = journal_present[n] || state->tables[n].journal_present;
+              state_table_mark_dirty (state, &state->tables[n]);
+              g_mutex_unlock (&state->lock);
+            }
+          if (values[n] != NULL)
+            g_variant_unref (values[n]);
+        }
+    }
+}
+
+static gpointer
+udisks_state_writer_thread_func (gpointer user_data)
+{
+  UDisksState *state = UDISKS_STATE (user_data);
+  gboolean quit = FALSE;
+  gint64 end_time;
+
+  g_mutex_lock (&state->writer_lock);
+  while (!quit)
+    {
+      while (!state->writer_pending && !state->writer_quit)
+        g_cond_wait (&state->writer_cond, &state->writer_lock);
+
+      /* coalesce a burst of changes into a single write of each file */
+      end_time = g_get_monotonic_time () + UDISKS_STATE_WRITE_BEHIND_DELAY_USEC;
+      while (!state->writer_quit &&
+             g_cond_wait_until (&state->writer_cond, &state->writer_lock, end_time))
+        ;
+
+      quit = state->writer_quit;
+      state->writer_pending = FALSE;
+      g_mutex_unlock (&state->writer_lock);
+
+      write_dirty_tables (state);
+
+      g_mutex_lock (&state->writer_lock);
+    }
+  g_mutex_unlock (&state->writer_lock);
+
+  return NULL;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static void
+trigger_change_uevent (const gchar *sysfs_path)
+{
+  gchar* path = NULL;
+  gint fd = -1;
+
+  g_return_if_fail (sysfs_path != NULL);
+
+  path = g_strconcat (sysfs_path, "/uevent", NULL);
+  fd = open (path, O_WRONLY);
+  if (fd < 0)
+    {
+      udisks_warning ("Error opening %s for trigerring change uevent: %m", path);
+      goto out;
+    }
+
+  if (write (fd, "change", sizeof "change" - 1) != sizeof "change" - 1)
+    {
+      udisks_warning ("Error writing 'change' to file %s: %m", path);
+      goto out;
+    }
+
+ out:
+  if (fd >= 0)
+    close (fd);
+  g_free (path);
+}
+
+/* returns TRUE if the entry should be kept */
+static gboolean
+udisks_state_check_mounted_fs_entry (UDisksState  *state,
+                                     GVariant     *value,
+                                     GArray       *devs_to_clean,
+                                     dev_t         match_block_device)
+{
+  const gchar *mount_point_str;
+  gchar mount_point[PATH_MAX] = { '\0', };
+  GVariant *details;
+  GVariant *block_device_value;
+  dev_t block_device = 0;
+  GVariant *fstab_mount_value;
+  gboolean fstab_mount;
+  gboolean keep;
+  gchar *s;
+  GList *mounts;
+  GList *l;
+  gboolean is_mounted;
+  gboolean device_exists;
+  gboolean device_to_be_cleaned;
+  UDisksMountMonitor *monitor;
+  GUdevClient *udev_client;
+  GUdevDevice *udev_device;
+  guint n;
+  gchar *change_sysfs_path = NULL;
+  UDisksObject *block_object = NULL;
+  gboolean locked;
+
+  keep = FALSE;
+  is_mounted = FALSE;
+  device_exists = FALSE;
+  device_to_be_cleaned = FALSE;
+  block_device_value = NULL;
+  fstab_mount_value = NULL;
+  fstab_mount = FALSE;
+  details = NULL;
+  locked = FALSE;
+
+  monitor = udisks_daemon_get_mount_monitor (state->daemon);
+
+  g_variant_get (value,
+                 "{&s@a{sv}}",
+                 &mount_point_str,
+                 &details);
+
+  block_device_value = lookup_asv (details, "block-device");
+  if (block_device_value == NULL)
+    {
+      s = g_variant_print (value, TRUE);
+      udisks_critical ("udisks_state_check_mounted_fs_entry: mounted-fs entry %s is invalid: no block-device key/value pair", s);
+      g_free (s);
+      goto out;
+    }
+  block_device = g_variant_get_uint64 (block_device_value);
+
+  if (match_block_device != 0 && match_block_device != block_device)
+    {
+      /* not intended for this block device, continue with parent iteration */
+      keep = TRUE;
+      goto out;
+    }
+
+  block_object = udisks_daemon_find_block (state->daemon, block_device);
+  /* skip locking if called from udisks_state_check_block() */
+  if (block_object != NULL && match_block_device == 0)
+    {
+      if (! udisks_linux_block_object_try_lock_for_cleanup (UDISKS_LINUX_BLOCK_OBJECT (block_object)))
+        {
+          gchar *device_file;
+
+          device_file = udisks_linux_block_object_get_device_file (UDISKS_LINUX_BLOCK_OBJECT (block_object));
+          udisks_notice ("udisks_state_check_mounted_fs_entry: block device %s is busy, skipping cleanup", device_file);
+          g_free (device_file);
+
+          keep = TRUE;
+          goto out;
+        }
+      locked = TRUE;
+    }
+
+  if (realpath (mount_point_str, mount_point) == NULL)
+    {
+      udisks_critical ("udisks_state_check_mounted_fs_entry: mountpoint %s is invalid, cannot recover the canonical path ", mount_point_str);
+    }
+
+  fstab_mount_value = lookup_asv (details, "fstab-mount");
+  if (fstab_mount_value == NULL)
+    {
+      s = g_variant_print (value, TRUE);
+      udisks_critical ("udisks_state_check_mounted_fs_entry: mounted-fs entry %s is invalid: no fstab-mount key/value pair", s);
+      g_free (s);
+      goto out;
+    }
+  fstab_mount = g_variant_get_boolean (fstab_mount_value);
+
+  /* udisks_debug ("Validating mounted-fs entry for mount point %s", mount_point); */
+
+  /* Figure out if still mounted */
+  mounts = udisks_mount_monitor_get_mounts_for_dev (monitor, block_device);
+  for (l = mounts; l != NULL; l = l->next)
+    {
+      UDisksMount *mount = UDISKS_MOUNT (l->data);
+      if (udisks_mount_get_mount_type (mount) == UDISKS_MOUNT_TYPE_FILESYSTEM &&
+          g_strcmp0 (udisks_mount_get_mount_path (mount), mount_point) == 0)
+        {
+          is_mounted = TRUE;
           break;
         }
     }
@@ -933,55 +2207,39 @@ udisks_state_check_mounted_fs_entry (UDisksState  *state,
 
 /* called with mutex->lock held */
 static void
-udisks_state_check_mounted_fs (UDisksState *state,
-                               const gchar *key,
-                               GArray      *devs_to_clean,
-                               dev_t        match_block_device)
+udisks_state_check_mounted_fs (UDisksState  *state,
+                               StateTableId  table_id,
+                               GArray       *devs_to_clean,
+                               dev_t         match_block_device,
+                               GHashTable   *match_devs)
 {
-  gboolean changed;
-  GVariant *value;
-  GVariant *new_value;
-  GVariantBuilder builder;
+  StateTable *table;
+  GList *entries;
+  GList *l;
 
-  changed = FALSE;
+  table = get_table (state, table_id);
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            key,
-                            G_VARIANT_TYPE ("a{sa{sv}}"));
+  /* only the entries for @match_block_device need to be checked, if given */
+  if (match_block_device != 0)
+    entries = g_list_copy (state_table_lookup_dev (table, match_block_device));
+  else
+    entries = state_table_get_entries_to_check (table, match_devs);
 
   /* check valid entries */
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
-  if (value != NULL)
+  for (l = entries; l != NULL; l = l->next)
     {
-      GVariantIter iter;
+      StateEntry *entry = l->data;
       GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
+
+      child = state_entry_to_variant (table, entry);
+      if (!udisks_state_check_mounted_fs_entry (state, child, devs_to_clean, match_block_device))
         {
-          if (udisks_state_check_mounted_fs_entry (state, child, devs_to_clean, match_block_device))
-            g_variant_builder_add_value (&builder, child);
-          else
-            changed = TRUE;
-          g_variant_unref (child);
+          state_table_remove (table, entry);
+          state_table_mark_dirty (state, table);
         }
-      g_variant_unref (value);
-    }
-
-  new_value = g_variant_builder_end (&builder);
-
-  /* save new entries */
-  if (changed)
-    {
-      udisks_state_set (state,
-                        key,
-                        G_VARIANT_TYPE ("a{sa{sv}}"),
-                        new_value /* consumes new_value */);
-    }
-  else
-    {
-      g_variant_unref (new_value);
+      g_variant_unref (child);
     }
+  g_list_free (entries);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1006,10 +2264,7 @@ udisks_state_add_mounted_fs (UDisksState    *state,
                              gboolean        fstab_mount,
                              gboolean        persistent)
 {
-  GVariant *value;
-  GVariant *new_value;
-  GVariant *details_value;
-  GVariantBuilder builder;
+  StateTable *table;
   GVariantBuilder details_builder;
 
   g_return_if_fail (UDISKS_IS_STATE (state));
@@ -1017,36 +2272,13 @@ udisks_state_add_mounted_fs (UDisksState    *state,
 
   g_mutex_lock (&state->lock);
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            persistent ? UDISKS_STATE_FILE_MOUNTED_FS_PERSISTENT : UDISKS_STATE_FILE_MOUNTED_FS,
-                            G_VARIANT_TYPE ("a{sa{sv}}"));
+  table = get_table (state, persistent ? STATE_TABLE_MOUNTED_FS_PERSISTENT : STATE_TABLE_MOUNTED_FS);
 
-  /* start by including existing entries */
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
-  if (value != NULL)
+  /* Skip/remove stale entries */
+  if (state_table_lookup (table, mount_point, 0) != NULL)
     {
-      GVariantIter iter;
-      GVariant *child;
-
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
-        {
-          const gchar *entry_mount_point;
-          g_variant_get (child, "{&s@a{sv}}", &entry_mount_point, NULL);
-          /* Skip/remove stale entries */
-          if (g_strcmp0 (entry_mount_point, mount_point) == 0)
-            {
-              udisks_warning ("Removing stale entry for mount point `%s' in /run/udisks/mounted-fs file",
-                              entry_mount_point);
-            }
-          else
-            {
-              g_variant_builder_add_value (&builder, child);
-            }
-          g_variant_unref (child);
-        }
-      g_variant_unref (value);
+      udisks_warning ("Removing stale entry for mount point `%s' in /run/udisks/mounted-fs file",
+                      mount_point);
     }
 
   /* build the details */
@@ -1063,20 +2295,10 @@ udisks_state_add_mounted_fs (UDisksState    *state,
                          "{sv}",
                          "fstab-mount",
                          g_variant_new_boolean (fstab_mount));
-  details_value = g_variant_builder_end (&details_builder);
-
-  /* finally add the new entry */
-  g_variant_builder_add (&builder,
-                         "{s@a{sv}}",
-                         mount_point,
-                         details_value); /* consumes details_value */
-  new_value = g_variant_builder_end (&builder);
 
-  /* save new entries */
-  udisks_state_set (state,
-                    persistent ? UDISKS_STATE_FILE_MOUNTED_FS_PERSISTENT : UDISKS_STATE_FILE_MOUNTED_FS,
-                    G_VARIANT_TYPE ("a{sa{sv}}"),
-                    new_value /* consumes new_value */);
+  /* finally add the new entry, replacing any stale one */
+  state_table_insert (table, mount_point, 0, g_variant_builder_end (&details_builder));
+  state_table_mark_dirty (state, table);
 
   g_mutex_unlock (&state->lock);
 }
@@ -1084,82 +2306,36 @@ udisks_state_add_mounted_fs (UDisksState    *state,
 /* called with state->lock held */
 static gchar *
 find_mounted_fs_for_key (UDisksState   *state,
-                         const gchar   *key,
+                         StateTableId   table_id,
                          dev_t          block_device,
                          uid_t         *out_uid,
                          gboolean      *out_fstab_mount)
 {
-  gchar *ret = NULL;
-  GVariant *value;
-
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            key,
-                            G_VARIANT_TYPE ("a{sa{sv}}"));
-
-  /* look through list */
-  if (value != NULL)
+  StateTable *table;
+  StateEntry *entry;
+  GList *entries;
+
+  table = get_table (state, table_id);
+  entries = state_table_lookup_dev (table, block_device);
+  if (entries == NULL)
+    return NULL;
+
+  entry = entries->data;
+  if (out_uid != NULL)
+    *out_uid = entry->uid;
+  if (out_fstab_mount != NULL)
     {
-      GVariantIter iter;
-      GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
+      GVariant *lookup_value;
+      lookup_value = lookup_asv (entry->details, "fstab-mount");
+      *out_fstab_mount = FALSE;
+      if (lookup_value != NULL)
         {
-          const gchar *mount_point;
-          GVariant *details;
-          GVariant *block_device_value;
-
-          g_variant_get (child,
-                         "{&s@a{sv}}",
-                         &mount_point,
-                         &details);
-
-          block_device_value = lookup_asv (details, "block-device");
-          if (block_device_value != NULL)
-            {
-              dev_t iter_block_device;
-              iter_block_device = g_variant_get_uint64 (block_device_value);
-              if (iter_block_device == block_device)
-                {
-                  ret = g_strdup (mount_point);
-                  if (out_uid != NULL)
-                    {
-                      GVariant *lookup_value;
-                      lookup_value = lookup_asv (details, "mounted-by-uid");
-                      *out_uid = 0;
-                      if (lookup_value != NULL)
-                        {
-                          *out_uid = g_variant_get_uint32 (lookup_value);
-                          g_variant_unref (lookup_value);
-                        }
-                    }
-                  if (out_fstab_mount != NULL)
-                    {
-                      GVariant *lookup_value;
-                      lookup_value = lookup_asv (details, "fstab-mount");
-                      *out_fstab_mount = FALSE;
-                      if (lookup_value != NULL)
-                        {
-                          *out_fstab_mount = g_variant_get_boolean (lookup_value);
-                          g_variant_unref (lookup_value);
-                        }
-                    }
-                  g_variant_unref (block_device_value);
-                  g_variant_unref (details);
-                  g_variant_unref (child);
-                  goto out;
-                }
-              g_variant_unref (block_device_value);
-            }
-          g_variant_unref (details);
-          g_variant_unref (child);
+          *out_fstab_mount = g_variant_get_boolean (lookup_value);
+          g_variant_unref (lookup_value);
         }
     }
 
- out:
-  if (value != NULL)
-    g_variant_unref (value);
-  return ret;
+  return g_strdup (entry->name);
 }
 
 /**
@@ -1187,13 +2363,13 @@ udisks_state_find_mounted_fs (UDisksState   *state,
   g_mutex_lock (&state->lock);
 
   ret = find_mounted_fs_for_key (state,
-                                 UDISKS_STATE_FILE_MOUNTED_FS,
+                                 STATE_TABLE_MOUNTED_FS,
                                  block_device,
                                  out_uid,
                                  out_fstab_mount);
   if (ret == NULL)
     ret = find_mounted_fs_for_key (state,
-                                   UDISKS_STATE_FILE_MOUNTED_FS_PERSISTENT,
+                                   STATE_TABLE_MOUNTED_FS_PERSISTENT,
                                    block_device,
                                    out_uid,
                                    out_fstab_mount);
@@ -1369,52 +2545,31 @@ udisks_state_check_unlocked_crypto_dev_entry (UDisksState  *state,
 static void
 udisks_state_check_unlocked_crypto_dev (UDisksState *state,
                                         gboolean     check_only,
-                                        GArray      *devs_to_clean)
+                                        GArray      *devs_to_clean,
+                                        GHashTable  *match_devs)
 {
-  gboolean changed;
-  GVariant *value;
-  GVariant *new_value;
-  GVariantBuilder builder;
-
-  changed = FALSE;
+  StateTable *table;
+  GList *entries;
+  GList *l;
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_UNLOCKED_CRYPTO_DEV,
-                            G_VARIANT_TYPE ("a{ta{sv}}"));
+  table = get_table (state, STATE_TABLE_UNLOCKED_CRYPTO_DEV);
 
   /* check valid entries */
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ta{sv}}"));
-  if (value != NULL)
+  entries = state_table_get_entries_to_check (table, match_devs);
+  for (l = entries; l != NULL; l = l->next)
     {
-      GVariantIter iter;
+      StateEntry *entry = l->data;
       GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
+
+      child = state_entry_to_variant (table, entry);
+      if (!udisks_state_check_unlocked_crypto_dev_entry (state, child, check_only, devs_to_clean))
         {
-          if (udisks_state_check_unlocked_crypto_dev_entry (state, child, check_only, devs_to_clean))
-            g_variant_builder_add_value (&builder, child);
-          else
-            changed = TRUE;
-          g_variant_unref (child);
+          state_table_remove (table, entry);
+          state_table_mark_dirty (state, table);
         }
-      g_variant_unref (value);
-    }
-
-  new_value = g_variant_builder_end (&builder);
-
-  /* save new entries */
-  if (changed)
-    {
-      udisks_state_set (state,
-                        UDISKS_STATE_FILE_UNLOCKED_CRYPTO_DEV,
-                        G_VARIANT_TYPE ("a{ta{sv}}"),
-                        new_value /* consumes new_value */);
-    }
-  else
-    {
-      g_variant_unref (new_value);
+      g_variant_unref (child);
     }
+  g_list_free (entries);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1437,10 +2592,7 @@ udisks_state_add_unlocked_crypto_dev (UDisksState  *state,
                                       const gchar  *dm_uuid,
                                       uid_t         uid)
 {
-  GVariant *value;
-  GVariant *new_value;
-  GVariant *details_value;
-  GVariantBuilder builder;
+  StateTable *table;
   GVariantBuilder details_builder;
 
   g_return_if_fail (UDISKS_IS_STATE (state));
@@ -1448,36 +2600,14 @@ udisks_state_add_unlocked_crypto_dev (UDisksState  *state,
 
   g_mutex_lock (&state->lock);
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_UNLOCKED_CRYPTO_DEV,
-                            G_VARIANT_TYPE ("a{ta{sv}}"));
+  table = get_table (state, STATE_TABLE_UNLOCKED_CRYPTO_DEV);
 
-  /* start by including existing entries */
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ta{sv}}"));
-  if (value != NULL)
+  /* Skip/remove stale entries */
+  if (state_table_lookup (table, NULL, cleartext_device) != NULL)
     {
-      GVariantIter iter;
-      GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
-        {
-          guint64 entry_cleartext_device;
-          g_variant_get (child, "{t@a{sv}}", &entry_cleartext_device, NULL);
-          /* Skip/remove stale entries */
-          if ((dev_t) entry_cleartext_device == cleartext_device)
-            {
-              udisks_warning ("Removing stale entry for cleartext device %d:%d in /run/udisks2/unlocked-crypto-dev file",
-                              (gint) major (entry_cleartext_device),
-                              (gint) minor (entry_cleartext_device));
-            }
-          else
-            {
-              g_variant_builder_add_value (&builder, child);
-            }
-          g_variant_unref (child);
-        }
-      g_variant_unref (value);
+      udisks_warning ("Removing stale entry for cleartext device %d:%d in /run/udisks2/unlocked-crypto-dev file",
+                      (gint) major (cleartext_device),
+                      (gint) minor (cleartext_device));
     }
 
   /* build the details */
@@ -1494,20 +2624,10 @@ udisks_state_add_unlocked_crypto_dev (UDisksState  *state,
                          "{sv}",
                          "unlocked-by-uid",
                          g_variant_new_uint32 (uid));
-  details_value = g_variant_builder_end (&details_builder);
 
-  /* finally add the new entry */
-  g_variant_builder_add (&builder,
-                         "{t@a{sv}}",
-                         (guint64) cleartext_device,
-                         details_value); /* consumes details_value */
-  new_value = g_variant_builder_end (&builder);
-
-  /* save new entries */
-  udisks_state_set (state,
-                    UDISKS_STATE_FILE_UNLOCKED_CRYPTO_DEV,
-                    G_VARIANT_TYPE ("a{ta{sv}}"),
-                    new_value /* consumes new_value */);
+  /* finally add the new entry, replacing any stale one */
+  state_table_insert (table, NULL, cleartext_device, g_variant_builder_end (&details_builder));
+  state_table_mark_dirty (state, table);
 
   g_mutex_unlock (&state->lock);
 }
@@ -1528,72 +2648,23 @@ udisks_state_find_unlocked_crypto_dev (UDisksState   *state,
                                        dev_t          crypto_device,
                                        uid_t         *out_uid)
 {
-  dev_t ret;
-  GVariant *value;
-
-  g_return_val_if_fail (UDISKS_IS_STATE (state), 0);
-
-  g_mutex_lock (&state->lock);
-
-  ret = 0;
-  value = NULL;
-
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_UNLOCKED_CRYPTO_DEV,
-                            G_VARIANT_TYPE ("a{ta{sv}}"));
-
-  /* look through list */
-  if (value != NULL)
-    {
-      GVariantIter iter;
-      GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
-        {
-          guint64 cleartext_device;
-          GVariant *details;
-          GVariant *crypto_device_value;
-
-          g_variant_get (child,
-                         "{t@a{sv}}",
-                         &cleartext_device,
-                         &details);
-
-          crypto_device_value = lookup_asv (details, "crypto-device");
-          if (crypto_device_value != NULL)
-            {
-              dev_t iter_crypto_device;
-              iter_crypto_device = g_variant_get_uint64 (crypto_device_value);
-              if (iter_crypto_device == crypto_device)
-                {
-                  ret = cleartext_device;
-                  if (out_uid != NULL)
-                    {
-                      GVariant *lookup_value;
-                      lookup_value = lookup_asv (details, "unlocked-by-uid");
-                      *out_uid = 0;
-                      if (lookup_value != NULL)
-                        {
-                          *out_uid = g_variant_get_uint32 (lookup_value);
-                          g_variant_unref (lookup_value);
-                        }
-                    }
-                  g_variant_unref (crypto_device_value);
-                  g_variant_unref (details);
-                  g_variant_unref (child);
-                  goto out;
-                }
-              g_variant_unref (crypto_device_value);
-            }
-          g_variant_unref (details);
-          g_variant_unref (child);
-        }
+  dev_t ret = 0;
+  GList *entries;
+
+  g_return_val_if_fail (UDISKS_IS_STATE (state), 0);
+
+  g_mutex_lock (&state->lock);
+
+  entries = state_table_lookup_dev (get_table (state, STATE_TABLE_UNLOCKED_CRYPTO_DEV), crypto_device);
+  if (entries != NULL)
+    {
+      StateEntry *entry = entries->data;
+
+      ret = entry->id;
+      if (out_uid != NULL)
+        *out_uid = entry->uid;
     }
 
- out:
-  if (value != NULL)
-    g_variant_unref (value);
   g_mutex_unlock (&state->lock);
   return ret;
 }
@@ -1696,52 +2767,31 @@ udisks_state_check_loop_entry (UDisksState  *state,
 static void
 udisks_state_check_loop (UDisksState *state,
                          gboolean     check_only,
-                         GArray      *devs_to_clean)
+                         GArray      *devs_to_clean,
+                         GHashTable  *match_devs)
 {
-  gboolean changed;
-  GVariant *value;
-  GVariant *new_value;
-  GVariantBuilder builder;
-
-  changed = FALSE;
+  StateTable *table;
+  GList *entries;
+  GList *l;
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_LOOP,
-                            G_VARIANT_TYPE ("a{sa{sv}}"));
+  table = get_table (state, STATE_TABLE_LOOP);
 
   /* check valid entries */
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
-  if (value != NULL)
+  entries = state_table_get_entries_to_check (table, match_devs);
+  for (l = entries; l != NULL; l = l->next)
     {
-      GVariantIter iter;
+      StateEntry *entry = l->data;
       GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
+
+      child = state_entry_to_variant (table, entry);
+      if (!udisks_state_check_loop_entry (state, child, check_only, devs_to_clean))
         {
-          if (udisks_state_check_loop_entry (state, child, check_only, devs_to_clean))
-            g_variant_builder_add_value (&builder, child);
-          else
-            changed = TRUE;
-          g_variant_unref (child);
+          state_table_remove (table, entry);
+          state_table_mark_dirty (state, table);
         }
-      g_variant_unref (value);
-    }
-
-  new_value = g_variant_builder_end (&builder);
-
-  /* save new entries */
-  if (changed)
-    {
-      udisks_state_set (state,
-                        UDISKS_STATE_FILE_LOOP,
-                        G_VARIANT_TYPE ("a{sa{sv}}"),
-                        new_value /* consumes new_value */);
-    }
-  else
-    {
-      g_variant_unref (new_value);
+      g_variant_unref (child);
     }
+  g_list_free (entries);
 }
 
 /* ---------------------------------------------------------------------------------------------------- */
@@ -1764,10 +2814,7 @@ udisks_state_add_loop (UDisksState   *state,
                        dev_t          backing_file_device,
                        uid_t          uid)
 {
-  GVariant *value;
-  GVariant *new_value;
-  GVariant *details_value;
-  GVariantBuilder builder;
+  StateTable *table;
   GVariantBuilder details_builder;
 
   g_return_if_fail (UDISKS_IS_STATE (state));
@@ -1776,35 +2823,13 @@ udisks_state_add_loop (UDisksState   *state,
 
   g_mutex_lock (&state->lock);
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_LOOP,
-                            G_VARIANT_TYPE ("a{sa{sv}}"));
+  table = get_table (state, STATE_TABLE_LOOP);
 
-  /* start by including existing entries */
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
-  if (value != NULL)
+  /* Skip/remove stale entries */
+  if (state_table_lookup (table, device_file, 0) != NULL)
     {
-      GVariantIter iter;
-      GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
-        {
-          const gchar *entry_loop_device;
-          g_variant_get (child, "{&s@a{sv}}", &entry_loop_device, NULL);
-          /* Skip/remove stale entries */
-          if (g_strcmp0 (entry_loop_device, device_file) == 0)
-            {
-              udisks_warning ("Removing stale entry for loop device `%s' in /run/udisks2/loop file",
-                              entry_loop_device);
-            }
-          else
-            {
-              g_variant_builder_add_value (&builder, child);
-            }
-          g_variant_unref (child);
-        }
-      g_variant_unref (value);
+      udisks_warning ("Removing stale entry for loop device `%s' in /run/udisks2/loop file",
+                      device_file);
     }
 
   /* build the details */
@@ -1821,98 +2846,14 @@ udisks_state_add_loop (UDisksState   *state,
                          "{sv}",
                          "setup-by-uid",
                          g_variant_new_uint32 (uid));
-  details_value = g_variant_builder_end (&details_builder);
 
-  /* finally add the new entry */
-  g_variant_builder_add (&builder,
-                         "{s@a{sv}}",
-                         device_file,
-                         details_value); /* consumes details_value */
-  new_value = g_variant_builder_end (&builder);
-
-  /* save new entries */
-  udisks_state_set (state,
-                    UDISKS_STATE_FILE_LOOP,
-                    G_VARIANT_TYPE ("a{sa{sv}}"),
-                    new_value /* consumes new_value */);
+  /* finally add the new entry, replacing any stale one */
+  state_table_insert (table, device_file, 0, g_variant_builder_end (&details_builder));
+  state_table_mark_dirty (state, table);
 
   g_mutex_unlock (&state->lock);
 }
 
-/**
- * node_cb:
- * @child:          Element in the list you are visiting
- * @compare_data:   Data used for comparison
- * @user_data:      Data supplied by call to iterate list
- *
- * Returns: %TRUE if the iteration should stop, else %FALSE
- */
-typedef gboolean (*node_cb)(GVariant *child, gpointer compare_data,
-                            gpointer user_data);
-
-
-/**
- * iterate_list:
- * @list:           The list to iterate over
- * @visit:          The function called on each element in the list
- * @compare_data:   Data used for comparison
- * @user_data:      Pointer to user supplied data
- *
- * Returns: %TRUE if iteration was stopped by node_cb, else %FALSE
- */
-static gboolean
-iterate_list (GVariant *list, node_cb visit, gpointer compare_data,
-              gpointer user_data)
-{
-  gboolean rc = FALSE;
-  GVariantIter iter;
-  GVariant *child = NULL;
-
-  if (!list)
-    return rc;
-
-  g_variant_iter_init (&iter, list);
-
-  while (!rc && ((child = g_variant_iter_next_value (&iter)) != NULL))
-    {
-      rc = visit (child, compare_data, user_data);
-      g_variant_unref (child);
-    }
-
-  return rc;
-}
-
-static gboolean
-_udisks_state_has_loop_list_visitor (GVariant *child, gpointer compare_data,
-                                     gpointer user_data )
-{
-  gboolean ret = FALSE;
-  const gchar *iter_device_file = NULL;
-  GVariant *details = NULL;
-  uid_t *out_uid = (uid_t *) user_data;
-
-  g_variant_get (child, "{&s@a{sv}}", &iter_device_file, &details);
-
-  if (g_strcmp0 (iter_device_file, ((gchar*)compare_data)) == 0)
-    {
-      if (out_uid != NULL)
-        {
-          GVariant *lookup_value;
-          lookup_value = lookup_asv (details, "setup-by-uid");
-          *out_uid = 0;
-          if (lookup_value != NULL)
-            {
-              *out_uid = g_variant_get_uint32 (lookup_value);
-              g_variant_unref (lookup_value);
-              ret = TRUE;
-            }
-        }
-    }
-    g_variant_unref (details);
-
-    return ret;
-}
-
 /**
  * udisks_state_has_loop:
  * @state: A #UDisksState
@@ -1928,27 +2869,20 @@ udisks_state_has_loop (UDisksState   *state,
                        const gchar   *device_file,
                        uid_t         *out_uid)
 {
-  gboolean ret;
-  GVariant *value;
+  gboolean ret = FALSE;
+  StateEntry *entry;
 
   g_return_val_if_fail (UDISKS_IS_STATE (state), FALSE);
 
   g_mutex_lock (&state->lock);
 
-  ret = 0;
-  value = NULL;
-
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_LOOP,
-                            G_VARIANT_TYPE ("a{sa{sv}}"));
-  if (value != NULL)
-   {
-      ret = iterate_list (value,
-                          _udisks_state_has_loop_list_visitor,
-                          (gpointer) device_file, (gpointer) out_uid);
-      g_variant_unref (value);
-   }
+  entry = state_table_lookup (get_table (state, STATE_TABLE_LOOP), device_file, 0);
+  if (entry != NULL)
+    {
+      ret = TRUE;
+      if (out_uid != NULL)
+        *out_uid = entry->uid;
+    }
 
   g_mutex_unlock (&state->lock);
   return ret;
@@ -2028,52 +2962,31 @@ udisks_state_check_mdraid_entry (UDisksState  *state,
 static void
 udisks_state_check_mdraid (UDisksState *state,
                            gboolean     check_only,
-                           GArray      *devs_to_clean)
+                           GArray      *devs_to_clean,
+                           GHashTable  *match_devs)
 {
-  gboolean changed;
-  GVariant *value;
-  GVariant *new_value;
-  GVariantBuilder builder;
-
-  changed = FALSE;
+  StateTable *table;
+  GList *entries;
+  GList *l;
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_MDRAID,
-                            G_VARIANT_TYPE ("a{ta{sv}}"));
+  table = get_table (state, STATE_TABLE_MDRAID);
 
   /* check valid entries */
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ta{sv}}"));
-  if (value != NULL)
+  entries = state_table_get_entries_to_check (table, match_devs);
+  for (l = entries; l != NULL; l = l->next)
     {
-      GVariantIter iter;
+      StateEntry *entry = l->data;
       GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
+
+      child = state_entry_to_variant (table, entry);
+      if (!udisks_state_check_mdraid_entry (state, child, check_only, devs_to_clean))
         {
-          if (udisks_state_check_mdraid_entry (state, child, check_only, devs_to_clean))
-            g_variant_builder_add_value (&builder, child);
-          else
-            changed = TRUE;
-          g_variant_unref (child);
+          state_table_remove (table, entry);
+          state_table_mark_dirty (state, table);
         }
-      g_variant_unref (value);
-    }
-
-  new_value = g_variant_builder_end (&builder);
-
-  /* save new entries */
-  if (changed)
-    {
-      udisks_state_set (state,
-                        UDISKS_STATE_FILE_MDRAID,
-                        G_VARIANT_TYPE ("a{ta{sv}}"),
-                        new_value /* consumes new_value */);
-    }
-  else
-    {
-      g_variant_unref (new_value);
+      g_variant_unref (child);
     }
+  g_list_free (entries);
 }
 
 /**
@@ -2090,45 +3003,20 @@ udisks_state_add_mdraid (UDisksState   *state,
                          dev_t          raid_device,
                          uid_t          uid)
 {
-  GVariant *value;
-  GVariant *new_value;
-  GVariant *details_value;
-  GVariantBuilder builder;
+  StateTable *table;
   GVariantBuilder details_builder;
 
   g_return_if_fail (UDISKS_IS_STATE (state));
 
   g_mutex_lock (&state->lock);
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_MDRAID,
-                            G_VARIANT_TYPE ("a{ta{sv}}"));
+  table = get_table (state, STATE_TABLE_MDRAID);
 
-  /* start by including existing entries */
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ta{sv}}"));
-  if (value != NULL)
+  /* Skip/remove stale entries */
+  if (state_table_lookup (table, NULL, raid_device) != NULL)
     {
-      GVariantIter iter;
-      GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
-        {
-          guint64 entry_raid_device;
-          g_variant_get (child, "{t@a{sv}}", &entry_raid_device, NULL);
-          /* Skip/remove stale entries */
-          if (entry_raid_device == raid_device)
-            {
-              udisks_warning ("Removing stale entry for raid device %u:%u in /run/udisks2/mdraid file",
-                                major (raid_device), minor (raid_device));
-            }
-          else
-            {
-              g_variant_builder_add_value (&builder, child);
-            }
-          g_variant_unref (child);
-        }
-      g_variant_unref (value);
+      udisks_warning ("Removing stale entry for raid device %u:%u in /run/udisks2/mdraid file",
+                      major (raid_device), minor (raid_device));
     }
 
   /* build the details */
@@ -2137,55 +3025,14 @@ udisks_state_add_mdraid (UDisksState   *state,
                          "{sv}",
                          "started-by-uid",
                          g_variant_new_uint32 (uid));
-  details_value = g_variant_builder_end (&details_builder);
-
-  /* finally add the new entry */
-  g_variant_builder_add (&builder,
-                         "{t@a{sv}}",
-                         raid_device,
-                         details_value); /* consumes details_value */
-  new_value = g_variant_builder_end (&builder);
 
-  /* save new entries */
-  udisks_state_set (state,
-                    UDISKS_STATE_FILE_MDRAID,
-                    G_VARIANT_TYPE ("a{ta{sv}}"),
-                    new_value /* consumes new_value */);
+  /* finally add the new entry, replacing any stale one */
+  state_table_insert (table, NULL, raid_device, g_variant_builder_end (&details_builder));
+  state_table_mark_dirty (state, table);
 
   g_mutex_unlock (&state->lock);
 }
 
-static gboolean
-_udisks_state_has_mdraid_list_visitor (GVariant *child, gpointer compare_data,
-                                       gpointer user_data )
-{
-  gboolean ret = FALSE;
-  guint64 iter_raid_device;
-  GVariant *details;
-  dev_t *raid_device = (dev_t*) compare_data;
-  uid_t *out_uid = (uid_t*) user_data;
-
-  g_variant_get (child, "{t@a{sv}}", &iter_raid_device, &details);
-
-  if (iter_raid_device == *raid_device)
-    {
-      ret = TRUE;
-      if (out_uid != NULL)
-        {
-          GVariant *lookup_value;
-          lookup_value = lookup_asv (details, "started-by-uid");
-          *out_uid = 0;
-          if (lookup_value != NULL)
-            {
-              *out_uid = g_variant_get_uint32 (lookup_value);
-              g_variant_unref (lookup_value);
-            }
-        }
-      g_variant_unref (details);
-    }
-  return ret;
-}
-
 /**
  * udisks_state_has_mdraid:
  * @state: A #UDisksState
@@ -2202,21 +3049,18 @@ udisks_state_has_mdraid (UDisksState   *state,
                          uid_t         *out_uid)
 {
   gboolean ret = FALSE;
-  GVariant *value = NULL;
+  StateEntry *entry;
 
   g_return_val_if_fail (UDISKS_IS_STATE (state), FALSE);
 
   g_mutex_lock (&state->lock);
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_MDRAID,
-                            G_VARIANT_TYPE ("a{ta{sv}}"));
-  if (value != NULL)
+  entry = state_table_lookup (get_table (state, STATE_TABLE_MDRAID), NULL, raid_device);
+  if (entry != NULL)
     {
-      ret = iterate_list (value, _udisks_state_has_mdraid_list_visitor,
-                          (gpointer) &raid_device, (gpointer) out_uid);
-      g_variant_unref (value);
+      ret = TRUE;
+      if (out_uid != NULL)
+        *out_uid = entry->uid;
     }
 
   g_mutex_unlock (&state->lock);
@@ -2238,57 +3082,24 @@ void
 udisks_state_add_module (UDisksState *state,
                          const gchar *module_name)
 {
-  GVariant *value;
-  GVariant *new_value;
-  GVariantBuilder builder;
+  StateTable *table;
 
   g_return_if_fail (UDISKS_IS_STATE (state));
 
   g_mutex_lock (&state->lock);
 
-  /* load existing entries */
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_MODULES,
-                            G_VARIANT_TYPE ("a{sa{sv}}"));
+  table = get_table (state, STATE_TABLE_MODULES);
 
-  /* start by including existing entries */
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
-  if (value != NULL)
+  /* Skip/remove stale entries */
+  if (state_table_lookup (table, module_name, 0) != NULL)
     {
-      GVariantIter iter;
-      GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
-        {
-          const gchar *entry_module_name;
-          g_variant_get (child, "{&s@a{sv}}", &entry_module_name, NULL);
-          /* Skip/remove stale entries */
-          if (g_strcmp0 (entry_module_name, module_name) == 0)
-            {
-              udisks_warning ("Removing stale entry for module '%s' in /run/udisks2/modules file",
-                              entry_module_name);
-            }
-          else
-            {
-              g_variant_builder_add_value (&builder, child);
-            }
-          g_variant_unref (child);
-        }
-      g_variant_unref (value);
+      udisks_warning ("Removing stale entry for module '%s' in /run/udisks2/modules file",
+                      module_name);
     }
 
-  /* finally add the new entry */
-  g_variant_builder_add (&builder,
-                         "{s@a{sv}}",
-                         module_name,
-                         g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0));
-  new_value = g_variant_builder_end (&builder);
-
-  /* save new entries */
-  udisks_state_set (state,
-                    UDISKS_STATE_FILE_MODULES,
-                    G_VARIANT_TYPE ("a{sa{sv}}"),
-                    new_value /* consumes new_value */);
+  /* finally add the new entry, replacing any stale one */
+  state_table_insert (table, module_name, 0, g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0));
+  state_table_mark_dirty (state, table);
 
   g_mutex_unlock (&state->lock);
 }
@@ -2303,20 +3114,17 @@ udisks_state_add_module (UDisksState *state,
 void
 udisks_state_clear_modules (UDisksState *state)
 {
-  gchar *path;
+  StateTable *table;
 
   g_return_if_fail (UDISKS_IS_STATE (state));
 
   g_mutex_lock (&state->lock);
 
-  /* just remove the file entirely */
-  path = get_state_file_path (UDISKS_STATE_FILE_MODULES);
-  if (g_unlink (path))
-    {
-      if (errno != ENOENT)
-        g_warning ("Error removing state file %s: %m", path);
-    }
-  g_free (path);
+  /* the file is removed entirely once the table is written out empty */
+  table = get_table (state, STATE_TABLE_MODULES);
+  state_table_clear (table);
+  state_table_journal (table, STATE_JOURNAL_OP_CLEAR, NULL);
+  state_table_mark_dirty (state, table);
 
   g_mutex_unlock (&state->lock);
 }
@@ -2334,31 +3142,15 @@ gchar **
 udisks_state_get_modules (UDisksState *state)
 {
   GPtrArray *list;
-  GVariant *value;
+  GList *l;
 
   g_return_val_if_fail (UDISKS_IS_STATE (state), NULL);
 
   g_mutex_lock (&state->lock);
 
   list = g_ptr_array_new ();
-
-  value = udisks_state_get (state,
-                            UDISKS_STATE_FILE_MODULES,
-                            G_VARIANT_TYPE ("a{sa{sv}}"));
-  if (value != NULL)
-    {
-      GVariantIter iter;
-      GVariant *child;
-      g_variant_iter_init (&iter, value);
-      while ((child = g_variant_iter_next_value (&iter)) != NULL)
-        {
-          gchar *entry_module_name;
-          g_variant_get (child, "{s@a{sv}}", &entry_module_name, NULL);
-          g_ptr_array_add (list, entry_module_name);
-          g_variant_unref (child);
-        }
-      g_variant_unref (value);
-    }
+  for (l = get_table (state, STATE_TABLE_MODULES)->entries.head; l != NULL; l = l->next)
+    g_ptr_array_add (list, g_strdup (((StateEntry *) l->data)->name));
 
   g_mutex_unlock (&state->lock);
 
@@ -2380,124 +3172,4 @@ get_state_file_path (const gchar *key)
   return g_strdup_printf ("/run/udisks2/%s", key);
 }
 
-static GVariant *
-udisks_state_get (UDisksState           *state,
-                  const gchar           *key,
-                  const GVariantType    *type)
-{
-  gchar *path;
-  GVariant *ret;
-  gchar *contents = NULL;
-  GError *local_error = NULL;
-  gsize length = 0;
-
-  g_return_val_if_fail (UDISKS_IS_STATE (state), NULL);
-  g_return_val_if_fail (key != NULL, NULL);
-  g_return_val_if_fail (g_variant_type_is_definite (type), NULL);
-
-  /* TODO:
-   *
-   * - could use a cache here to avoid loading files all the time
-   * - could also mmap the file
-   */
-
-  path = get_state_file_path (key);
-
-  /* see if it's already in the cache */
-  ret = g_hash_table_lookup (state->cache, path);
-  if (ret != NULL)
-    {
-      g_variant_ref (ret);
-      goto out;
-    }
-
-  if (!g_file_get_contents (path,
-                            &contents,
-                            &length,
-                            &local_error))
-    {
-      if (local_error->domain == G_FILE_ERROR && local_error->code == G_FILE_ERROR_NOENT)
-        {
-          /* this is not an error */
-          g_clear_error (&local_error);
-          goto out;
-        }
-
-      udisks_warning ("Error getting state data %s: %s (%s, %d)",
-                      key,
-                      local_error->message,
-                      g_quark_to_string (local_error->domain),
-                      local_error->code);
-      g_clear_error (&local_error);
-      goto out;
-    }
-
-  ret = g_variant_new_from_data (type,
-                                 (gconstpointer) contents,
-                                 length,
-                                 FALSE,
-                                 g_free,
-                                 contents);
-  g_warn_if_fail (ret != NULL);
-  g_variant_ref_sink (ret);
-
-  contents = NULL; /* ownership transfered to the returned GVariant */
-
- out:
-  g_free (contents);
-  g_free (path);
-  return ret;
-}
-
-static gboolean
-udisks_state_set (UDisksState          *state,
-                  const gchar          *key,
-                  const GVariantType   *type,
-                  GVariant             *value)
-{
-  gboolean ret = FALSE;
-  gsize size;
-  gchar *path;
-  gchar *data;
-  GVariant *normalized;
-  GError *error = NULL;
-
-  g_return_val_if_fail (UDISKS_IS_STATE (state), FALSE);
-  g_return_val_if_fail (key != NULL, FALSE);
-  g_return_val_if_fail (g_variant_type_is_definite (type), FALSE);
-  g_return_val_if_fail (g_variant_is_of_type (value, type), FALSE);
-
-  g_variant_ref_sink (value);
-  normalized = g_variant_get_normal_form (value);
-  size = g_variant_get_size (normalized);
-  data = g_malloc (size);
-  g_variant_store (normalized, data);
-
-  path = get_state_file_path (key);
-  g_hash_table_insert (state->cache, g_strdup (path), g_variant_ref (value));
-
-  if (!g_file_set_contents (path,
-                            data,
-                            size,
-                            &error))
-    {
-      udisks_warning ("Error setting state data %s: %s (%s, %d)", key,
-                     error->message,
-                     g_quark_to_string (error->domain),
-                     error->code);
-      g_clear_error (&error);
-      goto out;
-    }
-
-  ret = TRUE;
-
- out:
-
-  g_free (path);
-  g_free (data);
-  g_variant_unref (normalized);
-  g_variant_unref (value);
-  return ret;
-}
-
 /* ---------------------------------------------------------------------------------------------------- */
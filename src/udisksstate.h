@@ -35,6 +35,9 @@ UDisksDaemon  *udisks_state_get_daemon           (UDisksState   *state);
 void           udisks_state_start_cleanup        (UDisksState   *state);
 void           udisks_state_stop_cleanup         (UDisksState   *state);
 void           udisks_state_check                (UDisksState   *state);
+void           udisks_state_check_devices        (UDisksState   *state,
+                                                  const dev_t   *devs,
+                                                  guint          n_devs);
 void           udisks_state_check_sync           (UDisksState   *state);
 void           udisks_state_check_block          (UDisksState   *state,
                                                   dev_t          block_device);
@@ -28,6 +28,8 @@
 #include "udisksthreadedjob.h"
 #include "udisks-daemon-marshal.h"
 #include "udisksdaemon.h"
+#include "udisksjobscheduler.h"
+#include "udisksmethodexecutor.h"
 
 /**
  * SECTION:udisksthreadedjob
@@ -211,11 +213,14 @@ run_task_job (GTask            *task,
   if (g_task_return_error_if_cancelled (task))
     return;
 
+  udisks_job_scheduler_enter_job ();
   if (! job->job_func (job, cancellable, job->user_data, &job_error))
     {
+      udisks_job_scheduler_leave_job ();
       g_task_return_error (task, job_error);
       return;
     }
+  udisks_job_scheduler_leave_job ();
 
   g_warn_if_fail (job_error == NULL);
   g_task_return_boolean (task, TRUE);
@@ -365,17 +370,10 @@ udisks_threaded_job_new (UDisksThreadedJobFunc  job_func,
                                             NULL));
 }
 
-/**
- * udisks_threaded_job_start:
- * @job: the job to start
- *
- * Start the @job. Connect to the #UDisksThreadedJob::threaded-job-completed or
- * #UDisksJob::completed signals to get notified when the job is done.
- *
- * */
-void
-udisks_threaded_job_start (UDisksThreadedJob *job)
+static void
+threaded_job_start_now (UDisksBaseJob *base_job)
 {
+  UDisksThreadedJob *job = UDISKS_THREADED_JOB (base_job);
   GTask *task;
 
   task = g_task_new (job,
@@ -390,6 +388,30 @@ udisks_threaded_job_start (UDisksThreadedJob *job)
   g_object_unref (task);
 }
 
+/**
+ * udisks_threaded_job_start:
+ * @job: the job to start
+ *
+ * Start the @job. Connect to the #UDisksThreadedJob::threaded-job-completed or
+ * #UDisksJob::completed signals to get notified when the job is done.
+ *
+ * If the drives @job is on are busy, @job is queued by the
+ * #UDisksJobScheduler of the daemon and started later.
+ */
+void
+udisks_threaded_job_start (UDisksThreadedJob *job)
+{
+  UDisksDaemon *daemon;
+
+  daemon = udisks_base_job_get_daemon (UDISKS_BASE_JOB (job));
+  if (daemon != NULL)
+    udisks_job_scheduler_start (udisks_daemon_get_job_scheduler (daemon),
+                                UDISKS_BASE_JOB (job),
+                                threaded_job_start_now);
+  else
+    threaded_job_start_now (UDISKS_BASE_JOB (job));
+}
+
 /**
  * udisks_threaded_job_run_sync:
  * @job: the job to run
@@ -406,9 +428,17 @@ gboolean
 udisks_threaded_job_run_sync (UDisksThreadedJob     *job,
                               GError               **error)
 {
+  UDisksDaemon *daemon;
   GTask *task;
   gboolean job_result;
 
+  udisks_method_executor_begin_blocking ();
+
+  /* blocks while the drives @job is on are busy */
+  daemon = udisks_base_job_get_daemon (UDISKS_BASE_JOB (job));
+  if (daemon != NULL)
+    udisks_job_scheduler_wait (udisks_daemon_get_job_scheduler (daemon), UDISKS_BASE_JOB (job));
+
   task = g_task_new (job,
                      udisks_base_job_get_cancellable (UDISKS_BASE_JOB (job)),
                      NULL,
@@ -417,6 +447,8 @@ udisks_threaded_job_run_sync (UDisksThreadedJob     *job,
   g_task_set_return_on_cancel (task, FALSE);
   g_task_run_in_thread_sync (task, run_task_job);
 
+  udisks_method_executor_end_blocking ();
+
   job_result = job_finish (job, task, error);
 
   g_object_unref (task);
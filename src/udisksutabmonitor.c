@@ -18,6 +18,8 @@
  *
  */
 
+#include <string.h>
+
 #include <libmount/libmount.h>
 
 #include <glib.h>
@@ -53,6 +55,12 @@ struct _UDisksUtabMonitor
 
   struct libmnt_monitor *mn;
   struct libmnt_table *current_tb;
+
+  /* entries with user options in current_tb, indexed by their /dev source;
+   * only rebuilt when a reload reports changed entries */
+  gboolean index_valid;
+  GList *entries;
+  GHashTable *entries_by_source;     /* source -> GList of UDisksUtabEntry */
 };
 
 typedef struct _UDisksUtabMonitorClass UDisksUtabMonitorClass;
@@ -79,7 +87,9 @@ static guint signals[LAST_SIGNAL] = { 0 };
 G_DEFINE_TYPE (UDisksUtabMonitor, udisks_utab_monitor, G_TYPE_OBJECT)
 
 static void udisks_utab_monitor_ensure (UDisksUtabMonitor *monitor);
+static void udisks_utab_monitor_ensure_index (UDisksUtabMonitor *monitor);
 static void udisks_utab_monitor_invalidate (UDisksUtabMonitor *monitor);
+static void free_index (GHashTable *index);
 static void udisks_utab_monitor_constructed (GObject *object);
 
 static void
@@ -90,6 +100,9 @@ udisks_utab_monitor_init (UDisksUtabMonitor *monitor)
   monitor->utab_watch_source = NULL;
   monitor->mn = NULL;
   monitor->current_tb = NULL;
+  monitor->index_valid = FALSE;
+  monitor->entries = NULL;
+  monitor->entries_by_source = g_hash_table_new (g_str_hash, g_str_equal);
 }
 
 static void
@@ -106,6 +119,8 @@ udisks_utab_monitor_finalize (GObject *object)
     mnt_unref_monitor (monitor->mn);
   if (monitor->current_tb)
     mnt_free_table (monitor->current_tb);
+  free_index (monitor->entries_by_source);
+  g_list_free_full (monitor->entries, g_object_unref);
 
   if (G_OBJECT_CLASS (udisks_utab_monitor_parent_class)->finalize != NULL)
     G_OBJECT_CLASS (udisks_utab_monitor_parent_class)->finalize (object);
@@ -184,8 +199,15 @@ reload_utab_entries (UDisksUtabMonitor *monitor)
   struct libmnt_tabdiff *diff = NULL;
   struct libmnt_iter *itr;
   struct libmnt_fs *old, *new;
+  GPtrArray *changed_entries;
+  GArray *changed_signals;
+  guint signal_id;
+  guint n;
   int rc = -1, change;
 
+  changed_entries = g_ptr_array_new_with_free_func (g_object_unref);
+  changed_signals = g_array_new (FALSE, FALSE, sizeof (guint));
+
   g_rw_lock_writer_lock (&monitor->lock);
   udisks_utab_monitor_ensure (monitor);
   old_tb = monitor->current_tb;
@@ -220,33 +242,49 @@ reload_utab_entries (UDisksUtabMonitor *monitor)
           case MNT_TABDIFF_UMOUNT:
             if (fs_has_user_options (old))
               {
-                g_autoptr (UDisksUtabEntry) entry = _udisks_utab_entry_new (old);
-                g_signal_emit (monitor, signals[ENTRY_REMOVED_SIGNAL], 0, entry);
+                g_ptr_array_add (changed_entries, _udisks_utab_entry_new (old));
+                signal_id = ENTRY_REMOVED_SIGNAL;
+                g_array_append_val (changed_signals, signal_id);
               }
             break;
           case MNT_TABDIFF_REMOUNT:
             if (fs_has_user_options (old))
               {
-                g_autoptr (UDisksUtabEntry) entry = _udisks_utab_entry_new (old);
-                g_signal_emit (monitor, signals[ENTRY_REMOVED_SIGNAL], 0, entry);
+                g_ptr_array_add (changed_entries, _udisks_utab_entry_new (old));
+                signal_id = ENTRY_REMOVED_SIGNAL;
+                g_array_append_val (changed_signals, signal_id);
               }
             if (fs_has_user_options (new))
               {
-                g_autoptr (UDisksUtabEntry) entry = _udisks_utab_entry_new (new);
-                g_signal_emit (monitor, signals[ENTRY_ADDED_SIGNAL], 0, entry);
+                g_ptr_array_add (changed_entries, _udisks_utab_entry_new (new));
+                signal_id = ENTRY_ADDED_SIGNAL;
+                g_array_append_val (changed_signals, signal_id);
               }
             break;
           case MNT_TABDIFF_MOUNT:
               if (fs_has_user_options (new))
               {
-                g_autoptr (UDisksUtabEntry) entry = _udisks_utab_entry_new (new);
-                g_signal_emit (monitor, signals[ENTRY_ADDED_SIGNAL], 0, entry);
+                g_ptr_array_add (changed_entries, _udisks_utab_entry_new (new));
+                signal_id = ENTRY_ADDED_SIGNAL;
+                g_array_append_val (changed_signals, signal_id);
               }
             break;
           }
     }
 
 out:
+  /* the handlers look up the new entries so refresh the index before emitting */
+  if (rc < 0 || changed_entries->len > 0)
+    {
+      g_rw_lock_writer_lock (&monitor->lock);
+      monitor->index_valid = FALSE;
+      g_rw_lock_writer_unlock (&monitor->lock);
+    }
+  for (n = 0; n < changed_entries->len; n++)
+    g_signal_emit (monitor, signals[g_array_index (changed_signals, guint, n)], 0, g_ptr_array_index (changed_entries, n));
+
+  g_ptr_array_free (changed_entries, TRUE);
+  g_array_free (changed_signals, TRUE);
   if (old_tb)
     mnt_unref_table (old_tb);
   if (diff)
@@ -368,6 +406,101 @@ udisks_utab_monitor_get_entries (UDisksUtabMonitor  *monitor)
   return ret;
 }
 
+/**
+ * udisks_utab_monitor_get_entries_for_ids:
+ * @monitor: A #UDisksUtabMonitor.
+ * @ids: A %NULL-terminated array of block device identifiers.
+ *
+ * Gets all /run/mounts/utab entries with user options whose source
+ * matches one of @ids. Only device files (or symlinks to them) can match,
+ * other identifiers in @ids are ignored.
+ *
+ * Returns: (transfer full) (element-type UDisksUtabEntry): A list of #UDisksUtabEntry objects that must be freed with g_list_free() after each element has been freed with g_object_unref().
+ */
+GList *
+udisks_utab_monitor_get_entries_for_ids (UDisksUtabMonitor   *monitor,
+                                         const gchar * const *ids)
+{
+  GList *ret = NULL;
+  GList *l;
+  guint n;
+
+  g_return_val_if_fail (UDISKS_IS_UTAB_MONITOR (monitor), NULL);
+
+  if (ids == NULL)
+    return NULL;
+
+  g_rw_lock_writer_lock (&monitor->lock);
+  udisks_utab_monitor_ensure_index (monitor);
+  g_rw_lock_writer_unlock (&monitor->lock);
+
+  g_rw_lock_reader_lock (&monitor->lock);
+  for (n = 0; ids[n] != NULL; n++)
+    {
+      for (l = g_hash_table_lookup (monitor->entries_by_source, ids[n]); l != NULL; l = l->next)
+        {
+          /* an entry has only one source but @ids may contain duplicates */
+          if (g_list_find (ret, l->data) == NULL)
+            ret = g_list_prepend (ret, g_object_ref (l->data));
+        }
+    }
+  g_rw_lock_reader_unlock (&monitor->lock);
+
+  return ret;
+}
+
+static void
+free_index (GHashTable *index)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, index);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_list_free (value);
+  g_hash_table_destroy (index);
+}
+
+/* must be called with the writer lock held */
+static void
+udisks_utab_monitor_ensure_index (UDisksUtabMonitor *monitor)
+{
+  struct libmnt_iter *itr;
+  struct libmnt_fs *fs;
+  GList *l;
+
+  udisks_utab_monitor_ensure (monitor);
+
+  if (monitor->index_valid)
+    return;
+
+  free_index (monitor->entries_by_source);
+  g_list_free_full (monitor->entries, g_object_unref);
+  monitor->entries = NULL;
+  /* the lists are freed by free_index(), the keys are owned by the entries */
+  monitor->entries_by_source = g_hash_table_new (g_str_hash, g_str_equal);
+
+  itr = mnt_new_iter (MNT_ITER_FORWARD);
+  while (mnt_table_find_next_fs (monitor->current_tb, itr, fs_has_user_options_match_func, NULL, &fs) == 0)
+    monitor->entries = g_list_prepend (monitor->entries, _udisks_utab_entry_new (fs));
+  mnt_free_iter (itr);
+
+  for (l = monitor->entries; l != NULL; l = l->next)
+    {
+      UDisksUtabEntry *entry = UDISKS_UTAB_ENTRY (l->data);
+      const gchar *source = udisks_utab_entry_get_source (entry);
+
+      if (source == NULL || !g_str_has_prefix (source, "/dev"))
+        continue;
+
+      g_hash_table_insert (monitor->entries_by_source,
+                           (gchar *) source,
+                           g_list_prepend (g_hash_table_lookup (monitor->entries_by_source, source), entry));
+    }
+
+  monitor->index_valid = TRUE;
+}
+
 static void
 udisks_utab_monitor_ensure (UDisksUtabMonitor *monitor)
 {